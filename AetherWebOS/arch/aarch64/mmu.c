@@ -52,6 +52,48 @@ void mmu_map_region(uintptr_t va, uintptr_t pa, size_t size, uint64_t flags) {
     asm volatile("dsb sy; tlbi vmalle1is; dsb sy; isb");
 }
 
+/* Clean and invalidate: nothing of the range is left in any cache */
+static void flush_cache_range(uintptr_t start, uintptr_t end) {
+    uintptr_t addr = start & ~63ULL;
+    for (; addr < end; addr += 64) {
+        asm volatile("dc civac, %0" : : "r" (addr) : "memory");
+    }
+    asm volatile("dsb sy; isb");
+}
+
+static void set_l2_ram(uint32_t i, uint64_t desc) {
+    kpt.l2_ram[i] = desc;
+    clean_cache_range((uintptr_t)&kpt.l2_ram[i], (uintptr_t)&kpt.l2_ram[i] + 8);
+}
+
+/**
+ * mmu_set_ram_attrs: Re-types the 2MB RAM blocks covering @va..@va+@size
+ * (e.g. MM_ATTR_NORMAL_INDEX for uncached DMA memory). Block aligned;
+ * anything outside the 1GB - 2GB RAM window is left alone.
+ *
+ * Break-before-make: each block is invalidated and the TLBs flushed
+ * before the new type goes in, so no core ever holds both. DC by VA
+ * needs a valid mapping, so the range is cleaned and invalidated while
+ * the old one is live and again through the new one, which drops lines
+ * speculatively allocated before the break.
+ */
+void mmu_set_ram_attrs(uintptr_t va, size_t size, uint64_t attr_index) {
+    for (uintptr_t a = va & ~0x1FFFFFULL; a < va + size; a += 0x200000) {
+        if (a < 0x40000000 || a >= 0x80000000)
+            continue;
+
+        uint32_t i = (a - 0x40000000) >> 21;
+
+        flush_cache_range(a, a + 0x200000);
+        set_l2_ram(i, 0);
+        asm volatile("dsb sy; tlbi vmalle1is; dsb sy; isb");
+
+        set_l2_ram(i, a | 0x401 | attr_index);
+        asm volatile("dsb sy; isb");
+        flush_cache_range(a, a + 0x200000);
+    }
+}
+
 void mmu_init() {
     uart_puts("[INFO] MMU: Configuring AETHER OS Memory Map...\r\n");
 
@@ -61,8 +103,7 @@ void mmu_init() {
         asm volatile("str xzr, [%0], #8" : "+r"(p) :: "memory");
     }
 
-    // 2. MAIR Setup: 0=Device-nGnRnE, 1=Normal-NC, 2=Normal-WB
-    asm volatile("msr mair_el1, %0" : : "r" (0xFF4400));
+    // 2. MAIR is programmed per core in mmu_enable_this_cpu()
 
     // 3. Link Tables
     kpt.l1[0] = (uintptr_t)kpt.l2_periph | 0x3; // 0GB - 1GB
@@ -96,11 +137,24 @@ void mmu_init() {
     // 7. Flush and Enable
     clean_cache_range((uintptr_t)&kpt, (uintptr_t)&kpt + sizeof(kpt));
 
+    mmu_enable_this_cpu();
+
+    uart_puts("[OK] MMU ACTIVE: Identity & ECAM Bridge Online.\r\n");
+}
+
+/**
+ * mmu_enable_this_cpu: Points the calling core at the shared kernel
+ * tables built by mmu_init(). Secondaries call this on their way up.
+ */
+void mmu_enable_this_cpu(void) {
+    // MAIR Setup: 0=Device-nGnRnE, 1=Normal-NC, 2=Normal-WB
+    asm volatile("msr mair_el1, %0" : : "r" (0xFF4400));
+
     // TCR_EL1: 39-bit VA, 4KB granule, Inner Shareable
     uint64_t tcr = (25LL << 0) | (3LL << 10) | (3LL << 12) | (2LL << 32);
     asm volatile("msr tcr_el1, %0" : : "r" (tcr));
     asm volatile("msr ttbr0_el1, %0" : : "r" (&kpt.l1));
-    asm volatile("isb");
+    asm volatile("tlbi vmalle1; dsb nsh; isb");
 
     // SCTLR_EL1: Enable MMU (M) and Instruction Cache (I)
     uint64_t sctlr;
@@ -108,6 +162,4 @@ void mmu_init() {
     sctlr |= 0x1001; 
     asm volatile("msr sctlr_el1, %0" : : "r" (sctlr));
     asm volatile("isb");
-
-    uart_puts("[OK] MMU ACTIVE: Identity & ECAM Bridge Online.\r\n");
 }
\ No newline at end of file
@@ -22,6 +22,7 @@ void str_append(char* str, const char* data);
 void str_append_kv_int(char* str, const char* key, uint64_t value);
 
 void *memcpy(void *dest, const void *src, size_t n);
+int memcmp(const void *a, const void *b, size_t n);
 void mini_sprintf_telemetry(char* out, unsigned long rx, unsigned long tx, 
                             unsigned long err, unsigned long buf, 
                             unsigned long tcp, unsigned long rexmit, 
@@ -18,6 +18,9 @@
      */
     #define TIMER_IRQ_ID       30
 
+    /* PL011 UART0: SPI 1 on the 'virt' machine (INTID 32 + 1) */
+    #define UART0_IRQ_ID       33
+
     /**
      * PCIE_PHYS_BASE: The actual hardware address in QEMU.
      * Note: 0x3f000000 is the standard for 'highmem=off'.
@@ -37,6 +40,9 @@
     #define PERIPHERAL_START   0x00000000
     #define PERIPHERAL_END     0x3FFFFFFF
 
+    /* Devices see guest-physical RAM as is */
+    #define DMA_BUS_OFFSET     0x0
+
     /* Network Identity */
     #define AETHER_IP_ADDR  0x0A00020F  // 10.0.2.15
     #define AETHER_GATEWAY  0x0A000202  // 10.0.2.2
@@ -54,6 +60,9 @@
      */
     #define TIMER_IRQ_ID       97
 
+    /* PL011 UART0: VideoCore IRQ 57 -> GIC SPI 121 (INTID 153) */
+    #define UART0_IRQ_ID       153
+
     /* Pi4 PCIe Controller Registers */
     #define PCIE_REG_BASE      0xFD500000
     
@@ -64,6 +73,9 @@
     #define RAM_START          0x00000000
     #define PERIPHERAL_START   0xFD000000
     #define PERIPHERAL_END     0xFFFFFFFF
+
+    /* PCIe inbound window: bus 0x0 -> ARM 0x0 (first 3 GB) */
+    #define DMA_BUS_OFFSET     0x0
 #endif
 
 /* General Memory Layout Constants */
@@ -71,4 +83,9 @@
 #define HEAP_START             0x41000000 // Offset inside RAM for safety
 #define HEAP_SIZE              (16 * 1024 * 1024)
 
+/* DMA zone (kernel/dma.h): right after the heap, 2MB-block aligned */
+#define DMA_ZONE_START         0x42000000
+#define DMA_ZONE_SIZE          (16 * 1024 * 1024)
+#define DMA_COHERENT_SIZE      (4 * 1024 * 1024)   // Head of the zone, mapped non-cacheable
+
 #endif
@@ -2,6 +2,7 @@
 #define ETHERNET_H
 
 #include <stdint.h>
+#include "drivers/ethernet/net_meta.h"
 
 #define ETH_TYPE_IPV4 0x0800
 #define ETH_TYPE_ARP  0x0806
@@ -34,7 +35,8 @@ static inline uint16_t ntohs(uint16_t val) {
    Ethernet API (IMPORTANT)
    ===================================================== */
 
-void ethernet_handle_packet(uint8_t *data, uint32_t len);
+/* @meta may be NULL: nothing known about the frame */
+void ethernet_handle_packet(uint8_t *data, uint32_t len, const struct net_meta *meta);
 
 /**
  * ethernet_send: The main egress point for the network stack.
@@ -45,4 +47,33 @@ void ethernet_handle_packet(uint8_t *data, uint32_t len);
  */
 void ethernet_send(uint8_t *dest_mac, uint16_t ethertype, uint8_t *payload, uint32_t len);
 
+/* ethernet_send() with offload requests for the device */
+void ethernet_send_meta(uint8_t *dest_mac, uint16_t ethertype, uint8_t *payload, uint32_t len,
+                        const struct net_meta *meta);
+
+struct netbuf;
+
+/*
+ * ethernet_send_meta() for a frame whose payload is a chain of kmalloc'd
+ * buffers: they are handed to the driver as they are (one fragment each)
+ * and freed once sent, or here on failure.
+ */
+void ethernet_send_frags(uint8_t *dest_mac, uint16_t ethertype, struct netbuf *payload,
+                         const struct net_meta *meta);
+
+/*
+ * TX batching: between begin and end, frames sent from this core are
+ * queued with the "more coming" hint and the doorbell is rung once, at
+ * the outermost end (or earlier if the queue fills). Wrap input
+ * processing and bursts of sends in it. Nests; disables preemption.
+ */
+void ethernet_tx_batch_begin(void);
+void ethernet_tx_batch_end(void);
+
+/* Non-zero if the NIC fills in TCP checksums (NET_META_CSUM_PARTIAL) */
+int ethernet_tx_csum_offload(void);
+
+/* Non-zero if the NIC segments TCP super-segments (NET_META_GSO_TCPV4) */
+int ethernet_tx_tso(void);
+
 #endif
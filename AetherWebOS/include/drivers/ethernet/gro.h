@@ -0,0 +1,43 @@
+#ifndef GRO_H
+#define GRO_H
+
+#include <stdint.h>
+#include "drivers/ethernet/net_meta.h"
+
+/**
+ * Generic receive offload, in software.
+ *
+ * Sits between the RX poll (or RSS backlog drain) and ethernet_handle_packet.
+ * In-order TCP data segments of one flow arriving in the same batch are
+ * appended to a held copy of the first and go up the stack as a single
+ * segment: one IPv4 parse, one TCB lookup and one ACK per batch instead
+ * of per frame. Anything that cannot be merged (SYN/FIN/RST/URG, options
+ * that differ, a sequence gap, a changed ACK or window) first flushes
+ * the flow it belongs to, so order within a flow is kept.
+ *
+ * Segments are checked (IPv4 header, TCP checksum unless the device
+ * vouched for it) before they are merged; the merged segment carries
+ * NET_META_CSUM_VALID | NET_META_GRO and a fresh IPv4 header checksum.
+ *
+ * State is per core and only touched from that core's RX work, so it
+ * needs no lock. The poll that fed the batch must call gro_flush().
+ */
+
+#define GRO_MAX_FLOWS       4           /* Held flows per core */
+#define GRO_MAX_SIZE        16384       /* Merged IPv4 packet, > TCP_DEFAULT_WINDOW */
+
+typedef struct {
+    unsigned long merged;               /* Segments appended to a held one */
+    unsigned long flushed;              /* Held segments passed up */
+    unsigned long bypass;               /* Frames passed up as they came */
+} gro_stats_t;
+
+/* Hold, merge or deliver @frame (a copy is kept; @frame can be reused) */
+void gro_receive(uint8_t *frame, uint32_t len, const struct net_meta *meta);
+
+/* End of batch: pass every held flow of the calling core up the stack */
+void gro_flush(void);
+
+void gro_get_stats(uint32_t cpu, gro_stats_t *out);
+
+#endif
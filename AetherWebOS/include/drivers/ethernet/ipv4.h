@@ -35,11 +35,33 @@ struct ipv4_header {
 
 uint16_t ipv4_checksum(void *data, size_t len);
 
-void ipv4_handle(uint8_t *data, uint32_t len);
+struct net_meta;
+
+void ipv4_handle(uint8_t *data, uint32_t len, const struct net_meta *meta);
 
 void ipv4_send(uint32_t dst_ip,
                uint8_t protocol,
                const uint8_t *payload,
                uint32_t payload_len);
 
+/* ipv4_send() passing @meta (csum_start relative to @payload) down */
+void ipv4_send_meta(uint32_t dst_ip,
+                    uint8_t protocol,
+                    const uint8_t *payload,
+                    uint32_t payload_len,
+                    const struct net_meta *meta);
+
+struct netbuf;
+
+/*
+ * ipv4_send_meta() without copying: @payload is a chain of DMA_STREAMING
+ * buffers, each dma_alloc'd at exactly its length, that becomes the
+ * driver's (dma_free'd once sent, or on any failure below);
+ * only the IPv4 header is allocated here and put in front of it.
+ */
+void ipv4_send_frags(uint32_t dst_ip,
+                     uint8_t protocol,
+                     struct netbuf *payload,
+                     const struct net_meta *meta);
+
 #endif
\ No newline at end of file
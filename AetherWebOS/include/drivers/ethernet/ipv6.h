@@ -15,5 +15,9 @@ struct ipv6_header {
 void ipv6_handle(uint8_t *data, uint32_t len);
 void print_ipv6(uint8_t addr[16]);
 
+/* "xxxx:xxxx:xxxx:xxxx:xxxx:xxxx:xxxx:xxxx" + NUL */
+#define IPV6_STR_LEN  40
+int ipv6_format(const uint8_t addr[16], char *out);
+
 
 #endif
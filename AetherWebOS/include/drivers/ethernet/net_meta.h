@@ -0,0 +1,38 @@
+#ifndef NET_META_H
+#define NET_META_H
+
+#include <stdint.h>
+
+/* =====================================================
+   Offload Metadata
+   ===================================================== */
+
+/**
+ * struct net_meta: What the NIC did or should do for a frame, carried
+ * beside it through the layers (the virtio-net header, in stack terms).
+ *
+ * TX: NET_META_CSUM_PARTIAL leaves the L4 checksum to the device; the
+ * checksum field must already hold the folded pseudo-header sum and
+ * csum_start is relative to the payload handed to the layer it is
+ * passed to (each layer adds its own header length).
+ * NET_META_GSO_TCPV4 (with CSUM_PARTIAL) marks a TCP super-segment the
+ * device cuts into gso_size payloads; hdr_len counts the headers in
+ * front of the payload and grows the same way csum_start does.
+ * RX: NET_META_CSUM_VALID means the L4 checksum was already verified,
+ * by the device or by GRO before it merged the segment. NET_META_GRO
+ * marks a segment GRO held; its checksum counters are already bumped.
+ */
+#define NET_META_CSUM_PARTIAL   0x01
+#define NET_META_CSUM_VALID     0x02
+#define NET_META_GSO_TCPV4      0x04
+#define NET_META_GRO            0x08
+
+struct net_meta {
+    uint8_t  flags;
+    uint16_t csum_start;
+    uint16_t csum_offset;       /* Of the checksum field, from csum_start */
+    uint16_t gso_size;          /* Payload bytes per segment */
+    uint16_t hdr_len;
+};
+
+#endif
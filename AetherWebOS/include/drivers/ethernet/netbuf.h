@@ -0,0 +1,55 @@
+#ifndef NETBUF_H
+#define NETBUF_H
+
+#include <stdint.h>
+#include "config.h"
+#include "kernel/spinlock.h"
+
+/**
+ * Network buffers: page pools and fragment chains.
+ *
+ * A page pool hands out PAGE_SIZE buffers taken from the streaming DMA
+ * arena on demand and keeps up to @max_free returned ones for reuse;
+ * beyond that they go back to the arena, so what a pool holds follows
+ * the traffic rather than the worst case.
+ *
+ * A netbuf chain describes one frame spread over several buffers. On RX
+ * (a mergeable receive) each link points into a page it does not own;
+ * on TX the links' buffers come from dma_alloc(DMA_STREAMING), exactly
+ * @len bytes each, and are handed to the driver with the chain, which
+ * frees them once the device is done.
+ */
+
+struct page_pool {
+    spinlock_t     lock;
+    void          *free;                /* Singly linked through the pages */
+    uint32_t       nr_free;
+    uint32_t       max_free;            /* Kept for reuse, rest is dma_free'd */
+    uint32_t       in_use;              /* Handed out, not yet returned */
+
+    unsigned long  allocs;              /* page_pool_get() calls served */
+    unsigned long  recycled;            /* ... of which from the free list */
+    unsigned long  failures;            /* Arena exhausted */
+};
+
+struct netbuf {
+    uint8_t       *data;
+    uint32_t       len;
+    struct netbuf *next;
+};
+
+void  page_pool_init(struct page_pool *pp, const char *name, uint32_t max_free);
+
+/* A PAGE_SIZE buffer, or NULL when the arena is exhausted */
+void *page_pool_get(struct page_pool *pp);
+void  page_pool_put(struct page_pool *pp, void *page);
+
+uint32_t netbuf_chain_len(const struct netbuf *nb);
+
+/* Copy the chain into @out; returns bytes copied (at most @out_size) */
+uint32_t netbuf_linearize(const struct netbuf *nb, uint8_t *out, uint32_t out_size);
+
+/* dma_free() the data of every link (TX chains own their buffers) */
+void netbuf_free_data(struct netbuf *nb);
+
+#endif
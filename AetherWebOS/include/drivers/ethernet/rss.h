@@ -0,0 +1,61 @@
+#ifndef RSS_H
+#define RSS_H
+
+#include <stdint.h>
+#include "drivers/ethernet/net_meta.h"
+
+/**
+ * Receive-side scaling: flow-consistent steering of RX frames to cores.
+ *
+ * A flow is hashed with Toeplitz over its IPv4 4-tuple (addresses, then
+ * TCP/UDP ports, in wire order) and the low bits of the hash index an
+ * indirection table of cores. Queue pair N is served by CPU N, so with a
+ * pair per core the entries double as the NIC's RX queue numbers. Every
+ * segment of a connection, its TCB and its fiber stay on one core and
+ * the stack never shares a TCB between cores.
+ *
+ * When the NIC does the hashing (VIRTIO_NET_F_RSS) it is programmed with
+ * the same key and table and frames arrive on the right queue. Otherwise
+ * rss_receive() hashes in software and hands frames owned by another
+ * core to that core's backlog, drained there as scheduler work.
+ * Non-IP frames (ARP) are handled wherever they arrive.
+ */
+
+#define RSS_KEY_SIZE        40
+#define RSS_INDIR_SIZE      128         /* Power of two */
+#define RSS_BACKLOG_SIZE    256         /* Frames queued per core, power of two */
+#define RSS_BACKLOG_BUDGET  64          /* Frames per backlog work run */
+
+typedef struct {
+    unsigned long local;                /* Handled on the receiving core */
+    unsigned long steered_out;          /* Handed to another core */
+    unsigned long steered_in;           /* Taken from this core's backlog */
+    unsigned long drops;                /* Backlog full or no memory */
+} rss_stats_t;
+
+/* Spread the indirection table over CPUs 0..@nr_queues-1 (1 = off) */
+void rss_init(uint32_t nr_queues);
+
+/* The NIC steers by itself: skip the software hash */
+void rss_set_hw_steering(int enabled);
+
+uint32_t rss_nr_queues(void);
+const uint8_t  *rss_key(void);
+const uint16_t *rss_indirection_table(void);
+
+uint32_t rss_toeplitz(const uint8_t *input, uint32_t len);
+
+/* Hash of an Ethernet frame's IPv4 flow; 0 if it carries none */
+int rss_hash_frame(const uint8_t *frame, uint32_t len, uint32_t *hash);
+
+/* RX entry point for drivers: process @frame on the core owning its flow;
+ * @meta (not NULL) travels with it. Frames kept local go through GRO, so
+ * the caller calls gro_flush() at the end of its batch. */
+void rss_receive(uint8_t *frame, uint32_t len, const struct net_meta *meta);
+
+void rss_get_stats(uint32_t cpu, rss_stats_t *out);
+
+/* Per-core steering and GRO counters (GET /rss) */
+uint32_t rss_format(char *out, uint32_t out_size);
+
+#endif
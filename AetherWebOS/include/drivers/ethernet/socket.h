@@ -4,8 +4,45 @@
 #include <stdint.h>
 #include <drivers/ethernet/tcp/tcp.h>
 
-void socket_dispatch(tcp_tcb_t *tcb,
-                     uint8_t *payload,
-                     uint16_t len);
+/**
+ * Blocking sockets on top of the TCP stack.
+ *
+ * Each connection is served by its own fiber (kernel/fiber.h), so the
+ * handler is plain sequential code: sock_recv/sock_send park the fiber
+ * until data, window space or EOF arrive, and the main loop keeps
+ * running other connections meanwhile. Must be called from a fiber.
+ */
+
+typedef struct sock sock_t;
+
+/* Events from the TCP layer */
+enum {
+    SOCK_EV_ACKED = 0,      /* Send window opened */
+    SOCK_EV_FIN,            /* Peer finished sending */
+    SOCK_EV_CLOSED          /* TCB is about to be freed */
+};
+
+/* Sets up the socket pool and the httpd thread that formats responses */
+void socket_init(void);
+
+/* Bytes read (> 0), 0 at EOF, -1 on reset or idle timeout */
+int  sock_recv(sock_t *sk, void *buf, uint32_t len);
+
+/* Bytes queued (TSO super-segments or MSS frames), -1 if nothing could be sent */
+int  sock_send(sock_t *sk, const void *buf, uint32_t len);
+
+/* Sends FIN (if the connection is still there) and frees the socket */
+void sock_close(sock_t *sk);
+
+/* TCP -> socket readiness; returns 1 if a socket owns @tcb */
+int  socket_notify(tcp_tcb_t *tcb, int event);
+
+/* Fiber and socket counters (GET /fibers) */
+uint32_t socket_format(char *out, uint32_t out_size);
+
+/* In-order data for @tcb; returns the bytes taken, which TCP acknowledges */
+uint16_t socket_dispatch(tcp_tcb_t *tcb,
+                         uint8_t *payload,
+                         uint16_t len);
 
 #endif
\ No newline at end of file
@@ -4,6 +4,13 @@
 #include <stdint.h>
 
 typedef struct tcp_tcb tcp_tcb_t;
+struct net_meta;
+
+/* Largest payload tcp_send_data() puts in one segment */
+#define TCP_MSS 1400
+
+/* Largest TSO super-segment payload: whole MSS frames, IPv4 length < 64 KB */
+#define TCP_TSO_MAX (46 * TCP_MSS)
 
 /**
  * Initialize TCP subsystem and global ISN.
@@ -12,15 +19,37 @@ void tcp_init(void);
 
 /**
  * Entry point for segments from the IPv4 layer.
- * Parameters must match the TCB 4-tuple lookup.
+ * Parameters must match the TCB 4-tuple lookup. The checksum is only
+ * verified in software when @meta does not carry NET_META_CSUM_VALID.
  */
-void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t dst_ip);
+void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t dst_ip,
+                       const struct net_meta *meta);
 
 /**
  * Application Interface (used by socket.c)
  */
 void tcp_send_data(tcp_tcb_t *tcb, const uint8_t *data, uint16_t len);
+
+/* Sends what the peer window allows (TSO super-segments when the NIC
+ * segments, TCP_MSS frames otherwise); returns bytes queued, 0 if none */
+uint32_t tcp_send_bulk(tcp_tcb_t *tcb, const uint8_t *data, uint32_t len);
 void tcp_close(tcp_tcb_t *tcb);
 void tcp_abort(tcp_tcb_t *tcb);
 
+/**
+ * Per-connection hooks for the socket layer.
+ * The context pointer is cleared (via socket_notify) before a TCB is freed.
+ */
+void     tcp_set_context(tcp_tcb_t *tcb, void *ctx);
+void    *tcp_get_context(tcp_tcb_t *tcb);
+
+/* Bytes the peer window still accepts; 0 when the connection cannot send */
+uint32_t tcp_send_space(tcp_tcb_t *tcb);
+
+/*
+ * Receive window to advertise: the socket's free buffer space. Reopening
+ * a window that had dropped below one MSS sends an update right away.
+ */
+void     tcp_set_rcv_window(tcp_tcb_t *tcb, uint16_t wnd);
+
 #endif
\ No newline at end of file
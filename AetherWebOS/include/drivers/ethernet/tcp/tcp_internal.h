@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "common/utils.h" // For htons/htonl
+#include "kernel/spinlock.h"
 
 #define TCP_PROTO_NUMBER 6
 #define TCP_DEFAULT_WINDOW 8192  // Increased for Chrome buffer comfort
@@ -56,29 +57,43 @@ typedef struct tcp_tcb {
     uint16_t rcv_wnd;       /* Our window */
     uint16_t snd_wnd;       /* Peer window */
 
+    void *context;          /* Owning socket (socket.c), if any */
+
+    volatile uint32_t refcnt;   /* List link + lookups in progress; freed at 0 */
     struct tcp_tcb *next;
 } tcp_tcb_t;
 
 /* Global state symbols */
 extern tcp_tcb_t *tcp_tcb_list;
-extern uint32_t tcp_global_isn;
+extern mcs_lock_t tcp_tcb_lock;     /* Guards tcp_tcb_list links */
+extern volatile uint32_t tcp_global_isn;   /* Bumped with atomic32_fetch_add */
 
 /* --- Internal Pipeline Protos --- */
 
+/* Returns a linked TCB holding a reference for the caller */
 tcp_tcb_t *tcp_allocate_tcb(void);
+
+/* Unlinks @tcb; it is freed once the last reference is dropped */
 void tcp_remove_tcb(tcp_tcb_t *tcb);
 
-/* Updated lookup to handle the full 4-tuple */
+/* Updated lookup to handle the full 4-tuple; a hit holds a reference */
 tcp_tcb_t *tcp_find_tcb(uint32_t src_ip, uint16_t src_port, 
                         uint32_t dst_ip, uint16_t dst_port);
 
+/* Drops a reference from tcp_find_tcb() / tcp_allocate_tcb() */
+void tcp_tcb_put(tcp_tcb_t *tcb);
+
 void tcp_send_segment(tcp_tcb_t *tcb, uint8_t flags, const uint8_t *payload, uint16_t payload_len);
+void tcp_send_segment_gso(tcp_tcb_t *tcb, uint8_t flags, const uint8_t *payload,
+                          uint16_t payload_len, uint16_t gso_size);
 void tcp_send_synack(tcp_tcb_t *tcb);
 void tcp_send_ack(tcp_tcb_t *tcb);
 void tcp_send_fin(tcp_tcb_t *tcb);
 void tcp_send_rst(uint32_t src_ip, uint32_t dst_ip, uint16_t src_port, uint16_t dst_port, uint32_t seq, uint32_t ack);
 
 uint16_t tcp_compute_checksum(uint32_t src_ip, uint32_t dst_ip, const uint8_t *segment, uint16_t length);
+/* Folded, non-inverted pseudo-header sum: the seed a NIC expects for checksum offload */
+uint16_t tcp_pseudo_checksum(uint32_t src_ip, uint32_t dst_ip, uint16_t length);
 int tcp_validate_checksum(uint32_t src_ip, uint32_t dst_ip, const uint8_t *segment, uint16_t length);
 
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "config.h"
+#include "kernel/irq.h"
 
 /* --- PCI Class Codes --- */
 #define PCI_CLASS_MASS_STORAGE    0x01
@@ -18,6 +19,11 @@
 // Combined Class Code for xHCI: Class 0x0C, Subclass 0x03, Prog IF 0x30
 #define PCI_CLASS_CODE_XHCI       0x0C0330
 
+/* --- Capability IDs --- */
+#define PCI_CAP_ID_MSI            0x05
+#define PCI_CAP_ID_VNDR           0x09
+#define PCI_CAP_ID_MSIX           0x11
+
 /* --- Registry Definitions --- */
 
 typedef void (*pci_init_fn)(uint32_t bus, uint32_t dev, uint32_t func);
@@ -43,4 +49,37 @@ void pcie_write_config(uint32_t bus, uint32_t dev, uint32_t func, uint32_t reg,
 void pcie_dump_header(uint32_t bus, uint32_t dev, uint32_t func);
 uint32_t get_total_pci_devices();
 
+/* Config offset of capability @cap_id, or 0 if the device has none */
+uint8_t  pci_find_capability(uint32_t bus, uint32_t dev, uint32_t func, uint8_t cap_id);
+
+/* Physical address of memory BAR @bar; assigns one if firmware left it 0 */
+uint64_t pci_bar_address(uint32_t bus, uint32_t dev, uint32_t func, uint32_t bar);
+
+/* --- MSI-X --- */
+
+/**
+ * MSI-X: each vector is a 16-byte table entry (address, data, mask) in
+ * one of the device's BARs. The address is the ITS doorbell and the data
+ * the EventID, which the ITS turns into an LPI on the chosen core; the
+ * PCI requester ID (bus:dev.func) is the ITS DeviceID.
+ */
+struct pci_msix {
+    uint32_t bus, dev, func;
+    uint8_t  cap;
+    uint16_t nvec;
+    volatile uint32_t *table;
+};
+
+/* Locate and map the table, all vectors masked; 0 or -1 without MSI-X/ITS */
+int  pci_msix_init(struct pci_msix *m, uint32_t bus, uint32_t dev, uint32_t func);
+
+/* Route vector @vec to @cpu and claim the resulting LPI; returns it or -1 */
+int  pci_msix_request(struct pci_msix *m, uint16_t vec, uint32_t cpu,
+                      irq_handler_t handler, irq_bh_t bh, void *ctx, const char *name);
+
+void pci_msix_mask(struct pci_msix *m, uint16_t vec, int masked);
+
+/* Turn MSI-X on (and INTx off) once the vectors are programmed */
+void pci_msix_enable(struct pci_msix *m);
+
 #endif
\ No newline at end of file
@@ -14,6 +14,17 @@
 #define PSCI_SYSTEM_OFF            0x84000008
 #define PSCI_SYSTEM_RESET          0x84000009
 #define PSCI_FEATURES              0x8400000A
+#define PSCI_CPU_ON                0xC4000003
+#define PSCI_AFFINITY_INFO         0xC4000004
+
+/* Return codes */
+#define PSCI_RET_SUCCESS            0
+#define PSCI_RET_NOT_SUPPORTED     -1
+#define PSCI_RET_INVALID_PARAMS    -2
+#define PSCI_RET_DENIED            -3
+#define PSCI_RET_ALREADY_ON        -4
+#define PSCI_RET_ON_PENDING        -5
+#define PSCI_RET_INTERNAL_FAILURE  -6
 
 /**
  * psci_system_off: Gracefully powers down the hardware.
@@ -27,4 +38,11 @@ void psci_system_off(void);
  */
 void psci_system_reset(void);
 
+/**
+ * psci_cpu_on: Powers up the core identified by @target_mpidr.
+ * It starts at physical address @entry at the caller's EL, MMU off,
+ * with @context_id in x0. Returns a PSCI_RET_* code.
+ */
+int psci_cpu_on(uint64_t target_mpidr, uint64_t entry, uint64_t context_id);
+
 #endif /* PSCI_H */
\ No newline at end of file
@@ -34,8 +34,36 @@
 #define GPIO_PUP_PDN_CNTRL_REG0 ((volatile unsigned int*)(GPIO_BASE + 0xE4))
 #endif
 
+/* PL011 interrupt bits (IMSC / RIS / MIS / ICR) */
+#define UART_INT_RX    (1 << 4)
+#define UART_INT_TX    (1 << 5)
+#define UART_INT_RT    (1 << 6)   // Receive timeout
+#define UART_INT_OE    (1 << 10)  // Overrun
+
+/* Ring sizes (power of two) */
+#define UART_TX_RING_SIZE  4096
+#define UART_RX_RING_SIZE  256
+
+/**
+ * Console counters. Output is never allowed to stall the caller:
+ * anything that does not fit in the TX ring is dropped and counted.
+ */
+typedef struct {
+    unsigned long tx_bytes;       // Bytes handed to the TX FIFO
+    unsigned long tx_dropped;     // Bytes lost because the TX ring was full
+    unsigned long rx_bytes;       // Bytes taken from the RX FIFO
+    unsigned long rx_overflows;   // Bytes lost because the RX ring was full
+    unsigned long hw_overruns;    // PL011 FIFO overruns reported by hardware
+    unsigned long irqs;           // UART interrupts serviced
+} uart_stats_t;
+
 /* Function Prototypes */
 void uart_init();
+void uart_irq_init(void);
+void uart_handle_irq(void);
+void uart_flush(void);
+void uart_console_sync(void);
+const uart_stats_t *uart_get_stats(void);
 void uart_putc(unsigned char c);
 void uart_puts(const char* str);
 unsigned char uart_getc();
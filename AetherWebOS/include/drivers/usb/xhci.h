@@ -36,6 +36,25 @@ struct xhci_op_regs {
     uint32_t config;           // Max Device Slots Enabled
 } __attribute__((packed));
 
+/**
+ * 3. Transfer Request Block
+ * The unit of every ring (command, event, transfer). 16 bytes.
+ */
+struct xhci_trb {
+    uint64_t parameter;
+    uint32_t status;
+    uint32_t control;          // Bit 0: Cycle, bits 15:10: TRB Type
+} __attribute__((packed, aligned(16)));
+
+/**
+ * 4. Event Ring Segment Table entry
+ */
+struct xhci_erst_entry {
+    uint64_t ring_base;        // 64-byte aligned segment
+    uint32_t ring_size;        // TRBs in the segment
+    uint32_t reserved;
+} __attribute__((packed, aligned(16)));
+
 void xhci_init(uint32_t bus, uint32_t dev, uint32_t func);
 
 #endif
\ No newline at end of file
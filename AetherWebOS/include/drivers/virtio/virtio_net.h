@@ -7,6 +7,7 @@
  * without redefinition errors.
  */
 #include "drivers/virtio/virtio_ring.h"
+#include "kernel/smp.h"
 
 /* --- VIRTIO PCI VENDOR/DEVICE IDS --- */
 #define VIRTIO_VENDOR_ID           0x1AF4
@@ -29,9 +30,35 @@
 
 /* --- VIRTIO NET FEATURE BITS --- */
 #define VIRTIO_NET_F_CSUM           (1ULL << 0)
+#define VIRTIO_NET_F_GUEST_CSUM     (1ULL << 1)
 #define VIRTIO_NET_F_MAC            (1ULL << 5)
+#define VIRTIO_NET_F_GUEST_TSO4     (1ULL << 7)
+#define VIRTIO_NET_F_HOST_TSO4      (1ULL << 11)
+#define VIRTIO_NET_F_MRG_RXBUF      (1ULL << 15)
 #define VIRTIO_NET_F_STATUS         (1ULL << 16)
+#define VIRTIO_NET_F_CTRL_VQ        (1ULL << 17)
 #define VIRTIO_NET_F_MTU            (1ULL << 19)
+#define VIRTIO_NET_F_MQ             (1ULL << 22)
+#define VIRTIO_NET_F_RSS            (1ULL << 60)
+
+/* --- TRANSPORT FEATURE BITS --- */
+#define VIRTIO_F_ANY_LAYOUT         (1ULL << 27)
+#define VIRTIO_RING_F_INDIRECT_DESC (1ULL << 28)
+#define VIRTIO_F_VERSION_1          (1ULL << 32)
+#define VIRTIO_F_RING_PACKED        (1ULL << 34)
+#define VIRTIO_F_IN_ORDER           (1ULL << 35)
+
+/* --- CONTROL QUEUE --- */
+#define VIRTIO_NET_OK               0
+#define VIRTIO_NET_ERR              1
+
+#define VIRTIO_NET_CTRL_MQ                  4
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET     0
+#define VIRTIO_NET_CTRL_MQ_RSS_CONFIG       1
+
+#define VIRTIO_NET_RSS_HASH_TYPE_IPv4       (1U << 0)
+#define VIRTIO_NET_RSS_HASH_TYPE_TCPv4      (1U << 1)
+#define VIRTIO_NET_RSS_HASH_TYPE_UDPv4      (1U << 2)
 
 /**
  * 1. PCI Capability Structure
@@ -57,9 +84,22 @@ void virtio_pci_init(uint32_t bus, uint32_t dev, uint32_t func);
 void virtio_net_init(struct virtio_pci_device *vdev);
 
 /* Network polling */
-void virtio_net_poll(struct virtio_pci_device *vdev);
+int virtio_net_poll(struct virtio_pci_device *vdev, int budget);
 
 // include/drivers/virtio/virtio_net.h
+/* virtio_net_hdr.flags */
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM  1   // csum_start/csum_offset are valid
+#define VIRTIO_NET_HDR_F_DATA_VALID  2   // RX: device checked the checksum
+
+/* virtio_net_hdr.gso_type */
+#define VIRTIO_NET_HDR_GSO_NONE      0
+#define VIRTIO_NET_HDR_GSO_TCPV4     1
+
+/*
+ * 12 bytes: with VERSION_1, num_buffers is always there (legacy: MRG_RXBUF
+ * only). On RX with MRG_RXBUF it counts the buffers the frame occupies;
+ * the header sits in the first one only.
+ */
 struct virtio_net_hdr {
     uint8_t flags;
     uint8_t gso_type;
@@ -67,11 +107,126 @@ struct virtio_net_hdr {
     uint16_t gso_size;
     uint16_t csum_start;
     uint16_t csum_offset;
-    // uint16_t num_buffers; // Only if VIRTIO_F_MRG_RXBUF is negotiated
+    uint16_t num_buffers;
 } __attribute__((packed));
 
 typedef struct virtio_net_hdr virtio_net_rx_hdr_t;
 typedef struct virtio_net_hdr virtio_net_tx_hdr_t;
-void net_tx_reaper();
+int net_tx_reaper(int budget);
 void virtio_net_setup_queues(struct virtio_pci_device *vdev);
+
+/*
+ * TX ring benchmark: pushes @frames minimum-size broadcast frames through
+ * the calling core's TX queue and reaps them. Writes a one-line report
+ * (ring layout, frames, elapsed time, frames per second) to @out.
+ * The layout is fixed at negotiation: compare split and packed with one
+ * run per build (VIRTIO_RING=split / packed).
+ */
+uint32_t virtio_net_bench(uint32_t frames, char *out, uint32_t out_size);
+
+/* --- NAPI: interrupt/poll hybrid --- */
+
+/**
+ * With an MSI-X vector a queue runs in one of two modes. Idle, its
+ * interrupt is armed. The first interrupt suppresses further ones
+ * (VRING_AVAIL_F_NO_INTERRUPT) and queues a poll at SCHED_PRIO_NET that
+ * drains up to the weight per pass, requeueing itself while it keeps
+ * finding work. Once the ring has stayed empty for the linger time the
+ * interrupt is re-armed and the ring re-checked, so a buffer used in
+ * between is never stranded. Queues without a vector are drained by the net_rx /
+ * net_tx pollers instead.
+ */
+#ifndef VNET_NAPI_WEIGHT
+#define VNET_NAPI_WEIGHT       64      /* Buffers per poll pass */
+#endif
+
+#ifndef VNET_NAPI_LINGER_NS
+#define VNET_NAPI_LINGER_NS    50000ULL    /* Idle time in poll mode before re-arming */
+#endif
+
+typedef struct {
+    unsigned long irqs;                /* Queue interrupts taken */
+    unsigned long polls;               /* Poll passes */
+    unsigned long packets;             /* Buffers handled by polls */
+    unsigned long budget_hits;         /* Passes that used the whole weight */
+    unsigned long rearms;              /* Returns to interrupt mode */
+    unsigned long rearm_races;         /* Work found right after re-arming */
+} vnet_napi_stats_t;
+
+/* --- Multiqueue --- */
+
+/**
+ * With VIRTIO_NET_F_MQ (and MSI-X) the device gets one RX/TX pair per
+ * core, up to VNET_MAX_PAIRS: pair N's rings, buffers and NAPI context
+ * are private to it and its vectors are routed to CPU N, so a queue is
+ * only ever polled on one core. RX frames then go through rss_receive(),
+ * which hands each flow to the core its Toeplitz hash maps to; when the
+ * device offers VIRTIO_NET_F_RSS it is programmed with the same key and
+ * table and every frame already arrives on the right core.
+ *
+ * Until virtio_net_enable_mq() runs only pair 0 is in use, and its
+ * queues are what vdev->rx_vq / tx_vq point at.
+ */
+#define VNET_MAX_PAIRS         MAX_CPUS
+
+/* Queue numbers as used by virtio_net_get_napi_stats() */
+#define VNET_RXQ(pair)         ((pair) * 2)
+#define VNET_TXQ(pair)         ((pair) * 2 + 1)
+
+/* Moderation tunables; @weight 0 keeps the current weight, @linger_ns 0
+ * re-arms as soon as a pass finds the ring empty */
+void virtio_net_set_moderation(uint16_t weight, uint64_t linger_ns);
+
+void virtio_net_get_napi_stats(int queue, vnet_napi_stats_t *out);
+
+/*
+ * Caps for the next virtio_net_init(): queue pairs to set up (at most
+ * VNET_MAX_PAIRS) and RX / TX ring sizes (at most VNET_QUEUE_SIZE_MAX,
+ * rounded down to a power of two; the device's own maximum wins when
+ * smaller). 0 keeps a value. Rings and buffers come from the DMA
+ * zone, sized by what was negotiated.
+ */
+void virtio_net_set_queues(uint16_t pairs, uint16_t rx_size, uint16_t tx_size);
+
+#define VNET_QUEUE_SIZE_MAX    1024
+
+/* Pairs in use (1 until virtio_net_enable_mq) */
+uint16_t virtio_net_nr_pairs(void);
+
+/* Called once the secondaries are online: spread the pairs over the
+ * cores, route their vectors and set up RSS steering */
+void virtio_net_enable_mq(struct virtio_pci_device *vdev);
+
+/* VIRTIO_NET_F_CSUM was negotiated: the device finishes TX checksums */
+int virtio_net_tx_csum(void);
+
+/* VIRTIO_NET_F_HOST_TSO4 was negotiated: the device segments TCP */
+int virtio_net_tx_tso(void);
+
+/*
+ * Queues @buf (virtio-net header + frame from dma_alloc(DMA_STREAMING),
+ * dma_free'd with @len once sent) on this core's
+ * TX queue. With @more set the doorbell is left for a later frame or
+ * virtio_net_tx_flush(), unless the queue is filling up. Returns -1 if
+ * the ring stayed full; @buf is then still the caller's.
+ */
+int virtio_net_xmit(void *buf, uint32_t len, int more);
+
+struct netbuf;
+
+/*
+ * virtio_net_xmit() for a frame in up to VNET_TX_MAX_FRAGS buffers (the
+ * first holding the virtio-net header); every link's buffer is freed
+ * once sent. With VIRTIO_RING_F_INDIRECT_DESC the fragment list goes in
+ * an indirect table and the frame takes one ring slot, else one each.
+ */
+int virtio_net_xmit_sg(const struct netbuf *frags, int more);
+
+#define VNET_TX_MAX_FRAGS      4
+
+/* Publish and notify whatever this core's TX queue holds back */
+void virtio_net_tx_flush(void);
+
+/* Per-queue NAPI counters (GET /napi) */
+uint32_t virtio_net_format(char *out, uint32_t out_size);
 #endif
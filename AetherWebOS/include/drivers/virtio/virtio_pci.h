@@ -2,6 +2,7 @@
 #define VIRTIO_PCI_H
 
 #include <stdint.h>
+#include "drivers/pcie.h"
 
 /* --- VirtIO Capability Types --- */
 #define VIRTIO_PCI_CAP_COMMON_CFG   1
@@ -9,6 +10,9 @@
 #define VIRTIO_PCI_CAP_ISR_CFG      3
 #define VIRTIO_PCI_CAP_DEVICE_CFG   4
 
+/* Written to a *_msix_vector register: no interrupt for this source */
+#define VIRTIO_MSI_NO_VECTOR        0xFFFF
+
 /**
  * struct virtio_pci_common_cfg: The Control Panel
  * This matches the official VirtIO 1.0 specification for Modern PCI.
@@ -49,6 +53,11 @@ struct virtio_net_config {
     uint16_t status;
     uint16_t max_virtqueue_pairs;
     uint16_t mtu;
+    uint32_t speed;
+    uint8_t  duplex;
+    uint8_t  rss_max_key_size;                  /* VIRTIO_NET_F_RSS only */
+    uint16_t rss_max_indirection_table_length;
+    uint32_t supported_hash_types;
 } __attribute__((packed));
 
 /* Forward declaration for the virtqueue structure */
@@ -71,6 +80,12 @@ struct virtio_pci_device {
 
     struct virtqueue *rx_vq;
     struct virtqueue *tx_vq;
+
+    /* MSI-X: one vector per queue when the ITS is present, else polled */
+    struct pci_msix   msix;
+    int               msix_ready;
+    int               rx_lpi;
+    int               tx_lpi;
 };
 
 /* --- Global Reference for Aether WebOS Portal --- */
@@ -98,4 +113,13 @@ void virtio_pci_cap_lookup(struct virtio_pci_device *vdev);
  */
 void virtio_pci_reset(struct virtio_pci_device *vdev);
 
+/**
+ * virtio_pci_queue_vector: Routes queue @queue_index to MSI-X vector @vec
+ * on @cpu. Must run after queue_select and before the queue is enabled;
+ * returns the LPI, or -1 (queue stays polled) if the device refused it.
+ */
+int virtio_pci_queue_vector(struct virtio_pci_device *vdev, uint16_t queue_index,
+                            uint16_t vec, uint32_t cpu, irq_handler_t handler,
+                            void *ctx, const char *name);
+
 #endif /* VIRTIO_PCI_H */
\ No newline at end of file
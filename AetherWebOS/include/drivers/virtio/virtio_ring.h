@@ -3,12 +3,23 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "kernel/spinlock.h"
 
 /* --- Descriptor Flags --- */
 #define VIRTQ_DESC_F_NEXT    1   // Marks this descriptor as continuing in a chain
 #define VIRTQ_DESC_F_WRITE   2   // Marks this buffer as writeable by hardware (for RX)
 #define VIRTQ_DESC_F_INDIRECT 4  // Advanced: buffer contains list of descriptors
 
+/* --- Ring Flags --- */
+#define VRING_AVAIL_F_NO_INTERRUPT  1   // Driver -> device: don't interrupt on used buffers
+
+/* --- Packed Ring Flags (VIRTIO_F_RING_PACKED) --- */
+#define VRING_PACKED_DESC_F_AVAIL   (1 << 7)    // Equal to the driver's wrap counter when made available
+#define VRING_PACKED_DESC_F_USED    (1 << 15)   // Set equal to F_AVAIL by the device when used
+
+#define VRING_PACKED_EVENT_FLAG_ENABLE   0
+#define VRING_PACKED_EVENT_FLAG_DISABLE  1
+
 /* ==========================================================================
    VIRTIO 1.0 STRUCTURES (Strict Alignment Required)
    ========================================================================== */
@@ -54,6 +65,32 @@ struct virtq_used {
     /* Note: avail_event follows the ring array at the very end */
 } __attribute__((packed, aligned(4)));
 
+/* ==========================================================================
+   VIRTIO 1.1 PACKED RING
+   ========================================================================== */
+
+/**
+ * struct vring_packed_desc: One slot of the single packed ring
+ * The driver writes available buffers into it, the device overwrites
+ * the same slots with used ones; AVAIL/USED against the wrap counters
+ * tell which is which, so there are no separate index rings to touch.
+ */
+struct vring_packed_desc {
+    uint64_t addr;   /* PHYSICAL address of the data buffer */
+    uint32_t len;    /* Buffer length / bytes written when used */
+    uint16_t id;     /* Buffer ID: the chain's head in the shadow table */
+    uint16_t flags;  /* NEXT / WRITE / AVAIL / USED */
+} __attribute__((packed, aligned(16)));
+
+/**
+ * struct vring_packed_desc_event: Event suppression area
+ * One for the driver (interrupt suppression), one for the device.
+ */
+struct vring_packed_desc_event {
+    uint16_t off_wrap;
+    uint16_t flags;  /* VRING_PACKED_EVENT_FLAG_* */
+} __attribute__((packed, aligned(4)));
+
 /* ==========================================================================
    KERNEL TRACKING STRUCTURE
    ========================================================================== */
@@ -72,7 +109,37 @@ struct virtqueue {
 
     uint16_t free_head;         /* Index of the next available free descriptor */
     uint16_t num_free;          /* How many descriptors are currently unused */
-    uint16_t last_used_idx;     /* Last receipt we processed from the Used Ring */
+    uint16_t last_used_idx;     /* Last receipt we processed (packed: ring slot) */
+    uint16_t avail_idx;         /* Split: avail->idx once the pending batch is kicked */
+
+    /*
+     * Packed layout: desc is then a driver-private shadow table indexed
+     * by buffer ID (same free list, same chaining), and ring is what the
+     * device sees. Chains are copied into consecutive slots when made
+     * available; the first head of a batch is flipped last, on kick.
+     */
+    uint8_t  packed;
+    uint8_t  in_order;          /* VIRTIO_F_IN_ORDER: used in the order made available */
+    uint8_t  fixed;             /* Descriptors bound to buffers: no free list */
+    struct vring_packed_desc *ring;
+    struct vring_packed_desc_event *driver_event;
+    struct vring_packed_desc_event *device_event;
+    uint16_t next_avail;        /* Slot the next chain is written to */
+    uint8_t  avail_wrap;        /* Driver ring wrap counter */
+    uint8_t  used_wrap;         /* Wrap counter at last_used_idx */
+    uint16_t batch_slot;        /* Packed: first slot of the pending batch */
+    uint16_t batch_flags;       /* ... and the flags it gets on kick */
+    uint16_t batch_pending;     /* Chains added since the last kick */
+
+    /* In-order: heads in ring order; one used slot may close a batch of them */
+    uint16_t *order;
+    uint16_t order_head;
+    uint16_t order_tail;
+    uint16_t used_last_id;      /* Last buffer of the batch being popped */
+    uint32_t used_last_len;
+    uint8_t  used_batch;        /* Still popping that batch */
+
+    spinlock_t lock;            /* Guards the free list and both ring indices */
 };
 
 // Forward declaration for the notify helper
@@ -80,8 +147,14 @@ struct virtio_pci_device;
 
 /* --- Function Prototypes for the Implementation Team --- */
 
+/* Bytes of device-visible memory (desc/avail/used or ring + events) for @size */
+size_t virtqueue_ring_bytes(uint16_t size, int packed);
+
 /* Pritam: Initializes the tracking struct and binds it to the PCI device */
 void virtqueue_init(struct virtqueue *vq, uint16_t size, uint16_t index, void *p);
+
+/* Packed layout in @p (16 * size + 8 bytes); returns -1 if the shadow table cannot be allocated */
+int virtqueue_init_packed(struct virtqueue *vq, uint16_t size, uint16_t index, void *p, int in_order);
 void virtio_pci_bind_queue(struct virtio_pci_device *vdev, struct virtqueue *vq);
 
 /* Common: Adds a buffer to the descriptor table */
@@ -90,9 +163,51 @@ uint16_t virtqueue_add_descriptor(struct virtqueue *vq, uint64_t virt_addr, uint
 /* Roheet: Updates the Available ring index and notifies the hardware */
 void virtqueue_push_available(struct virtio_pci_device *vdev, struct virtqueue *vq, uint16_t desc_head);
 
+/*
+ * @n device-readable buffers as one frame: a chain of @n descriptors, or
+ * (VIRTIO_RING_F_INDIRECT_DESC) a single descriptor pointing at @table,
+ * which the caller provides with room for @n entries and gets back once
+ * the head is used. Returns the head, or 0xFFFF if the ring is short.
+ */
+uint16_t virtqueue_add_chain(struct virtqueue *vq, const uint64_t *addrs, const uint32_t *lens, uint16_t n);
+uint16_t virtqueue_add_indirect(struct virtqueue *vq, void *table,
+                                const uint64_t *addrs, const uint32_t *lens, uint16_t n);
+
+/* Batched form of the above: queue chains, then publish them all and notify once */
+void virtqueue_add_available(struct virtqueue *vq, uint16_t desc_head);
+uint16_t virtqueue_kick(struct virtio_pci_device *vdev, struct virtqueue *vq);   /* Chains published */
+
+/*
+ * RX fast path: descriptor @id permanently describes @virt_addr. Once a
+ * queue has bound buffers it stops using the free list; a used
+ * descriptor is handed back with virtqueue_rx_recycle() (published on
+ * the next kick), which writes nothing but its id into the ring.
+ */
+void virtqueue_bind_buffer(struct virtqueue *vq, uint16_t id, uint64_t virt_addr, uint32_t len, uint16_t flags);
+void virtqueue_rx_recycle(struct virtqueue *vq, const uint16_t *ids, uint16_t count);
+
 /* Adrija: Checks the Used ring and returns a processed descriptor ID */
 int virtqueue_pop_used(struct virtqueue *vq, uint32_t *len_out);
 
+/*
+ * virtqueue_pop_used() that also copies up to @max descriptors of the
+ * chain into @chain_out (count in @count_out) before it goes back on the
+ * free list: on a queue shared between cores the ring entries may be
+ * rewritten as soon as this returns. Not for bound (fixed) queues.
+ */
+int virtqueue_pop_used_chain(struct virtqueue *vq, uint32_t *len_out,
+                             struct virtq_desc *chain_out, uint16_t max, uint16_t *count_out);
+
 void virtqueue_notify(struct virtio_pci_device *vdev, uint16_t queue_index);
 
+/* Used buffers waiting to be popped? */
+int virtqueue_has_used(struct virtqueue *vq);
+
+/* Suppress / re-allow used-buffer interrupts (VRING_AVAIL_F_NO_INTERRUPT) */
+void virtqueue_disable_cb(struct virtqueue *vq);
+
+/* Returns non-zero if buffers were used before the flag reached the
+ * device; the caller must poll again, an interrupt may not follow. */
+int virtqueue_enable_cb(struct virtqueue *vq);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,210 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdint.h>
+
+/**
+ * Aether Atomics
+ *
+ * ARMv8.1 LSE instructions (LDADD, CAS, SWP) when the core has them,
+ * LDXR/STXR loops otherwise. The choice is made at run time from
+ * ID_AA64ISAR0_EL1.Atomic by atomic_init(); before that every call
+ * takes the LL/SC path, which works on all ARMv8 cores.
+ *
+ * The kernel is built for cortex-a72 (ARMv8.0), so LSE sequences are
+ * assembled under ".arch_extension lse" and only reached when present.
+ *
+ * Naming: *_relaxed has no ordering (statistics), the plain forms are
+ * fully ordered (acquire + release).
+ */
+
+extern int cpu_has_lse;
+
+void atomic_init(void);
+
+#define LSE_PREAMBLE   ".arch_extension lse\n"
+
+/* =====================================================
+   64-bit
+   ===================================================== */
+
+static inline uint64_t atomic64_fetch_add_relaxed(volatile uint64_t *p, uint64_t v)
+{
+    uint64_t old;
+
+    if (cpu_has_lse) {
+        asm volatile(LSE_PREAMBLE
+                     "ldadd %x[v], %x[old], %[mem]"
+                     : [old] "=r" (old), [mem] "+Q" (*p)
+                     : [v] "r" (v));
+    } else {
+        uint64_t tmp;
+        uint32_t fail;
+        asm volatile("1: ldxr  %x[old], %[mem]\n"
+                     "   add   %x[tmp], %x[old], %x[v]\n"
+                     "   stxr  %w[fail], %x[tmp], %[mem]\n"
+                     "   cbnz  %w[fail], 1b\n"
+                     : [old] "=&r" (old), [tmp] "=&r" (tmp),
+                       [fail] "=&r" (fail), [mem] "+Q" (*p)
+                     : [v] "r" (v));
+    }
+
+    return old;
+}
+
+static inline uint64_t atomic64_fetch_add(volatile uint64_t *p, uint64_t v)
+{
+    uint64_t old;
+
+    if (cpu_has_lse) {
+        asm volatile(LSE_PREAMBLE
+                     "ldaddal %x[v], %x[old], %[mem]"
+                     : [old] "=r" (old), [mem] "+Q" (*p)
+                     : [v] "r" (v)
+                     : "memory");
+    } else {
+        uint64_t tmp;
+        uint32_t fail;
+        asm volatile("1: ldaxr %x[old], %[mem]\n"
+                     "   add   %x[tmp], %x[old], %x[v]\n"
+                     "   stlxr %w[fail], %x[tmp], %[mem]\n"
+                     "   cbnz  %w[fail], 1b\n"
+                     : [old] "=&r" (old), [tmp] "=&r" (tmp),
+                       [fail] "=&r" (fail), [mem] "+Q" (*p)
+                     : [v] "r" (v)
+                     : "memory");
+    }
+
+    return old;
+}
+
+static inline uint64_t atomic64_xchg(volatile uint64_t *p, uint64_t v)
+{
+    uint64_t old;
+
+    if (cpu_has_lse) {
+        asm volatile(LSE_PREAMBLE
+                     "swpal %x[v], %x[old], %[mem]"
+                     : [old] "=r" (old), [mem] "+Q" (*p)
+                     : [v] "r" (v)
+                     : "memory");
+    } else {
+        uint32_t fail;
+        asm volatile("1: ldaxr %x[old], %[mem]\n"
+                     "   stlxr %w[fail], %x[v], %[mem]\n"
+                     "   cbnz  %w[fail], 1b\n"
+                     : [old] "=&r" (old), [fail] "=&r" (fail), [mem] "+Q" (*p)
+                     : [v] "r" (v)
+                     : "memory");
+    }
+
+    return old;
+}
+
+/* Returns the value found at @p; the swap happened iff it equals @expected */
+static inline uint64_t atomic64_cmpxchg(volatile uint64_t *p, uint64_t expected, uint64_t desired)
+{
+    uint64_t old;
+
+    if (cpu_has_lse) {
+        old = expected;
+        asm volatile(LSE_PREAMBLE
+                     "casal %x[old], %x[new], %[mem]"
+                     : [old] "+r" (old), [mem] "+Q" (*p)
+                     : [new] "r" (desired)
+                     : "memory");
+    } else {
+        uint32_t fail;
+        asm volatile("1: ldaxr %x[old], %[mem]\n"
+                     "   cmp   %x[old], %x[exp]\n"
+                     "   b.ne  2f\n"
+                     "   stlxr %w[fail], %x[new], %[mem]\n"
+                     "   cbnz  %w[fail], 1b\n"
+                     "2:\n"
+                     : [old] "=&r" (old), [fail] "=&r" (fail), [mem] "+Q" (*p)
+                     : [exp] "r" (expected), [new] "r" (desired)
+                     : "memory", "cc");
+    }
+
+    return old;
+}
+
+/* =====================================================
+   32-bit
+   ===================================================== */
+
+static inline uint32_t atomic32_fetch_add(volatile uint32_t *p, uint32_t v)
+{
+    uint32_t old;
+
+    if (cpu_has_lse) {
+        asm volatile(LSE_PREAMBLE
+                     "ldaddal %w[v], %w[old], %[mem]"
+                     : [old] "=r" (old), [mem] "+Q" (*p)
+                     : [v] "r" (v)
+                     : "memory");
+    } else {
+        uint32_t tmp, fail;
+        asm volatile("1: ldaxr %w[old], %[mem]\n"
+                     "   add   %w[tmp], %w[old], %w[v]\n"
+                     "   stlxr %w[fail], %w[tmp], %[mem]\n"
+                     "   cbnz  %w[fail], 1b\n"
+                     : [old] "=&r" (old), [tmp] "=&r" (tmp),
+                       [fail] "=&r" (fail), [mem] "+Q" (*p)
+                     : [v] "r" (v)
+                     : "memory");
+    }
+
+    return old;
+}
+
+static inline uint32_t atomic32_cmpxchg(volatile uint32_t *p, uint32_t expected, uint32_t desired)
+{
+    uint32_t old;
+
+    if (cpu_has_lse) {
+        old = expected;
+        asm volatile(LSE_PREAMBLE
+                     "casal %w[old], %w[new], %[mem]"
+                     : [old] "+r" (old), [mem] "+Q" (*p)
+                     : [new] "r" (desired)
+                     : "memory");
+    } else {
+        uint32_t fail;
+        asm volatile("1: ldaxr %w[old], %[mem]\n"
+                     "   cmp   %w[old], %w[exp]\n"
+                     "   b.ne  2f\n"
+                     "   stlxr %w[fail], %w[new], %[mem]\n"
+                     "   cbnz  %w[fail], 1b\n"
+                     "2:\n"
+                     : [old] "=&r" (old), [fail] "=&r" (fail), [mem] "+Q" (*p)
+                     : [exp] "r" (expected), [new] "r" (desired)
+                     : "memory", "cc");
+    }
+
+    return old;
+}
+
+/* =====================================================
+   Helpers
+   ===================================================== */
+
+#define atomic_read(p)       __atomic_load_n((p), __ATOMIC_RELAXED)
+#define atomic_set(p, v)     __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define smp_load_acquire(p)  __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+#define smp_mb()    asm volatile("dmb ish"   ::: "memory")
+#define smp_rmb()   asm volatile("dmb ishld" ::: "memory")
+#define smp_wmb()   asm volatile("dmb ishst" ::: "memory")
+
+/* Counter bump for shared statistics (unsigned long is 64-bit here) */
+static inline void stat_add(volatile unsigned long *counter, unsigned long v)
+{
+    atomic64_fetch_add_relaxed((volatile uint64_t *)counter, v);
+}
+
+#define stat_inc(counter)   stat_add((counter), 1)
+#define stat_dec(counter)   stat_add((counter), (unsigned long)-1)
+
+#endif
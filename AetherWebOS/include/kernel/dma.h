@@ -0,0 +1,71 @@
+#ifndef DMA_H
+#define DMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+/**
+ * DMA zone allocator.
+ *
+ * Memory a device reads or writes (virtqueue rings, indirect tables,
+ * packet buffers, xHCI contexts) comes from one physically contiguous
+ * zone after the heap, DMA_ZONE_START..+DMA_ZONE_SIZE, split into two
+ * arenas by how the CPU maps it:
+ *
+ *   DMA_COHERENT   Normal non-cacheable. CPU and device always agree, no
+ *                  maintenance needed: rings and control structures that
+ *                  both sides poll.
+ *   DMA_STREAMING  Normal write-back. Ownership moves explicitly with
+ *                  dma_sync_for_device() / dma_sync_for_cpu(): packet
+ *                  buffers, written or read once per trip.
+ *
+ * Requests up to DMA_SMALL_MAX bytes come from power-of-two size classes
+ * carved out of whole pages, so they are cache-line aligned and never
+ * share a line with anything else; larger ones are a run of contiguous
+ * pages. dma_free() takes the size back, which the caller (usually a
+ * descriptor length) has at hand anyway.
+ *
+ * Devices are given bus addresses (dma_to_bus()), never pointers.
+ */
+
+#define DMA_COHERENT        0x00
+#define DMA_STREAMING       0x01
+#define DMA_ZERO            0x02        /* Cleared before it is returned */
+
+#define DMA_ALIGN           64          /* Cache line */
+#define DMA_SMALL_MAX       2048        /* Larger requests take whole pages */
+
+typedef struct {
+    uint32_t      pages;                /* Arena size */
+    uint32_t      pages_used;           /* Runs handed out + pages carved into classes */
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long failures;             /* Arena exhausted */
+} dma_stats_t;
+
+void  dma_init(void);
+
+/* @size bytes, physically contiguous and DMA_ALIGN aligned, or NULL */
+void *dma_alloc(size_t size, uint32_t flags);
+void  dma_free(void *ptr, size_t size);
+
+/* The RAM is identity-mapped: only the board's inbound offset differs */
+static inline uint64_t dma_to_bus(const void *ptr)
+{
+    return (uint64_t)(uintptr_t)ptr + DMA_BUS_OFFSET;
+}
+
+static inline void *dma_from_bus(uint64_t bus)
+{
+    return (void *)(uintptr_t)(bus - DMA_BUS_OFFSET);
+}
+
+/* Streaming buffers: no-ops on coherent memory */
+void dma_sync_for_device(const void *ptr, size_t size);
+void dma_sync_for_cpu(const void *ptr, size_t size);
+
+void     dma_get_stats(uint32_t flags, dma_stats_t *out);
+uint32_t dma_format(char *out, uint32_t out_size);
+
+#endif
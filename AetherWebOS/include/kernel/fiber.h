@@ -0,0 +1,118 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <stdint.h>
+#include "kernel/hrtimer.h"
+#include "kernel/spinlock.h"
+
+/**
+ * Stackful fibers (cooperative coroutines).
+ *
+ * A fiber is a function with its own small stack that can stop in the
+ * middle (fiber_park) and be resumed later, so connection
+ * handlers read like sequential code instead of per-segment callbacks.
+ * Switching saves only the callee-saved registers (fiber_switch.S); no
+ * exception, no scheduler lock, a few dozen cycles.
+ *
+ * Fibers never preempt each other. Each core runs its own ready fibers
+ * from a scheduler poller at SCHED_PRIO_NET, inside whatever thread owns
+ * that core's main loop, so fibers on one core see the same single-
+ * threaded world as the rest of the network stack. A fiber stays on the
+ * core that spawned it; fiber_unpark() from another core is forwarded
+ * there with smp_call_on(), and wait lists may be shared across cores.
+ *
+ * Stacks come from a static pool of FIBER_MAX x FIBER_STACK_SIZE and are
+ * returned when the fiber function returns. IRQs taken while a fiber runs
+ * push their frame on the fiber stack, so keep large buffers off it.
+ */
+
+#define FIBER_MAX           64
+#define FIBER_STACK_SIZE    0x4000          /* 16 KB */
+#define FIBER_RUN_BUDGET    32              /* Resumes per poller pass */
+
+typedef void (*fiber_fn_t)(void *arg);
+
+/* Saved by fiber_switch: x19-x28, fp, lr, sp */
+struct fiber_ctx {
+    uint64_t regs[13];
+};
+
+typedef enum {
+    FIBER_FREE = 0,
+    FIBER_READY,
+    FIBER_RUNNING,
+    FIBER_PARKED,
+    FIBER_DONE                      /* Returned; stack freed by the poller */
+} fiber_state_t;
+
+struct fiber {
+    struct fiber_ctx  ctx;
+    const char       *name;
+    fiber_fn_t        fn;
+    void             *arg;
+    volatile uint8_t  state;
+    volatile uint8_t  woken;        /* fiber_unpark() ran since last park */
+    uint8_t           cpu;
+    struct hrtimer    timeout;
+    struct fiber     *next;         /* Ready / free list link */
+    struct fiber     *wait_next;    /* fiber_waitq link */
+    uint64_t         *stack;        /* Lowest word holds the canary */
+    unsigned long     switches;
+};
+
+/* Fibers parked until fiber_wake_one/all() */
+struct fiber_waitq {
+    spinlock_t    lock;
+    struct fiber *head;
+    struct fiber *tail;
+};
+
+typedef struct {
+    unsigned long spawned;
+    unsigned long exhausted;        /* fiber_spawn() found no free stack */
+    unsigned long switches;
+    unsigned long timeouts;
+    unsigned long overflows;        /* Canary found clobbered */
+    uint32_t      live;
+    uint32_t      peak;
+} fiber_stats_t;
+
+void fiber_init(void);
+
+/* Queue a new fiber on the calling core; NULL when the pool is empty */
+struct fiber *fiber_spawn(const char *name, fiber_fn_t fn, void *arg);
+
+/* The running fiber, or NULL outside fiber context */
+struct fiber *fiber_current(void);
+
+/*
+ * Fibers of this core waiting to run. Unparks and timeouts queue them
+ * from IRQ context, so idle paths test this with IRQs masked, next to
+ * sched_has_pending_work(), before they WFI.
+ */
+int fiber_has_ready(void);
+
+/*
+ * Stop until fiber_unpark() or @timeout_ns elapses (0 = no timeout).
+ * Returns 0 when unparked, -1 on timeout. A wakeup that arrives between
+ * the caller's check and the park is not lost.
+ */
+int fiber_park(uint64_t timeout_ns);
+
+/* Make @f runnable again; safe from IRQ handlers and threads on its core */
+void fiber_unpark(struct fiber *f);
+
+void fiber_waitq_init(struct fiber_waitq *wq);
+void fiber_wait(struct fiber_waitq *wq);
+
+/*
+ * For waiters whose condition is changed on other cores: check it under
+ * wq->lock (spin_lock_irqsave, @flags its result) and call this if it
+ * does not hold yet; the lock is dropped once the fiber is on the list.
+ */
+void fiber_wait_locked(struct fiber_waitq *wq, uint64_t flags);
+void fiber_wake_one(struct fiber_waitq *wq);
+
+void fiber_get_stats(fiber_stats_t *out);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef FPSIMD_H
+#define FPSIMD_H
+
+#include <stdint.h>
+
+/**
+ * Kernel-mode FP/SIMD (NEON) support.
+ *
+ * The kernel is built with -mgeneral-regs-only, so ordinary code never
+ * touches V0-V31. Translation units named *_neon.c are compiled without
+ * that restriction (see Makefile) and may only be entered between
+ * kernel_neon_begin() and kernel_neon_end().
+ *
+ * Context handling is lazy: taking an IRQ does not save the vector
+ * registers. Only when the interrupt handler itself calls
+ * kernel_neon_begin() are the interrupted owner's registers spilled,
+ * and they are reloaded on the way out of the exception.
+ *
+ * A begin/end section disables preemption: kernel threads are switched
+ * without saving V0-V31.
+ *
+ * Outside a begin/end section CPACR_EL1.FPEN traps every FP/SIMD
+ * instruction, so a stray vector instruction is reported by the
+ * synchronous exception handler instead of silently corrupting state.
+ */
+
+/* Thread context plus one IRQ level (IRQs do not nest on Aether) */
+#define FPSIMD_MAX_DEPTH   2
+
+struct fpsimd_state {
+    __uint128_t vregs[32];
+    uint32_t    fpsr;
+    uint32_t    fpcr;
+} __attribute__((aligned(16)));
+
+void fpsimd_init(void);
+
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+/* Exception path hooks, called from vectors.S around the IRQ handler */
+void fpsimd_exception_enter(void);
+void fpsimd_exception_exit(void);
+
+/* Raw register file transfer (arch/aarch64/fpsimd.S) */
+void fpsimd_save_state(struct fpsimd_state *st);
+void fpsimd_load_state(const struct fpsimd_state *st);
+
+#endif
@@ -11,6 +11,7 @@
 // --- Distributor Registers ---
 #define GICD_CTLR       (*(volatile uint32_t *)(GIC_DIST_BASE + 0x000))
 #define GICD_ISENABLER  ((volatile uint32_t *)(GIC_DIST_BASE + 0x100))
+#define GICD_ICENABLER  ((volatile uint32_t *)(GIC_DIST_BASE + 0x180))
 #define GICD_IGROUPR    ((volatile uint32_t *)(GIC_DIST_BASE + 0x080))
 #define GICD_ICFGR      ((volatile uint32_t *)(GIC_DIST_BASE + 0xC00))
 #define GICD_IPRIORITYR ((volatile uint8_t *)(GIC_DIST_BASE + 0x400))
@@ -27,6 +28,23 @@
 // Generic Timer Interrupt ID on AArch64
 #define TIMER_IRQ_ID    30
 
+// Software Generated Interrupts (0-15) used for inter-processor messages
+#define IPI_CALL_SGI    1
+#define RESCHED_SGI     2       // Self-IPI: switch threads on IRQ exit
+
+// INTID read from the IAR when nothing is pending
+#define GIC_SPURIOUS_ID 1023
+
 void gic_init();
+void gic_cpu_init(void);
+void gic_enable_irq(uint32_t id, uint8_t priority);
+
+/* Group, priority and trigger (edge != 0) of @id; SGIs/PPIs on this core */
+void gic_configure_irq(uint32_t id, uint8_t priority, int edge);
+void gic_unmask_irq(uint32_t id);
+void gic_mask_irq(uint32_t id);
+
+/* Raise SGI @sgi on every core whose logical id is set in @cpu_mask */
+void gic_send_sgi(uint32_t sgi, uint32_t cpu_mask);
 
 #endif
\ No newline at end of file
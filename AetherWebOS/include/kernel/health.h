@@ -13,6 +13,16 @@ typedef struct {
     unsigned long tcp_active;      // Track ESTABLISHED TCBs
     unsigned long retransmissions; // Count of retransmitted segments
     unsigned long checksum_errors; // Log corrupted packets from Pritam's logic
+
+    // TCP checksums left to / taken from the NIC vs done in software
+    unsigned long csum_tx_offload;
+    unsigned long csum_tx_sw;
+    unsigned long csum_rx_offload;
+    unsigned long csum_rx_sw;
+
+    // TSO super-segments handed to the NIC, and the wire frames they became
+    unsigned long tso_sends;
+    unsigned long tso_frames;
 } net_stats_t;
 
 // The global instance defined in health.c
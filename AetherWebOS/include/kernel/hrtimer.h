@@ -0,0 +1,51 @@
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+#include <stdint.h>
+
+/**
+ * One-shot high-resolution timers.
+ *
+ * Armed timers sit on a per-core list sorted by deadline and that core's
+ * generic timer comparator is programmed for the head only; there is no
+ * periodic tick. Callbacks run in IRQ context on the core that armed the
+ * timer, with interrupts masked, and may re-arm their own timer.
+ *
+ * A timer must be cancelled on the core it was started on.
+ */
+
+struct hrtimer;
+typedef void (*hrtimer_fn_t)(struct hrtimer *timer);
+
+struct hrtimer {
+    uint64_t        expires_ns;     /* Absolute, timer_get_ns() base */
+    hrtimer_fn_t    fn;
+    void           *data;
+    struct hrtimer *next;
+    uint8_t         queued;
+    uint8_t         cpu;            /* Core whose queue holds it */
+};
+
+typedef struct {
+    unsigned long fired;            /* Callbacks run */
+    unsigned long programmed;       /* Comparator writes */
+    uint64_t      max_late_ns;      /* Worst observed expiry latency */
+} hrtimer_stats_t;
+
+void hrtimer_init_subsystem(void);
+
+void hrtimer_init(struct hrtimer *timer, hrtimer_fn_t fn, void *data);
+void hrtimer_start(struct hrtimer *timer, uint64_t expires_ns);
+void hrtimer_start_rel(struct hrtimer *timer, uint64_t delta_ns);
+int  hrtimer_cancel(struct hrtimer *timer);
+
+/* Earliest armed deadline, or UINT64_MAX if none */
+uint64_t hrtimer_next_deadline(void);
+
+/* Timer PPI handler */
+void hrtimer_run_expired(void);
+
+/* Stats of the calling core's queue */
+const hrtimer_stats_t *hrtimer_get_stats(void);
+
+#endif
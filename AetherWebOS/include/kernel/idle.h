@@ -0,0 +1,55 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+/**
+ * Adaptive idle for the kernel main loop.
+ *
+ * After the last unit of work the loop keeps busy-polling for
+ * idle_poll_window_ns (low latency for bursty traffic). Once the window
+ * expires, idle_enter() arms an hrtimer for the next deadline and parks
+ * the core in WFI until a device or timer interrupt arrives.
+ *
+ * If other kernel threads are ready, the idle period is slept on an
+ * hrtimer instead so they get the CPU until the deadline.
+ *
+ * While virtio-net RX is polled (no MSI-X vector), sleeps are capped at
+ * IDLE_MAX_SLEEP_NS to bound RX latency. Interrupt-driven RX lifts the
+ * cap with idle_set_max_sleep(0).
+ */
+
+#ifndef IDLE_POLL_WINDOW_NS
+#define IDLE_POLL_WINDOW_NS   2000000ULL    /* 2 ms busy-poll after activity */
+#endif
+
+#ifndef IDLE_MAX_SLEEP_NS
+#define IDLE_MAX_SLEEP_NS     1000000ULL    /* 1 ms: net RX is still polled */
+#endif
+
+typedef struct {
+    uint64_t busy_ns;           /* Time spent outside WFI */
+    uint64_t idle_ns;           /* Time spent inside WFI */
+    unsigned long wfi_entries;
+    unsigned long polls;        /* Main loop passes that found no work */
+    unsigned long aborted;      /* Sleeps skipped: work arrived while masking */
+    unsigned long yields;       /* Idle periods given to other threads */
+} idle_stats_t;
+
+void idle_init(void);
+
+/* Main loop reports whether this pass did any work */
+void idle_note_activity(int did_work);
+
+/* Sleep if the poll window has expired; @deadline_ns caps the sleep */
+void idle_enter(uint64_t deadline_ns);
+
+void idle_set_poll_window(uint64_t ns);
+
+/* Longest WFI without a deadline; 0 = sleep until the next one */
+void idle_set_max_sleep(uint64_t ns);
+
+/* Cumulative; sample twice and diff to get residency over an interval */
+void idle_get_stats(idle_stats_t *out);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef IPI_H
+#define IPI_H
+
+#include <stdint.h>
+#include "kernel/smp.h"
+
+/**
+ * Aether Inter-Processor Messaging
+ *
+ * Every (destination, source) pair of cores owns a single-producer /
+ * single-consumer ring, so a core's inbox is multi-producer without any
+ * shared lock or CAS on the send path: a sender only writes its own ring
+ * and publishes with a release store of the tail.
+ *
+ * Wakeups are batched twice over:
+ *  - ipi_queue() only fills the ring; ipi_flush() raises the SGI for all
+ *    cores queued to since the last flush with a single ICC_SGI1R write.
+ *  - Each destination has a doorbell flag, rung by ipi_flush() as it
+ *    raises the SGI. A flush that finds it already rung skips the SGI:
+ *    one is in flight and the target has not started draining yet, so
+ *    it will see the new messages too. A queued but unflushed message
+ *    never holds back another core's wakeup.
+ *
+ * The handler runs fn(arg) on the target in IRQ context, so callbacks
+ * must be short and must not block.
+ */
+
+#define IPI_RING_SIZE      64          /* Messages per (dst, src) pair, power of 2 */
+#define IPI_LAT_BUCKETS    8           /* log2 histogram from 1 us to >= 64 us */
+
+typedef void (*ipi_fn_t)(void *arg);
+
+typedef struct {
+    /* Sender side (counted on the sending core) */
+    unsigned long sent;
+    unsigned long dropped;             /* Target ring full or core offline */
+    unsigned long kicks;               /* SGIs raised */
+    unsigned long coalesced;           /* Flushes that found a target's doorbell rung */
+
+    /* Receiver side (counted on the target core) */
+    unsigned long received;
+    unsigned long irqs;                /* IPI interrupts taken */
+    uint64_t      lat_total_ns;        /* Send to start of fn() */
+    uint64_t      lat_max_ns;
+    unsigned long lat_hist[IPI_LAT_BUCKETS];
+} ipi_stats_t;
+
+void ipi_init(void);
+
+/* Enqueue fn(arg) for @cpu without waking it; returns 0 or -1 if full */
+int ipi_queue(uint32_t cpu, ipi_fn_t fn, void *arg);
+
+/* Raise one SGI batch for every core queued to since the last flush */
+void ipi_flush(void);
+
+/* Run fn(arg) on @cpu (queue + flush); runs inline when @cpu is this core */
+int smp_call_on(uint32_t cpu, ipi_fn_t fn, void *arg);
+
+/* As smp_call_on(), then spins until fn has returned on @cpu */
+int smp_call_on_sync(uint32_t cpu, ipi_fn_t fn, void *arg);
+
+/* IPI_CALL_SGI top half (registered with request_irq() by ipi_init) */
+void ipi_handle_irq(void);
+
+/* Copy of the counters kept for @cpu */
+void ipi_get_stats(uint32_t cpu, ipi_stats_t *out);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+#include "kernel/smp.h"
+#include "kernel/sched.h"
+#include "kernel/its.h"
+
+/**
+ * IRQ descriptor table.
+ *
+ * Drivers claim an interrupt with request_irq(); the vector acknowledges
+ * it, runs the top half through irq_dispatch() and signals EOI. A top
+ * half runs with IRQs masked and should only quiesce the device (clear
+ * its status so a level line drops) and grab what cannot wait. Returning
+ * IRQ_WAKE_THREAD queues the bottom half as scheduler work on the same
+ * core, where it runs in the main loop with IRQs enabled.
+ *
+ * LPIs (ITS_LPI_BASE and up) come from MSI-X through the ITS and have
+ * descriptors after the wired range; see pci_msix_request().
+ *
+ * Per-CPU interrupts (SGIs, PPIs) are banked: request_irq() sets them up
+ * on the calling core and irq_cpu_init() repeats that on each secondary.
+ *
+ * Every descriptor counts hits per core, bottom-half runs and unhandled
+ * returns, and keeps a histogram of top-half execution time.
+ */
+
+#define NR_IRQS             256         /* SGI, PPI and the SPIs we use */
+#define NR_IRQ_DESCS        (NR_IRQS + ITS_NR_LPIS)
+#define IRQ_LAT_BUCKETS     8           /* log2 from < 256 ns to >= 16 us */
+#define IRQ_LAT_SHIFT       8           /* Bucket 0 upper bound: 2^8 ns */
+
+typedef enum {
+    IRQ_NONE = 0,                       /* Not ours / nothing pending */
+    IRQ_HANDLED,
+    IRQ_WAKE_THREAD                     /* Handled, run the bottom half */
+} irqreturn_t;
+
+typedef irqreturn_t (*irq_handler_t)(uint32_t irq, void *ctx);
+typedef void (*irq_bh_t)(uint32_t irq, void *ctx);
+
+#define IRQF_LEVEL          0x0
+#define IRQF_EDGE           0x1
+#define IRQF_PERCPU         0x2         /* SGI/PPI: enable on every core */
+
+struct irq_desc {
+    const char     *name;
+    irq_handler_t   handler;
+    irq_bh_t        bh;
+    void           *ctx;
+    uint8_t         priority;
+    uint8_t         flags;
+
+    struct sched_work bh_work[MAX_CPUS];
+
+    unsigned long   count[MAX_CPUS];
+    unsigned long   unhandled;          /* Top half returned IRQ_NONE */
+    unsigned long   bh_runs;
+    unsigned long   total_ns;           /* Top-half time */
+    uint64_t        max_ns;
+    unsigned long   lat_hist[IRQ_LAT_BUCKETS];
+};
+
+/* 0 on success, -1 if @irq is out of range or already claimed */
+int  request_irq(uint32_t irq, irq_handler_t handler, irq_bh_t bh, void *ctx,
+                 const char *name, uint8_t priority, uint8_t flags);
+
+/* Masks @irq and releases its descriptor (calling core only for per-CPU) */
+void free_irq(uint32_t irq);
+
+/* Apply every registered per-CPU interrupt to the calling core */
+void irq_cpu_init(void);
+
+/* Called from the IRQ vector with @irq acknowledged; EOI is the caller's */
+void irq_dispatch(uint32_t irq);
+
+/* Acknowledged INTID 1023: nothing was pending by the time we looked */
+void irq_note_spurious(void);
+
+/* Per-IRQ table (GET /irqs) */
+uint32_t irq_format(char *out, uint32_t out_size);
+
+#endif
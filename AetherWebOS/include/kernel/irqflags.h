@@ -0,0 +1,28 @@
+#ifndef IRQFLAGS_H
+#define IRQFLAGS_H
+
+#include <stdint.h>
+
+/**
+ * local_irq_save: Masks IRQs on the current core and returns the previous
+ * DAIF value so nested critical sections restore the correct state.
+ */
+static inline uint64_t local_irq_save(void) {
+    uint64_t flags;
+    asm volatile("mrs %0, daif\n\t"
+                 "msr daifset, #2" : "=r" (flags) : : "memory");
+    return flags;
+}
+
+static inline void local_irq_restore(uint64_t flags) {
+    asm volatile("msr daif, %0" : : "r" (flags) : "memory");
+}
+
+/* Returns non-zero if IRQs are currently masked (DAIF.I set) */
+static inline int irqs_disabled(void) {
+    uint64_t flags;
+    asm volatile("mrs %0, daif" : "=r" (flags));
+    return (flags & (1 << 7)) != 0;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef ITS_H
+#define ITS_H
+
+#include <stdint.h>
+#include "config.h"
+
+/**
+ * GICv3 Interrupt Translation Service.
+ *
+ * A PCIe device raises an MSI by writing an EventID to GITS_TRANSLATER;
+ * the ITS tags the write with the requester's DeviceID and looks both up
+ * in the device's Interrupt Translation Table to get an LPI and the
+ * collection (target core) to deliver it to. LPIs are message-based:
+ * there is no wire to mask and no active state, so enable and priority
+ * live in a property table in memory that the redistributors cache.
+ *
+ * Tables (device, collection, per-device ITT, LPI property and per-core
+ * pending) are static and sized for a handful of devices. Each online
+ * core gets collection ICID == its logical id in its_cpu_init().
+ *
+ * Commands go through a 4 KB ring and are waited for synchronously;
+ * mapping is a setup-time operation, nothing here runs in IRQ context.
+ */
+
+#ifdef BOARD_VIRT
+    #define GIC_ITS_BASE        0x08080000
+#endif
+
+#define ITS_LPI_BASE        8192
+#define ITS_LPI_ID_BITS     14          /* INTIDs up to 16383 */
+#define ITS_NR_LPIS         64          /* Handed out by its_map_event() */
+#define ITS_MAX_DEVICES     8
+#define ITS_EVENT_BITS      5           /* 32 events (MSI-X vectors) per device */
+
+/* Called from gic_init(); returns 0 when an ITS was found and enabled */
+int  its_init(void);
+
+/* Enables LPIs on the calling core's redistributor and maps its collection */
+void its_cpu_init(uint64_t rd_base);
+
+int  its_present(void);
+
+/* Physical address a device writes its EventID to */
+uint64_t its_doorbell(void);
+
+/*
+ * Bind (@devid, @event) to a fresh LPI delivered to @cpu. The LPI starts
+ * disabled; request_irq() sets its priority and enables it. Returns the
+ * LPI INTID or -1.
+ */
+int  its_map_event(uint32_t devid, uint32_t event, uint32_t cpu);
+
+/* Retarget a mapped event to another online core (MOVI) */
+int  its_route_event(uint32_t lpi, uint32_t cpu);
+
+/* Property table updates + INV, used by gic_configure/unmask/mask_irq */
+void its_lpi_set_priority(uint32_t lpi, uint8_t priority);
+void its_lpi_enable(uint32_t lpi, int enable);
+
+#endif
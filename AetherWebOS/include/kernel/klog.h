@@ -0,0 +1,106 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include <stdint.h>
+
+/**
+ * Aether Kernel Log
+ *
+ * Call sites store a compact binary record (timestamp, level, subsystem,
+ * format id, up to KLOG_MAX_ARGS integer arguments) into a lock-free
+ * ring. No text is produced on the hot path: formatting happens later in
+ * klog_drain() (console, DEBUG mode only) or klog_format_recent() (HTTP).
+ *
+ * The format id is the address of the format literal, so format strings
+ * and any %s arguments MUST have static storage duration.
+ *
+ * Supported conversions: %u %d %x %c %s %% plus
+ *   %I  IPv4 address (host order uint32_t)
+ *   %M  MAC address packed with klog_mac()
+ * 'l' length modifiers are accepted and ignored (all arguments are 64-bit).
+ */
+
+/* --- Levels --- */
+#define KLOG_ERR    0
+#define KLOG_WARN   1
+#define KLOG_INFO   2
+#define KLOG_DEBUG  3
+#define KLOG_TRACE  4
+
+/* Anything above this level compiles out entirely (-DKLOG_LEVEL=n) */
+#ifndef KLOG_LEVEL
+#define KLOG_LEVEL  KLOG_DEBUG
+#endif
+
+/* --- Subsystems --- */
+typedef enum {
+    KLOG_SUB_KERNEL = 0,
+    KLOG_SUB_MM,
+    KLOG_SUB_UART,
+    KLOG_SUB_PCIE,
+    KLOG_SUB_VIRTIO,
+    KLOG_SUB_NET,
+    KLOG_SUB_ARP,
+    KLOG_SUB_IP,
+    KLOG_SUB_TCP,
+    KLOG_SUB_HTTP,
+    KLOG_SUB_USB,
+    KLOG_SUB_COUNT
+} klog_subsys_t;
+
+#define KLOG_MAX_ARGS   5
+#define KLOG_RING_SIZE  512     /* Records, power of two */
+
+/* One cache line per record */
+struct klog_record {
+    volatile uint32_t seq;      /* ticket + 1 once committed, 0 while writing */
+    uint8_t  level;
+    uint8_t  subsys;
+    uint8_t  nargs;
+    uint8_t  reserved;
+    uint64_t timestamp;         /* ns since boot (timer_get_ns) */
+    const char *fmt;            /* Format id */
+    uint64_t args[KLOG_MAX_ARGS];
+} __attribute__((aligned(64)));
+
+typedef struct {
+    unsigned long written;      /* Records committed */
+    unsigned long overwritten;  /* Records lost before the console drained them */
+    unsigned long drained;      /* Records formatted by klog_drain() */
+} klog_stats_t;
+
+void klog_write(uint8_t level, uint8_t subsys, const char *fmt,
+                const uint64_t *args, uint32_t nargs);
+
+/* Formats up to @budget pending records; returns how many were consumed */
+uint32_t klog_drain(uint32_t budget);
+
+/* Formats the newest records that fit into @out (oldest first), non-destructive */
+uint32_t klog_format_recent(char *out, uint32_t out_size);
+
+const klog_stats_t *klog_get_stats(void);
+
+static inline uint64_t klog_mac(const uint8_t *mac) {
+    return ((uint64_t)mac[0] << 40) | ((uint64_t)mac[1] << 32) |
+           ((uint64_t)mac[2] << 24) | ((uint64_t)mac[3] << 16) |
+           ((uint64_t)mac[4] << 8)  |  (uint64_t)mac[5];
+}
+
+#define klog(level, subsys, fmt, ...)                                        \
+    do {                                                                     \
+        if ((level) <= KLOG_LEVEL) {                                         \
+            const uint64_t _klog_args[] = { 0, ##__VA_ARGS__ };              \
+            _Static_assert(sizeof(_klog_args) / sizeof(uint64_t) - 1         \
+                           <= KLOG_MAX_ARGS, "too many klog arguments");     \
+            klog_write((level), (subsys), (fmt), _klog_args + 1,             \
+                       sizeof(_klog_args) / sizeof(uint64_t) - 1);           \
+        }                                                                    \
+    } while (0)
+
+#define klog_err(sub, fmt, ...)    klog(KLOG_ERR,   sub, fmt, ##__VA_ARGS__)
+#define klog_warn(sub, fmt, ...)   klog(KLOG_WARN,  sub, fmt, ##__VA_ARGS__)
+#define klog_info(sub, fmt, ...)   klog(KLOG_INFO,  sub, fmt, ##__VA_ARGS__)
+#define klog_debug(sub, fmt, ...)  klog(KLOG_DEBUG, sub, fmt, ##__VA_ARGS__)
+#define klog_trace(sub, fmt, ...)  klog(KLOG_TRACE, sub, fmt, ##__VA_ARGS__)
+
+#endif
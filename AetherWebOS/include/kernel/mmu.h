@@ -38,6 +38,7 @@
 
 // --- Function Prototypes ---
 extern void mmu_init();
+void mmu_enable_this_cpu(void);
 
 /**
  * Maps a virtual memory region to a physical memory region.
@@ -46,4 +47,7 @@ extern void mmu_init();
 extern void mmu_map_region(uintptr_t va, uintptr_t pa, size_t size, uint64_t flags);
 void clean_cache_range(uintptr_t start, uintptr_t end);
 
+/* Change the memory type of identity-mapped RAM, in 2MB blocks */
+void mmu_set_ram_attrs(uintptr_t va, size_t size, uint64_t attr_index);
+
 #endif
\ No newline at end of file
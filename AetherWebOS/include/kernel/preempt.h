@@ -0,0 +1,45 @@
+#ifndef PREEMPT_H
+#define PREEMPT_H
+
+#include <stdint.h>
+#include "kernel/smp.h"
+
+/**
+ * Preemption control.
+ *
+ * Kernel threads are switched on the way out of an IRQ. Code that must
+ * not be switched away from on its own core (spinlock holders, NEON
+ * sections) raises this core's preempt_count; a reschedule requested
+ * meanwhile is carried out when the count drops back to zero.
+ */
+
+/* Requests a switch now through a self-SGI (no-op with IRQs masked) */
+void preempt_schedule(void);
+
+static inline void preempt_disable(void)
+{
+    this_cpu()->preempt_count++;
+    asm volatile("" ::: "memory");
+}
+
+static inline void preempt_enable_no_resched(void)
+{
+    asm volatile("" ::: "memory");
+    this_cpu()->preempt_count--;
+}
+
+static inline void preempt_check_resched(void)
+{
+    struct cpu_data *cd = this_cpu();
+
+    if (cd->need_resched && cd->preempt_count == 0)
+        preempt_schedule();
+}
+
+static inline void preempt_enable(void)
+{
+    preempt_enable_no_resched();
+    preempt_check_resched();
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+/**
+ * Cooperative run-to-completion scheduler.
+ *
+ * Subsystems register pollers instead of being called from a hard-coded
+ * main loop. Each pass of sched_run_once() walks the calling core's
+ * pollers from the highest priority down; a poller does at most @budget
+ * units of work and returns how many it did.
+ *
+ * A poller that uses its whole budget is saturated: lower priorities
+ * are deferred for that pass so network work wins over the dashboard
+ * under load. A deferred poller still runs once it has waited
+ * SCHED_STARVE_NS past its due time.
+ *
+ * Deferred work items are one-shot callbacks queued from any context,
+ * IRQ handlers included, and run after the pollers of their priority.
+ *
+ * Cycles are accounted per poller; cycles of calls that did work count
+ * as busy time, which is what the dashboard reports as CPU load.
+ */
+
+enum {
+    SCHED_PRIO_NET = 0,         /* Packet RX/TX */
+    SCHED_PRIO_INPUT,           /* Console keys */
+    SCHED_PRIO_UI,              /* Dashboard redraw */
+    SCHED_PRIO_BG,              /* Housekeeping, log drain */
+    SCHED_NR_PRIO
+};
+
+#define SCHED_STARVE_NS       (200 * 1000000ULL)   /* Max deferral past due */
+#define SCHED_WORK_BUDGET     16                   /* Work items per prio per pass */
+
+struct sched_poller;
+
+/* Returns the units of work done, at most @budget */
+typedef int (*sched_poll_fn)(void *arg, int budget);
+
+struct sched_poller {
+    const char          *name;
+    sched_poll_fn        fn;
+    void                *arg;
+    uint8_t              prio;
+    uint16_t             budget;
+    uint64_t             interval_ns;   /* 0 = every pass, else periodic */
+
+    /* Owned by the scheduler */
+    uint64_t             due_ns;
+    unsigned long        runs;
+    unsigned long        work;
+    unsigned long        deferred;      /* Passes skipped for a busier prio */
+    uint64_t             cycles;
+    uint64_t             max_cycles;
+    struct sched_poller *next;
+};
+
+struct sched_work;
+typedef void (*sched_work_fn)(struct sched_work *work);
+
+struct sched_work {
+    sched_work_fn        fn;
+    void                *data;
+    uint8_t              prio;
+    volatile uint8_t     pending;
+    struct sched_work   *next;
+};
+
+typedef struct {
+    unsigned long passes;
+    unsigned long work_items;
+    uint64_t      busy_cycles;          /* Pollers/work that made progress */
+    uint64_t      total_cycles;         /* Counter cycles since sched_init */
+} sched_stats_t;
+
+void sched_init(void);
+
+/* Adds @p to the calling core's run list */
+void sched_register_poller(struct sched_poller *p, const char *name,
+                           sched_poll_fn fn, void *arg,
+                           uint8_t prio, uint16_t budget, uint64_t interval_ns);
+
+void sched_init_work(struct sched_work *w, sched_work_fn fn, void *data, uint8_t prio);
+
+/* Queue on the calling core; returns 0 if it was already pending */
+int sched_queue_work(struct sched_work *w);
+
+/* Queue on another core (via smp_call_on) */
+int sched_queue_work_on(uint32_t cpu, struct sched_work *w);
+
+/* One pass over pollers and work; returns non-zero if anything progressed */
+int sched_run_once(void);
+
+/* Earliest periodic due time on this core; now if work is queued */
+uint64_t sched_next_deadline(void);
+
+int sched_has_pending_work(void);
+
+void sched_get_stats(sched_stats_t *out);
+
+/* Per-poller table of the calling core (GET /tasks) */
+uint32_t sched_format(char *out, uint32_t out_size);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+/**
+ * Symmetric multiprocessing support.
+ *
+ * Core 0 boots through _start. smp_init() starts the remaining cores
+ * with PSCI CPU_ON at secondary_entry (boot.S), each on its own stack.
+ * They bring up their own MMU, GIC redistributor/CPU interface and
+ * timer, then wait in smp_secondary_loop() for work.
+ *
+ * TPIDR_EL1 holds a pointer to the running core's struct cpu_data.
+ */
+
+#define MAX_CPUS            4
+#define SMP_STACK_SIZE      0x4000      /* 16 KB, same as the boot stack */
+
+struct cpu_data {
+    uint32_t          cpu_id;           /* Logical index, 0 = boot core */
+    uint64_t          mpidr;
+    volatile uint32_t online;
+    unsigned long     irqs;             /* Interrupts taken on this core */
+    volatile uint32_t preempt_count;    /* > 0: no thread switch on IRQ exit */
+    volatile uint32_t need_resched;     /* Switch at the next opportunity */
+} __attribute__((aligned(64)));
+
+extern struct cpu_data cpu_data[MAX_CPUS];
+
+static inline struct cpu_data *this_cpu(void)
+{
+    struct cpu_data *cd;
+    asm volatile("mrs %0, tpidr_el1" : "=r" (cd));
+    return cd;
+}
+
+static inline uint32_t smp_processor_id(void)
+{
+    return this_cpu()->cpu_id;
+}
+
+/* Boot core: power on secondaries; returns the number of online CPUs */
+uint32_t smp_init(void);
+
+uint32_t smp_num_online(void);
+
+/* C entry for secondaries, called from boot.S with the logical CPU id */
+void secondary_start(uint64_t cpu);
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+#include "kernel/atomic.h"
+#include "kernel/irqflags.h"
+#include "kernel/preempt.h"
+#ifdef CONFIG_LOCK_STAT
+#include "kernel/timer.h"
+#endif
+
+/**
+ * Aether Locks
+ *
+ *  spinlock_t  Ticket lock: FIFO fair, waiters sleep in WFE on the owner
+ *              field and are woken by the unlocking store.
+ *  mcs_lock_t  Queue lock: each waiter spins on its own node, so heavy
+ *              contention does not bounce one cache line between cores.
+ *  seqlock_t   Read-mostly data: lock-free readers retry if a writer
+ *              ran while they were reading.
+ *
+ * Locks taken from both thread and IRQ context must use the _irqsave
+ * variants. Holding a spinlock disables preemption on the holder's core.
+ *
+ * Build with LOCK_STAT=1 (-DCONFIG_LOCK_STAT) to count acquisitions,
+ * contended acquisitions, wait and hold time per lock. Registered locks
+ * are listed by lock_stat_format() (GET /locks).
+ */
+
+#ifdef CONFIG_LOCK_STAT
+struct lock_stat {
+    const char      *name;
+    unsigned long    acquired;
+    unsigned long    contended;
+    uint64_t         wait_cycles;       /* Total time spent waiting */
+    uint64_t         hold_cycles;       /* Total time held */
+    uint64_t         hold_max_cycles;
+    uint64_t         acquired_at;       /* Counter value of the last acquire */
+    struct lock_stat *next;
+};
+#endif
+
+typedef struct {
+    union {
+        volatile uint32_t val;
+        struct {
+            volatile uint16_t owner;    /* Ticket being served */
+            volatile uint16_t next;     /* Next ticket to hand out */
+        };
+    };
+#ifdef CONFIG_LOCK_STAT
+    struct lock_stat stat;
+#endif
+} spinlock_t;
+
+#ifdef CONFIG_LOCK_STAT
+void lock_stat_register(struct lock_stat *st, const char *name);
+void lock_stat_acquired(struct lock_stat *st, uint64_t wait_start, int contended);
+void lock_stat_released(struct lock_stat *st);
+#endif
+
+/* Formats the registered lock table; empty note without CONFIG_LOCK_STAT */
+uint32_t lock_stat_format(char *out, uint32_t out_size);
+
+/* =====================================================
+   Ticket Spinlock
+   ===================================================== */
+
+static inline void spin_lock_init(spinlock_t *lock, const char *name)
+{
+    lock->val = 0;
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_register(&lock->stat, name);
+#else
+    (void)name;
+#endif
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+    preempt_disable();
+
+#ifdef CONFIG_LOCK_STAT
+    uint64_t wait_start = timer_read_counter();
+#endif
+    uint32_t old = atomic32_fetch_add(&lock->val, 1u << 16);
+    uint16_t ticket = old >> 16;
+
+    if ((uint16_t)old != ticket) {
+        uint32_t tmp;
+
+        /* LDAXRH arms the exclusive monitor: the owner's store wakes WFE */
+        asm volatile("   sevl\n"
+                     "1: wfe\n"
+                     "   ldaxrh %w[tmp], %[owner]\n"
+                     "   eor    %w[tmp], %w[tmp], %w[ticket]\n"
+                     "   cbnz   %w[tmp], 1b\n"
+                     : [tmp] "=&r" (tmp)
+                     : [owner] "Q" (lock->owner), [ticket] "r" ((uint32_t)ticket)
+                     : "memory");
+    }
+
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_acquired(&lock->stat, wait_start, (uint16_t)old != ticket);
+#endif
+}
+
+static inline int spin_trylock(spinlock_t *lock)
+{
+    uint32_t cur = lock->val;
+
+    if ((cur >> 16) != (cur & 0xFFFF))
+        return 0;
+
+    preempt_disable();
+
+    if (atomic32_cmpxchg(&lock->val, cur, cur + (1u << 16)) != cur) {
+        preempt_enable();
+        return 0;
+    }
+
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_acquired(&lock->stat, timer_read_counter(), 0);
+#endif
+    return 1;
+}
+
+static inline void spin_unlock_no_resched(spinlock_t *lock)
+{
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_released(&lock->stat);
+#endif
+    __atomic_store_n(&lock->owner, (uint16_t)(lock->owner + 1), __ATOMIC_RELEASE);
+    preempt_enable_no_resched();
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+    spin_unlock_no_resched(lock);
+    preempt_check_resched();
+}
+
+static inline uint64_t spin_lock_irqsave(spinlock_t *lock)
+{
+    uint64_t flags = local_irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags)
+{
+    spin_unlock_no_resched(lock);
+    local_irq_restore(flags);
+    preempt_check_resched();
+}
+
+/* =====================================================
+   MCS Queue Lock
+   ===================================================== */
+
+struct mcs_node {
+    struct mcs_node  *volatile next;
+    volatile uint32_t locked;
+} __attribute__((aligned(64)));
+
+typedef struct {
+    struct mcs_node *volatile tail;
+#ifdef CONFIG_LOCK_STAT
+    struct lock_stat stat;
+#endif
+} mcs_lock_t;
+
+#define MCS_LOCK_INIT   { 0 }
+
+static inline void mcs_lock_init(mcs_lock_t *lock, const char *name)
+{
+    lock->tail = 0;
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_register(&lock->stat, name);
+#else
+    (void)name;
+#endif
+}
+
+/* @node must stay valid until mcs_unlock(); a stack variable is fine */
+static inline void mcs_lock(mcs_lock_t *lock, struct mcs_node *node)
+{
+    preempt_disable();
+
+#ifdef CONFIG_LOCK_STAT
+    uint64_t wait_start = timer_read_counter();
+#endif
+    node->next = 0;
+    node->locked = 0;
+
+    struct mcs_node *prev = (struct mcs_node *)(uintptr_t)
+        atomic64_xchg((volatile uint64_t *)&lock->tail, (uint64_t)(uintptr_t)node);
+
+    if (prev) {
+        smp_store_release(&prev->next, node);
+
+        uint32_t tmp;
+        asm volatile("   sevl\n"
+                     "1: wfe\n"
+                     "   ldaxr  %w[tmp], %[locked]\n"
+                     "   cbz    %w[tmp], 1b\n"
+                     : [tmp] "=&r" (tmp)
+                     : [locked] "Q" (node->locked)
+                     : "memory");
+    }
+
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_acquired(&lock->stat, wait_start, prev != 0);
+#endif
+}
+
+static inline void mcs_unlock_no_resched(mcs_lock_t *lock, struct mcs_node *node)
+{
+#ifdef CONFIG_LOCK_STAT
+    lock_stat_released(&lock->stat);
+#endif
+    struct mcs_node *next = smp_load_acquire(&node->next);
+
+    if (!next) {
+        /* No known successor: try to mark the lock free */
+        if (atomic64_cmpxchg((volatile uint64_t *)&lock->tail,
+                             (uint64_t)(uintptr_t)node, 0) == (uint64_t)(uintptr_t)node) {
+            preempt_enable_no_resched();
+            return;
+        }
+
+        /* A successor swapped in but has not linked itself yet */
+        while (!(next = smp_load_acquire(&node->next)))
+            asm volatile("yield");
+    }
+
+    smp_store_release(&next->locked, 1);
+    preempt_enable_no_resched();
+}
+
+static inline void mcs_unlock(mcs_lock_t *lock, struct mcs_node *node)
+{
+    mcs_unlock_no_resched(lock, node);
+    preempt_check_resched();
+}
+
+static inline uint64_t mcs_lock_irqsave(mcs_lock_t *lock, struct mcs_node *node)
+{
+    uint64_t flags = local_irq_save();
+    mcs_lock(lock, node);
+    return flags;
+}
+
+static inline void mcs_unlock_irqrestore(mcs_lock_t *lock, struct mcs_node *node,
+                                         uint64_t flags)
+{
+    mcs_unlock_no_resched(lock, node);
+    local_irq_restore(flags);
+    preempt_check_resched();
+}
+
+/* =====================================================
+   Seqlock
+   ===================================================== */
+
+typedef struct {
+    volatile uint32_t seq;
+    spinlock_t        lock;     /* Serialises writers */
+} seqlock_t;
+
+static inline void seqlock_init(seqlock_t *sl, const char *name)
+{
+    sl->seq = 0;
+    spin_lock_init(&sl->lock, name);
+}
+
+static inline void write_seqlock(seqlock_t *sl)
+{
+    spin_lock(&sl->lock);
+    sl->seq++;
+    smp_wmb();
+}
+
+static inline void write_sequnlock(seqlock_t *sl)
+{
+    smp_wmb();
+    sl->seq++;
+    spin_unlock(&sl->lock);
+}
+
+static inline uint32_t read_seqbegin(const seqlock_t *sl)
+{
+    uint32_t seq;
+
+    while ((seq = smp_load_acquire(&sl->seq)) & 1)
+        asm volatile("yield");
+
+    return seq;
+}
+
+static inline int read_seqretry(const seqlock_t *sl, uint32_t start)
+{
+    smp_rmb();
+    return sl->seq != start;
+}
+
+#endif
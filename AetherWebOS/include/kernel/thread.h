@@ -0,0 +1,130 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdint.h>
+#include "kernel/hrtimer.h"
+#include "kernel/spinlock.h"
+
+/**
+ * Preemptive kernel threads.
+ *
+ * Every thread owns a stack from a static pool. A switch happens only on
+ * the way out of an IRQ (vectors.S): the interrupted thread's registers,
+ * ELR and SPSR are already in the exception frame on its stack, so the
+ * switch saves that stack pointer and returns the next thread's, and
+ * kernel_exit restores it.
+ *
+ * Highest priority (lowest number) wins; equal priorities round-robin on
+ * THREAD_SLICE_NS slices armed only while someone is waiting for the CPU.
+ * A voluntary switch (yield, sleep, wait) raises RESCHED_SGI on the
+ * calling core so it goes through the same path.
+ *
+ * Threads stay on the core that created them. Waking a thread that lives
+ * on another core is forwarded there with smp_call_on().
+ *
+ * The boot context becomes the "kmain" thread; an idle thread runs WFI
+ * when nothing else can.
+ */
+
+#define THREAD_MAX          8
+#define THREAD_STACK_SIZE   0x4000          /* 16 KB */
+#define THREAD_SLICE_NS     (5 * 1000000ULL)
+
+enum {
+    THREAD_PRIO_HIGH = 0,                   /* Packet processing (kmain) */
+    THREAD_PRIO_NORMAL,                     /* Application handlers */
+    THREAD_PRIO_LOW,
+    THREAD_PRIO_IDLE,                       /* Idle thread only */
+    THREAD_NR_PRIO
+};
+
+typedef enum {
+    THREAD_UNUSED = 0,
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_BLOCKED,
+    THREAD_DEAD
+} thread_state_t;
+
+/* Exception frame built by kernel_entry: x0-x30, ELR, SPSR, pad */
+#define THREAD_FRAME_SIZE   272
+#define FRAME_ELR           31
+#define FRAME_SPSR          32
+
+typedef void (*thread_fn_t)(void *arg);
+
+struct thread {
+    uint64_t        sp;                     /* Saved frame (not running) */
+    uint32_t        tid;
+    const char     *name;
+    uint8_t         prio;
+    uint8_t         cpu;
+    volatile uint8_t state;
+
+    thread_fn_t     entry;
+    void           *arg;
+
+    struct hrtimer  sleep_timer;
+    struct thread  *run_next;               /* Ready queue link */
+    struct thread  *wait_next;              /* Wait queue link */
+
+    uint64_t        runtime_ns;
+    uint64_t        switched_in_ns;
+    unsigned long   switches;
+};
+
+struct wait_queue {
+    spinlock_t      lock;
+    struct thread  *head;
+};
+
+void thread_init(void);
+
+struct thread *thread_create(const char *name, thread_fn_t fn, void *arg, uint8_t prio);
+
+struct thread *thread_current(void);
+
+/* Give the CPU to another ready thread of the same or higher priority */
+void thread_yield(void);
+
+void thread_sleep_until(uint64_t deadline_ns);
+
+void thread_exit(void);
+
+/* Make @t runnable; safe from IRQ context and from other cores */
+void thread_wake(struct thread *t);
+
+/* Non-idle threads other than the caller that are waiting for the CPU */
+int thread_others_ready(void);
+
+/* Called from irq_el1h with the frame pointer; returns the one to restore */
+uint64_t thread_irq_exit(uint64_t sp);
+
+/* =====================================================
+   Wait Queues
+   ===================================================== */
+
+void wait_queue_init(struct wait_queue *wq, const char *name);
+
+/* Block until woken; call with IRQs masked, returns with them masked */
+void thread_wait_locked(struct wait_queue *wq);
+
+void wake_up_one(struct wait_queue *wq);
+
+/*
+ * Sleep until @cond holds. @cond is re-checked with IRQs masked, which
+ * orders it against wakers on this core. A waker on another core should
+ * set @cond, then run wake_up_one() on the waiter's core via smp_call_on().
+ */
+#define wait_event(wq, cond)                        \
+    do {                                            \
+        uint64_t __flags = local_irq_save();        \
+        while (!(cond))                             \
+            thread_wait_locked(wq);                 \
+        local_irq_restore(__flags);                 \
+    } while (0)
+
+/* Per-thread table of the calling core (GET /threads) */
+uint32_t thread_format(char *out, uint32_t out_size);
+
+#endif
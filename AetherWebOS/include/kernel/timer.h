@@ -3,8 +3,25 @@
 
 #include <stdint.h>
 
+#define NSEC_PER_USEC   1000ULL
+#define NSEC_PER_MSEC   1000000ULL
+#define NSEC_PER_SEC    1000000000ULL
+
 void timer_init(void);
+void timer_init_this_cpu(void);
 void handle_timer_irq(void);
+
+/* Monotonic clock, read straight from CNTPCT_EL0 */
+uint64_t timer_read_counter(void);
+uint64_t timer_get_ns(void);            /* ns since timer_init() */
+uint64_t timer_cycles_to_ns(uint64_t cycles);
+uint64_t timer_ns_to_cycles(uint64_t ns);
+uint64_t timer_get_freq(void);
+
+/* One-shot comparator (CNTP_CVAL_EL0), absolute ns since boot */
+void timer_program_deadline(uint64_t deadline_ns);
+void timer_disarm(void);
+
 uint64_t get_system_uptime_ms(void);
 
-#endif
\ No newline at end of file
+#endif
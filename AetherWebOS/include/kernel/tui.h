@@ -0,0 +1,54 @@
+#ifndef TUI_H
+#define TUI_H
+
+#include <stdint.h>
+
+/**
+ * Aether Incremental TUI Renderer
+ *
+ * Dashboards draw into a back grid with the tui_* helpers instead of
+ * writing to the UART. tui_flush() compares the back grid with a shadow
+ * copy of what the terminal currently shows and emits only the changed
+ * spans, each prefixed by a cursor-position escape (ESC[row;colH).
+ *
+ * A refresh never sends more than its byte budget; spans that do not fit
+ * stay dirty and go out on the next refresh, starting where the previous
+ * one stopped so the bottom of the screen is not starved.
+ */
+
+#define TUI_COLS   80
+#define TUI_ROWS   40
+
+/* ~45 ms of line time at 115200 baud, well inside a 100 ms refresh */
+#define TUI_REFRESH_BUDGET   512
+
+typedef struct {
+    unsigned long frames;       /* tui_flush() calls */
+    unsigned long bytes;        /* Bytes handed to the UART */
+    unsigned long cells;        /* Cells redrawn */
+    unsigned long deferred;     /* Flushes cut short by the budget */
+} tui_stats_t;
+
+/* Start a new frame: clears the back grid and homes the draw cursor */
+void tui_begin(void);
+
+/* Draw primitives (clip at the grid edge, '\n' starts the next row) */
+void tui_putc(char c);
+void tui_puts(const char *s);
+void tui_put_int(uint64_t n);
+void tui_put_hex_byte(uint8_t byte);
+void tui_put_ip(uint32_t ip);
+void tui_put_ipv6(const uint8_t addr[16]);
+
+/* Rows from the draw cursor to the bottom of the grid, current one included */
+uint32_t tui_rows_left(void);
+
+/* Emit changed cells, at most @budget bytes; returns bytes sent */
+uint32_t tui_flush(uint32_t budget);
+
+/* Terminal contents are unknown (mode switch, raw uart_puts): repaint all */
+void tui_invalidate(void);
+
+const tui_stats_t *tui_get_stats(void);
+
+#endif
@@ -18,6 +18,15 @@ void *memcpy(void *dest, const void *src, size_t n) {
     return dest;
 }
 
+int memcmp(const void *a, const void *b, size_t n) {
+    const unsigned char *x = a;
+    const unsigned char *y = b;
+    for (; n; n--, x++, y++) {
+        if (*x != *y) return *x - *y;
+    }
+    return 0;
+}
+
 void str_clear(char* str) {
     if (str) str[0] = '\0';
 }
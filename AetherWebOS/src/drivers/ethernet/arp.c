@@ -3,6 +3,8 @@
 #include "ethernet/ethernet.h"
 #include "common/utils.h"
 #include "uart.h"
+#include "kernel/klog.h"
+#include "kernel/spinlock.h"
 
 #define ARP_CACHE_SIZE 4
 
@@ -12,6 +14,7 @@ struct arp_entry {
 };
 
 static struct arp_entry arp_cache[ARP_CACHE_SIZE];
+static spinlock_t arp_cache_lock;     /* Requests land on any RX core */
 
 /* External values */
 extern uint32_t aether_ip;   // HOST order
@@ -22,13 +25,17 @@ extern uint8_t  aether_mac[6];
    ================================ */
 static void arp_cache_insert(uint32_t ip_host_order, uint8_t *mac)
 {
+    uint64_t flags = spin_lock_irqsave(&arp_cache_lock);
+
     for (int i = 0; i < ARP_CACHE_SIZE; i++) {
         if (arp_cache[i].ip == 0 || arp_cache[i].ip == ip_host_order) {
             arp_cache[i].ip = ip_host_order;
             memcpy(arp_cache[i].mac, mac, 6);
-            return;
+            break;
         }
     }
+
+    spin_unlock_irqrestore(&arp_cache_lock, flags);
 }
 
 void arp_handle(uint8_t *data, uint32_t len)
@@ -38,18 +45,10 @@ void arp_handle(uint8_t *data, uint32_t len)
 
     struct arp_packet *arp = (struct arp_packet *)data;
 
-    uart_puts("[ARP] Packet\r\n");
-
-    uint32_t sip = __builtin_bswap32(arp->sender_ip);
-    uint32_t tip = __builtin_bswap32(arp->target_ip);
-
-    uart_puts("Sender IP: ");
-    uart_put_hex(sip);
-    uart_puts("\r\n");
-
-    uart_puts("Target IP: ");
-    uart_put_hex(tip);
-    uart_puts("\r\n");
+    klog_debug(KLOG_SUB_ARP, "op %u %I -> %I",
+               __builtin_bswap16(arp->opcode),
+               __builtin_bswap32(arp->sender_ip),
+               __builtin_bswap32(arp->target_ip));
 
     /* Validate hardware type (Ethernet) */
     if (__builtin_bswap16(arp->htype) != ARP_HTYPE_ETH)
@@ -95,7 +94,8 @@ void arp_handle(uint8_t *data, uint32_t len)
     memcpy(reply.target_mac, arp->sender_mac, 6);
     reply.target_ip = arp->sender_ip;   // already network order
 
-    uart_puts("[ARP] Reply triggered\r\n");
+    klog_debug(KLOG_SUB_ARP, "reply to %I is-at %M",
+               __builtin_bswap32(arp->sender_ip), klog_mac(aether_mac));
 
     ethernet_send(
         arp->sender_mac,
@@ -8,12 +8,74 @@
 #include "drivers/ethernet/arp.h"  
 #include "drivers/ethernet/ipv6.h" 
 #include "drivers/ethernet/ipv4.h"
-#include "kernel/mmu.h" // For cache management
+#include "kernel/dma.h" // Device-visible TX buffers
+#include "kernel/smp.h"
+#include "kernel/preempt.h"
+#include "kernel/health.h"
+#include "kernel/atomic.h"
+#include "drivers/ethernet/netbuf.h"
 
 extern uint8_t aether_mac[6];
 extern struct virtio_pci_device *global_vnet_dev;
 
+/* Per-core nesting of ethernet_tx_batch_begin/end */
+static uint32_t tx_batch_depth[MAX_CPUS];
+
+void ethernet_tx_batch_begin(void) {
+    preempt_disable();
+    tx_batch_depth[smp_processor_id()]++;
+}
+
+void ethernet_tx_batch_end(void) {
+    uint32_t cpu = smp_processor_id();
+
+    if (--tx_batch_depth[cpu] == 0 && global_vnet_dev)
+        virtio_net_tx_flush();
+    preempt_enable();
+}
+
 void ethernet_send(uint8_t *dest_mac, uint16_t ethertype, uint8_t *payload, uint32_t len) {
+    ethernet_send_meta(dest_mac, ethertype, payload, len, NULL);
+}
+
+int ethernet_tx_csum_offload(void) {
+    return global_vnet_dev && virtio_net_tx_csum();
+}
+
+int ethernet_tx_tso(void) {
+    return global_vnet_dev && virtio_net_tx_tso();
+}
+
+/* virtio-net header (offload requests) and Ethernet header at @buffer */
+static void ethernet_build_header(uint8_t *buffer, uint8_t *dest_mac, uint16_t ethertype,
+                                  const struct net_meta *meta) {
+    uint32_t v_hdr_size = sizeof(struct virtio_net_hdr);
+
+    // Zero out VirtIO header, then pass on the checksum request
+    memset(buffer, 0, v_hdr_size);
+
+    if (meta && (meta->flags & NET_META_CSUM_PARTIAL)) {
+        struct virtio_net_hdr *vh = (struct virtio_net_hdr *)buffer;
+        vh->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        vh->csum_start = sizeof(struct eth_header) + meta->csum_start;
+        vh->csum_offset = meta->csum_offset;
+
+        if (meta->flags & NET_META_GSO_TCPV4) {
+            vh->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+            vh->gso_size = meta->gso_size;
+            vh->hdr_len = sizeof(struct eth_header) + meta->hdr_len;
+        }
+    }
+
+    // Build Ethernet header
+    struct eth_header *eth = (struct eth_header *)(buffer + v_hdr_size);
+    memcpy(eth->dest_mac, dest_mac, 6);
+    memcpy(eth->src_mac, aether_mac, 6);
+    eth->ethertype = __builtin_bswap16(ethertype);
+}
+
+void ethernet_send_meta(uint8_t *dest_mac, uint16_t ethertype, uint8_t *payload, uint32_t len,
+                        const struct net_meta *meta) {
     // 1. Safety check using the correct global name
     if (!global_vnet_dev || !global_vnet_dev->tx_vq) return;
 
@@ -21,36 +83,60 @@ void ethernet_send(uint8_t *dest_mac, uint16_t ethertype, uint8_t *payload, uint
     uint32_t v_hdr_size = sizeof(struct virtio_net_hdr); 
     uint32_t total_len = v_hdr_size + sizeof(struct eth_header) + len;
     
-    // 3. Allocation
-    uint8_t *buffer = (uint8_t *)kmalloc(total_len);
+    // 3. Allocation (DMA zone: the device reads it in place)
+    uint8_t *buffer = (uint8_t *)dma_alloc(total_len, DMA_STREAMING);
     if (!buffer) return;
 
-    // 4. Zero out VirtIO header
-    memset(buffer, 0, v_hdr_size);
+    // 4. VirtIO + Ethernet headers
+    ethernet_build_header(buffer, dest_mac, ethertype, meta);
 
-    // 5. Build Ethernet header
-    struct eth_header *eth = (struct eth_header *)(buffer + v_hdr_size);
-    memcpy(eth->dest_mac, dest_mac, 6);
-    memcpy(eth->src_mac, aether_mac, 6);
-    eth->ethertype = __builtin_bswap16(ethertype);
-
-    // 6. Copy payload (ARP/IP data)
+    // 5. Copy payload (ARP/IP data)
     memcpy(buffer + v_hdr_size + sizeof(struct eth_header), payload, len);
 
-    // 7. Sync cache so DMA controller sees it
-    // Note: Assuming clean_cache_range is in include/kernel/mmu.h or similar
-    clean_cache_range((uintptr_t)buffer, (uintptr_t)buffer + total_len);
+    // 6. Sync cache so DMA controller sees it
+    dma_sync_for_device(buffer, total_len);
     asm volatile("dsb sy" ::: "memory");
 
-    // 8. Queue it up using the name from your .h (tx_vq)
-    struct virtqueue *tx_q = global_vnet_dev->tx_vq;
-    uint16_t head = virtqueue_add_descriptor(tx_q, (uintptr_t)buffer, total_len, 0);
-    
-    // 9. Notify hardware
-    virtqueue_push_available(global_vnet_dev, tx_q, head);
+    // 7. Queue it on this core's pair; inside a batch the doorbell waits
+    int more = tx_batch_depth[smp_processor_id()] != 0;
+
+    if (virtio_net_xmit(buffer, total_len, more) < 0) {
+        dma_free(buffer, total_len);
+        stat_inc(&global_net_stats.dropped_packets);
+    }
+}
+
+void ethernet_send_frags(uint8_t *dest_mac, uint16_t ethertype, struct netbuf *payload,
+                         const struct net_meta *meta) {
+    uint32_t hdr_size = sizeof(struct virtio_net_hdr) + sizeof(struct eth_header);
+    uint8_t *buffer = NULL;
+
+    if (global_vnet_dev && global_vnet_dev->tx_vq)
+        buffer = (uint8_t *)dma_alloc(hdr_size, DMA_STREAMING);
+
+    if (!buffer) {
+        netbuf_free_data(payload);
+        return;
+    }
+
+    ethernet_build_header(buffer, dest_mac, ethertype, meta);
+
+    /* Headers first, then the caller's buffers as they are */
+    struct netbuf frame = { buffer, hdr_size, payload };
+
+    for (struct netbuf *nb = &frame; nb; nb = nb->next)
+        dma_sync_for_device(nb->data, nb->len);
+    asm volatile("dsb sy" ::: "memory");
+
+    int more = tx_batch_depth[smp_processor_id()] != 0;
+
+    if (virtio_net_xmit_sg(&frame, more) < 0) {
+        netbuf_free_data(&frame);
+        stat_inc(&global_net_stats.dropped_packets);
+    }
 }
 
-void ethernet_handle_packet(uint8_t *data, uint32_t len) {
+void ethernet_handle_packet(uint8_t *data, uint32_t len, const struct net_meta *meta) {
     if (len < sizeof(struct eth_header)) return;
 
     struct eth_header *eth = (struct eth_header *)data;
@@ -67,7 +153,7 @@ void ethernet_handle_packet(uint8_t *data, uint32_t len) {
             break;
             
         case ETH_TYPE_IPV4:
-            ipv4_handle(payload, payload_len);
+            ipv4_handle(payload, payload_len, meta);
             break;
 
         case 0x86DD:
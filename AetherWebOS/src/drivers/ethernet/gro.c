@@ -0,0 +1,249 @@
+#include "drivers/ethernet/gro.h"
+#include "drivers/ethernet/ethernet.h"
+#include "drivers/ethernet/ipv4.h"
+#include "drivers/ethernet/tcp/tcp_internal.h"
+#include "kernel/smp.h"
+#include "kernel/health.h"
+#include "kernel/atomic.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Per-Core Flow Table
+   ===================================================== */
+
+#define GRO_ETH_LEN     sizeof(struct eth_header)
+#define GRO_IP_LEN      sizeof(struct ipv4_header)
+
+struct gro_flow {
+    uint8_t          used;
+    uint16_t         segs;              /* Segments merged into buf (bounded by its size) */
+    uint32_t         len;               /* Frame bytes in buf */
+    uint32_t         next_seq;          /* Sequence number that may be appended */
+    struct net_meta  meta;
+    uint8_t          buf[GRO_ETH_LEN + GRO_MAX_SIZE];
+};
+
+struct gro_cpu {
+    struct gro_flow  flows[GRO_MAX_FLOWS];
+    uint32_t         evict;             /* Round-robin victim when all are held */
+    gro_stats_t      stats;
+} __attribute__((aligned(64)));
+
+static struct gro_cpu gro_cpus[MAX_CPUS];
+
+/* A parsed IPv4/TCP frame */
+struct gro_seg {
+    struct ipv4_header *ip;
+    tcp_hdr_t          *th;
+    uint32_t            thlen;
+    uint32_t            payload_len;
+    uint32_t            seq;
+};
+
+enum {
+    GRO_NONE = 0,       /* Not TCP over IPv4: no flow */
+    GRO_PASS,           /* TCP, but must not be merged */
+    GRO_HOLD            /* In-sequence data candidate */
+};
+
+#define GRO_BAD_FLAGS   (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST | 0x20 /* URG */)
+
+static int gro_parse(uint8_t *frame, uint32_t len, struct gro_seg *s)
+{
+    struct eth_header *eth = (struct eth_header *)frame;
+
+    if (len < GRO_ETH_LEN + GRO_IP_LEN + sizeof(tcp_hdr_t) ||
+        ntohs(eth->ethertype) != ETH_TYPE_IPV4)
+        return GRO_NONE;
+
+    /* Set before the GRO_PASS returns below: gro_find() reads both */
+    s->ip = (struct ipv4_header *)(frame + GRO_ETH_LEN);
+    s->th = (tcp_hdr_t *)(frame + GRO_ETH_LEN + GRO_IP_LEN);
+    if (s->ip->protocol != IP_PROTO_TCP)
+        return GRO_NONE;
+
+    /* Already large (a GSO receive): nothing to gain, and it would not fit */
+    if (len > GRO_ETH_LEN + GRO_MAX_SIZE)
+        return GRO_PASS;
+
+    /* Options or fragments: leave it to ipv4_handle */
+    uint16_t total = ntohs(s->ip->total_len);
+    if (s->ip->version_ihl != 0x45 || (ntohs(s->ip->flags_fragment) & 0x3FFF) ||
+        total > len - GRO_ETH_LEN)
+        return GRO_PASS;
+
+    s->thlen = (s->th->offset_reserved >> 4) * 4;
+    if (s->thlen < sizeof(tcp_hdr_t) || GRO_IP_LEN + s->thlen > total)
+        return GRO_PASS;
+
+    s->payload_len = total - GRO_IP_LEN - s->thlen;
+    s->seq = ntohl(s->th->seq);
+
+    if (!s->payload_len || (s->th->flags & GRO_BAD_FLAGS))
+        return GRO_PASS;
+
+    return GRO_HOLD;
+}
+
+/* Same MACs, addresses and ports */
+static struct gro_flow *gro_find(struct gro_cpu *g, const uint8_t *frame, const struct gro_seg *s)
+{
+    for (int i = 0; i < GRO_MAX_FLOWS; i++) {
+        struct gro_flow *f = &g->flows[i];
+
+        if (f->used &&
+            memcmp(f->buf, frame, GRO_ETH_LEN) == 0 &&
+            memcmp(f->buf + GRO_ETH_LEN + 12, &s->ip->src_ip, 8) == 0 &&
+            memcmp(f->buf + GRO_ETH_LEN + GRO_IP_LEN, s->th, 4) == 0)
+            return f;
+    }
+
+    return 0;
+}
+
+/*
+ * Merged checksums cannot be checked later: do it per segment, now, and
+ * count it here; held flows go up with NET_META_GRO so tcp_input() does
+ * not count them again. A failed check is left for the stack to count.
+ */
+static int gro_verify(const struct gro_seg *s, const struct net_meta *meta)
+{
+    /* Same test ipv4_handle() applies, which will not see these segments */
+    uint16_t original = s->ip->checksum;
+    s->ip->checksum = 0;
+    uint16_t computed = ipv4_checksum(s->ip, GRO_IP_LEN);
+    s->ip->checksum = original;
+
+    if (computed != original)
+        return 0;
+
+    if (meta->flags & NET_META_CSUM_VALID) {
+        stat_inc(&global_net_stats.csum_rx_offload);
+        return 1;
+    }
+
+    if (!tcp_validate_checksum(ntohl(s->ip->src_ip), ntohl(s->ip->dest_ip),
+                               (const uint8_t *)s->th, s->thlen + s->payload_len))
+        return 0;
+
+    stat_inc(&global_net_stats.csum_rx_sw);
+    return 1;
+}
+
+static void gro_deliver(struct gro_cpu *g, struct gro_flow *f)
+{
+    struct ipv4_header *ip = (struct ipv4_header *)(f->buf + GRO_ETH_LEN);
+
+    /* The stale TCP checksum is covered by NET_META_CSUM_VALID */
+    if (f->segs > 1) {
+        ip->total_len = htons(f->len - GRO_ETH_LEN);
+        ip->checksum = 0;
+        ip->checksum = ipv4_checksum(ip, GRO_IP_LEN);
+    }
+
+    f->used = 0;
+    g->stats.flushed++;
+    ethernet_handle_packet(f->buf, f->len, &f->meta);
+}
+
+static int gro_can_append(struct gro_flow *f, const struct gro_seg *s)
+{
+    tcp_hdr_t *held = (tcp_hdr_t *)(f->buf + GRO_ETH_LEN + GRO_IP_LEN);
+    uint32_t held_thlen = (held->offset_reserved >> 4) * 4;
+
+    /* PSH ends a merge: the sender wants it read now */
+    return s->seq == f->next_seq &&
+           !(held->flags & TCP_FLAG_PSH) &&
+           held->ack == s->th->ack &&
+           held->window == s->th->window &&
+           held_thlen == s->thlen &&
+           memcmp((uint8_t *)held + sizeof(tcp_hdr_t), (uint8_t *)s->th + sizeof(tcp_hdr_t),
+                  s->thlen - sizeof(tcp_hdr_t)) == 0 &&
+           f->len + s->payload_len <= sizeof(f->buf);
+}
+
+/* =====================================================
+   Receive & Flush
+   ===================================================== */
+
+void gro_receive(uint8_t *frame, uint32_t len, const struct net_meta *meta)
+{
+    struct gro_cpu *g = &gro_cpus[smp_processor_id()];
+    struct gro_seg s;
+    struct gro_flow *f;
+    int kind = gro_parse(frame, len, &s);
+
+    if (kind == GRO_NONE)
+        goto bypass;
+
+    f = gro_find(g, frame, &s);
+
+    if (kind == GRO_PASS) {
+        /* Keep the flow in order: what was held goes up first */
+        if (f)
+            gro_deliver(g, f);
+        goto bypass;
+    }
+
+    if (!gro_verify(&s, meta)) {
+        /* Let the stack count and drop it */
+        if (f)
+            gro_deliver(g, f);
+        goto bypass;
+    }
+
+    if (f && gro_can_append(f, &s)) {
+        tcp_hdr_t *held = (tcp_hdr_t *)(f->buf + GRO_ETH_LEN + GRO_IP_LEN);
+
+        memcpy(f->buf + f->len, (uint8_t *)s.th + s.thlen, s.payload_len);
+        f->len += s.payload_len;
+        f->next_seq += s.payload_len;
+        f->segs++;
+        held->flags |= s.th->flags & TCP_FLAG_PSH;
+        g->stats.merged++;
+        return;
+    }
+
+    if (f) {
+        gro_deliver(g, f);
+    } else {
+        for (int i = 0; i < GRO_MAX_FLOWS && !f; i++) {
+            if (!g->flows[i].used)
+                f = &g->flows[i];
+        }
+        if (!f) {
+            f = &g->flows[g->evict++ % GRO_MAX_FLOWS];
+            gro_deliver(g, f);
+        }
+    }
+
+    /* Hold a copy: the driver recycles @frame as soon as we return */
+    f->len = GRO_ETH_LEN + GRO_IP_LEN + s.thlen + s.payload_len;
+    memcpy(f->buf, frame, f->len);
+    f->next_seq = s.seq + s.payload_len;
+    f->segs = 1;
+    f->meta = *meta;
+    f->meta.flags |= NET_META_CSUM_VALID | NET_META_GRO;
+    f->used = 1;
+    return;
+
+bypass:
+    g->stats.bypass++;
+    ethernet_handle_packet(frame, len, meta);
+}
+
+void gro_flush(void)
+{
+    struct gro_cpu *g = &gro_cpus[smp_processor_id()];
+
+    for (int i = 0; i < GRO_MAX_FLOWS; i++) {
+        if (g->flows[i].used)
+            gro_deliver(g, &g->flows[i]);
+    }
+}
+
+void gro_get_stats(uint32_t cpu, gro_stats_t *out)
+{
+    if (cpu < MAX_CPUS)
+        *out = gro_cpus[cpu].stats;
+}
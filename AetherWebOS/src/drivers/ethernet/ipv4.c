@@ -4,9 +4,12 @@
 
 #include "drivers/uart.h"
 #include "kernel/memory.h"
+#include "kernel/dma.h"
 #include "kernel/health.h"
+#include "kernel/klog.h"
 #include "common/utils.h"
 #include "drivers/virtio/virtio_net.h"
+#include "drivers/ethernet/netbuf.h"
 
 /* Global identity (HOST ORDER) */
 extern uint32_t aether_ip;
@@ -41,7 +44,7 @@ uint16_t ipv4_checksum(void *data, size_t len)
  *                  IPv4 RX HANDLER
  * ============================================================ */
 
-void ipv4_handle(uint8_t *data, uint32_t len)
+void ipv4_handle(uint8_t *data, uint32_t len, const struct net_meta *meta)
 {
     if (len < sizeof(struct ipv4_header))
         return;
@@ -96,15 +99,16 @@ void ipv4_handle(uint8_t *data, uint32_t len)
             tcp_input_process(payload,
                       payload_len,
                       src_ip,
-                      dst_ip);
+                      dst_ip,
+                      meta);
             break;
 
         case IP_PROTO_UDP:
-            uart_debugps("[IP] UDP packet\r\n");
+            klog_trace(KLOG_SUB_IP, "UDP from %I, ignored", src_ip);
             break;
 
         case IP_PROTO_ICMP:
-            uart_debugps("[IP] ICMP packet\r\n");
+            klog_trace(KLOG_SUB_IP, "ICMP from %I, ignored", src_ip);
             break;
 
         default:
@@ -121,19 +125,19 @@ void ipv4_send(uint32_t dst_ip,
                const uint8_t *payload,
                uint32_t payload_len)
 {
-    if (!global_vnet_dev)
-        return;
-
-    uint32_t total_len =
-        sizeof(struct ipv4_header) + payload_len;
-
-    struct ipv4_header *pkt =
-        (struct ipv4_header *)kmalloc(total_len);
+    ipv4_send_meta(dst_ip, protocol, payload, payload_len, NULL);
+}
 
-    if (!pkt)
-        return;
+/* QEMU user-mode default gateway MAC */
+static uint8_t gateway_mac[6] =
+    {0x52, 0x54, 0x00, 0x12, 0x34, 0x56};
 
-    memset(pkt, 0, total_len);
+static void ipv4_fill_header(struct ipv4_header *pkt,
+                             uint32_t dst_ip,
+                             uint8_t protocol,
+                             uint32_t total_len)
+{
+    memset(pkt, 0, sizeof(struct ipv4_header));
 
     pkt->version_ihl    = 0x45;  /* IPv4, header=20 bytes */
     pkt->tos            = 0;
@@ -149,22 +153,82 @@ void ipv4_send(uint32_t dst_ip,
 
     pkt->checksum =
         ipv4_checksum(pkt, sizeof(struct ipv4_header));
+}
+
+/* Offsets below us now start at the IP header */
+static const struct net_meta *ipv4_l3_meta(const struct net_meta *meta,
+                                           struct net_meta *l3_meta)
+{
+    if (!meta)
+        return NULL;
+
+    *l3_meta = *meta;
+    l3_meta->csum_start += sizeof(struct ipv4_header);
+    l3_meta->hdr_len += sizeof(struct ipv4_header);
+    return l3_meta;
+}
+
+void ipv4_send_meta(uint32_t dst_ip,
+                    uint8_t protocol,
+                    const uint8_t *payload,
+                    uint32_t payload_len,
+                    const struct net_meta *meta)
+{
+    if (!global_vnet_dev)
+        return;
+
+    uint32_t total_len =
+        sizeof(struct ipv4_header) + payload_len;
+
+    struct ipv4_header *pkt =
+        (struct ipv4_header *)kmalloc(total_len);
+
+    if (!pkt)
+        return;
+
+    ipv4_fill_header(pkt, dst_ip, protocol, total_len);
 
     /* Copy payload */
     memcpy((uint8_t *)pkt + sizeof(struct ipv4_header),
            payload,
            payload_len);
 
-    /* QEMU user-mode default gateway MAC */
-    uint8_t gateway_mac[6] =
-        {0x52, 0x54, 0x00, 0x12, 0x34, 0x56};
+    struct net_meta l3_meta;
 
-    ethernet_send(
+    ethernet_send_meta(
         gateway_mac,
         ETH_TYPE_IPV4,
         (uint8_t *)pkt,
-        total_len
+        total_len,
+        ipv4_l3_meta(meta, &l3_meta)
     );
 
     kfree(pkt);
-}
\ No newline at end of file
+}
+
+void ipv4_send_frags(uint32_t dst_ip,
+                     uint8_t protocol,
+                     struct netbuf *payload,
+                     const struct net_meta *meta)
+{
+    struct ipv4_header *pkt = NULL;
+
+    if (global_vnet_dev)
+        pkt = (struct ipv4_header *)dma_alloc(sizeof(struct ipv4_header), DMA_STREAMING);
+
+    if (!pkt) {
+        netbuf_free_data(payload);
+        return;
+    }
+
+    uint32_t total_len =
+        sizeof(struct ipv4_header) + netbuf_chain_len(payload);
+
+    ipv4_fill_header(pkt, dst_ip, protocol, total_len);
+
+    /* Only the header is new: the payload goes down as it is */
+    struct netbuf l3 = { (uint8_t *)pkt, sizeof(struct ipv4_header), payload };
+    struct net_meta l3_meta;
+
+    ethernet_send_frags(gateway_mac, ETH_TYPE_IPV4, &l3, ipv4_l3_meta(meta, &l3_meta));
+}
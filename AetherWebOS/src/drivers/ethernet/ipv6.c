@@ -2,16 +2,24 @@
 #include "drivers/ethernet/ipv6.h"
 #include "drivers/uart.h"
 #include "common/utils.h" // For bswap if needed
+#include "kernel/klog.h"
 
 /* ---------- helpers ---------- */
 
 static uint32_t bswap32(uint32_t x) {
     return __builtin_bswap32(x); // Use the builtins for AArch64 efficiency
 }
-/* ---------- IPv6 printer with :: compression ---------- */
+/* ---------- IPv6 formatter with :: compression ---------- */
 
-void print_ipv6(uint8_t addr[16]) {
+/**
+ * ipv6_format: Writes @addr into @out (at least IPV6_STR_LEN bytes),
+ * NUL-terminated. Shared by the UART printer and the TUI dashboard.
+ */
+int ipv6_format(const uint8_t addr[16], char *out) {
+    static const char hex[] = "0123456789abcdef";
     uint16_t words[8];
+    int pos = 0;
+
     for (int i = 0; i < 8; i++) {
         words[i] = ((uint16_t)addr[i*2] << 8) | addr[i*2+1];
     }
@@ -36,18 +44,30 @@ void print_ipv6(uint8_t addr[16]) {
 
     for (int i = 0; i < 8; i++) {
         if (i == best_start) {
-            uart_puts("::");
+            out[pos++] = ':';
+            out[pos++] = ':';
             i += best_len - 1;
             continue;
         }
 
-        uart_print_hex16(words[i]);
+        for (int shift = 12; shift >= 0; shift -= 4)
+            out[pos++] = hex[(words[i] >> shift) & 0xF];
 
         // Only print colon if not at the end and not right before compression
         if (i != 7 && (i + 1 != best_start)) {
-            uart_putc(':');
+            out[pos++] = ':';
         }
     }
+
+    out[pos] = '\0';
+    return pos;
+}
+
+void print_ipv6(uint8_t addr[16]) {
+    char buf[IPV6_STR_LEN];
+
+    ipv6_format(addr, buf);
+    uart_puts(buf);
 }
 
 /* ---------- main handler ---------- */
@@ -63,13 +83,18 @@ void ipv6_handle(uint8_t *data, uint32_t len) {
 
     if (version != 6) return;
 
-    uart_puts("[IPv6] src: ");
-    print_ipv6(hdr->src_addr);
-    uart_puts(" -> ");
-
+    const char *proto;
     switch (hdr->next_header) {
-        case 58: uart_puts("ICMPv6\r\n"); break;
-        case 6:  uart_puts("TCP\r\n"); break;
-        default: uart_puts("Unknown Proto\r\n"); break;
+        case 58: proto = "ICMPv6"; break;
+        case 6:  proto = "TCP"; break;
+        default: proto = "Unknown Proto"; break;
     }
+
+    /* Low 64 bits of the source identify the host on the link */
+    uint64_t iid = 0;
+    for (int i = 8; i < 16; i++)
+        iid = (iid << 8) | hdr->src_addr[i];
+
+    klog_debug(KLOG_SUB_IP, "IPv6 from ::%x %s (%u)",
+               iid, (uintptr_t)proto, hdr->next_header);
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "drivers/ethernet/netbuf.h"
+#include "kernel/dma.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Page Pool
+   ===================================================== */
+
+void page_pool_init(struct page_pool *pp, const char *name, uint32_t max_free)
+{
+    memset(pp, 0, sizeof(*pp));
+    spin_lock_init(&pp->lock, name);
+    pp->max_free = max_free;
+}
+
+void *page_pool_get(struct page_pool *pp)
+{
+    uint64_t flags = spin_lock_irqsave(&pp->lock);
+    void *page = pp->free;
+
+    if (page) {
+        pp->free = *(void **)page;
+        pp->nr_free--;
+        pp->recycled++;
+    }
+
+    pp->allocs++;
+    pp->in_use++;
+    spin_unlock_irqrestore(&pp->lock, flags);
+
+    if (page)
+        return page;
+
+    page = dma_alloc(PAGE_SIZE, DMA_STREAMING);
+    if (!page) {
+        flags = spin_lock_irqsave(&pp->lock);
+        pp->in_use--;
+        pp->failures++;
+        spin_unlock_irqrestore(&pp->lock, flags);
+    }
+
+    return page;
+}
+
+void page_pool_put(struct page_pool *pp, void *page)
+{
+    if (!page)
+        return;
+
+    uint64_t flags = spin_lock_irqsave(&pp->lock);
+    pp->in_use--;
+
+    if (pp->nr_free < pp->max_free) {
+        *(void **)page = pp->free;
+        pp->free = page;
+        pp->nr_free++;
+        page = 0;
+    }
+
+    spin_unlock_irqrestore(&pp->lock, flags);
+
+    if (page)
+        dma_free(page, PAGE_SIZE);
+}
+
+/* =====================================================
+   Chains
+   ===================================================== */
+
+uint32_t netbuf_chain_len(const struct netbuf *nb)
+{
+    uint32_t len = 0;
+
+    for (; nb; nb = nb->next)
+        len += nb->len;
+
+    return len;
+}
+
+uint32_t netbuf_linearize(const struct netbuf *nb, uint8_t *out, uint32_t out_size)
+{
+    uint32_t pos = 0;
+
+    for (; nb && pos < out_size; nb = nb->next) {
+        uint32_t n = nb->len;
+
+        if (n > out_size - pos)
+            n = out_size - pos;
+
+        memcpy(out + pos, nb->data, n);
+        pos += n;
+    }
+
+    return pos;
+}
+
+void netbuf_free_data(struct netbuf *nb)
+{
+    for (; nb; nb = nb->next)
+        dma_free(nb->data, nb->len);
+}
@@ -0,0 +1,285 @@
+#include "drivers/ethernet/rss.h"
+#include "drivers/ethernet/ethernet.h"
+#include "drivers/ethernet/gro.h"
+#include "kernel/smp.h"
+#include "kernel/sched.h"
+#include "kernel/spinlock.h"
+#include "kernel/atomic.h"
+#include "kernel/memory.h"
+#include "kernel/klog.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Key & Indirection Table
+   ===================================================== */
+
+/* The Microsoft RSS verification key, also the usual NIC default */
+static const uint8_t rss_default_key[RSS_KEY_SIZE] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+    0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+    0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+    0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+    0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+static uint16_t rss_indir[RSS_INDIR_SIZE];
+static uint32_t rss_queues = 1;
+static uint8_t  rss_hw;
+
+/* =====================================================
+   Per-Core Backlog
+   ===================================================== */
+
+struct rss_frame {
+    uint8_t  *data;
+    uint32_t  len;
+    struct net_meta meta;
+};
+
+struct rss_backlog {
+    spinlock_t        lock;
+    uint32_t          head;             /* Consumer */
+    uint32_t          tail;             /* Producer */
+    uint8_t           kicked;           /* Drain work requested, not yet run */
+    struct sched_work work;
+    rss_stats_t       stats;
+    struct rss_frame  ring[RSS_BACKLOG_SIZE];
+} __attribute__((aligned(64)));
+
+static struct rss_backlog rss_backlogs[MAX_CPUS];
+
+static void rss_backlog_drain(struct sched_work *w)
+{
+    struct rss_backlog *b = (struct rss_backlog *)w->data;
+    int done = 0;
+
+    /* Replies to the whole batch share one doorbell */
+    ethernet_tx_batch_begin();
+
+    while (done < RSS_BACKLOG_BUDGET) {
+        uint64_t flags = spin_lock_irqsave(&b->lock);
+
+        if (b->head == b->tail) {
+            b->kicked = 0;
+            spin_unlock_irqrestore(&b->lock, flags);
+            gro_flush();
+            ethernet_tx_batch_end();
+            return;
+        }
+
+        struct rss_frame f = b->ring[b->head & (RSS_BACKLOG_SIZE - 1)];
+        b->head++;
+        spin_unlock_irqrestore(&b->lock, flags);
+
+        gro_receive(f.data, f.len, &f.meta);
+        kfree(f.data);
+
+        b->stats.steered_in++;
+        done++;
+    }
+
+    /* More left: yield to the rest of the pass, then continue here */
+    gro_flush();
+    ethernet_tx_batch_end();
+    sched_queue_work(w);
+}
+
+/* Producer side: any core; 0 if queued, -1 if dropped */
+static int rss_backlog_push(uint32_t cpu, const uint8_t *frame, uint32_t len,
+                            const struct net_meta *meta)
+{
+    struct rss_backlog *b = &rss_backlogs[cpu];
+    uint8_t *copy = (uint8_t *)kmalloc(len);
+
+    if (!copy)
+        return -1;
+
+    memcpy(copy, frame, len);
+
+    uint64_t flags = spin_lock_irqsave(&b->lock);
+
+    if (b->tail - b->head >= RSS_BACKLOG_SIZE) {
+        spin_unlock_irqrestore(&b->lock, flags);
+        kfree(copy);
+        return -1;
+    }
+
+    b->ring[b->tail & (RSS_BACKLOG_SIZE - 1)].data = copy;
+    b->ring[b->tail & (RSS_BACKLOG_SIZE - 1)].len  = len;
+    b->ring[b->tail & (RSS_BACKLOG_SIZE - 1)].meta = *meta;
+    b->tail++;
+
+    int kick = !b->kicked;
+    b->kicked = 1;
+    spin_unlock_irqrestore(&b->lock, flags);
+
+    /* One IPI per drain, not per frame */
+    if (kick && sched_queue_work_on(cpu, &b->work) < 0) {
+        flags = spin_lock_irqsave(&b->lock);
+        b->kicked = 0;                  /* Let the next frame retry */
+        spin_unlock_irqrestore(&b->lock, flags);
+    }
+
+    return 0;
+}
+
+/* =====================================================
+   Hashing
+   ===================================================== */
+
+uint32_t rss_toeplitz(const uint8_t *input, uint32_t len)
+{
+    const uint8_t *key = rss_default_key;
+    uint32_t hash = 0;
+    uint32_t window = ((uint32_t)key[0] << 24) | ((uint32_t)key[1] << 16) |
+                      ((uint32_t)key[2] << 8)  |  (uint32_t)key[3];
+
+    /* 12-byte IPv4 tuples only ever need the first 16 key bytes */
+    if (len > RSS_KEY_SIZE - 4)
+        len = RSS_KEY_SIZE - 4;
+
+    for (uint32_t i = 0; i < len; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            if (input[i] & (1u << bit))
+                hash ^= window;
+            window = (window << 1) | ((key[i + 4] >> bit) & 1);
+        }
+    }
+
+    return hash;
+}
+
+int rss_hash_frame(const uint8_t *frame, uint32_t len, uint32_t *hash)
+{
+    const struct eth_header *eth = (const struct eth_header *)frame;
+
+    if (len < sizeof(struct eth_header) + 20 || ntohs(eth->ethertype) != ETH_TYPE_IPV4)
+        return 0;
+
+    const uint8_t *ip = frame + sizeof(struct eth_header);
+    uint32_t ihl = (ip[0] & 0x0F) * 4;
+    uint8_t proto = ip[9];
+    uint16_t frag = ((uint16_t)ip[6] << 8) | ip[7];
+    uint8_t tuple[12];
+
+    memcpy(tuple, ip + 12, 8);          /* Source, destination address */
+
+    /* Ports only for unfragmented TCP/UDP; anything else hashes 2-tuple */
+    if ((proto == 6 || proto == 17) && !(frag & 0x3FFF) &&
+        len >= sizeof(struct eth_header) + ihl + 4) {
+        memcpy(tuple + 8, ip + ihl, 4);
+        *hash = rss_toeplitz(tuple, 12);
+    } else {
+        *hash = rss_toeplitz(tuple, 8);
+    }
+
+    return 1;
+}
+
+/* =====================================================
+   Receive
+   ===================================================== */
+
+void rss_receive(uint8_t *frame, uint32_t len, const struct net_meta *meta)
+{
+    uint32_t cpu = smp_processor_id();
+    struct rss_backlog *b = &rss_backlogs[cpu];
+    uint32_t hash;
+
+    if (rss_queues > 1 && !rss_hw && rss_hash_frame(frame, len, &hash)) {
+        uint32_t target = rss_indir[hash & (RSS_INDIR_SIZE - 1)];
+
+        if (target != cpu) {
+            if (rss_backlog_push(target, frame, len, meta) == 0)
+                b->stats.steered_out++;
+            else
+                b->stats.drops++;
+            return;
+        }
+    }
+
+    b->stats.local++;
+    gro_receive(frame, len, meta);
+}
+
+/* =====================================================
+   Setup & Stats
+   ===================================================== */
+
+void rss_init(uint32_t nr_queues)
+{
+    static uint8_t backlogs_ready;
+
+    if (!backlogs_ready) {
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            spin_lock_init(&rss_backlogs[cpu].lock, "rss_backlog");
+            sched_init_work(&rss_backlogs[cpu].work, rss_backlog_drain,
+                            &rss_backlogs[cpu], SCHED_PRIO_NET);
+        }
+        backlogs_ready = 1;
+    }
+
+    if (nr_queues == 0 || nr_queues > MAX_CPUS)
+        nr_queues = 1;
+
+    for (uint32_t i = 0; i < RSS_INDIR_SIZE; i++)
+        rss_indir[i] = i % nr_queues;
+
+    smp_store_release(&rss_queues, nr_queues);
+    klog_info(KLOG_SUB_NET, "RSS over %u queues (%s)", nr_queues,
+              (uintptr_t)(rss_hw ? "device" : "software"));
+}
+
+void rss_set_hw_steering(int enabled)
+{
+    rss_hw = enabled ? 1 : 0;
+}
+
+uint32_t rss_nr_queues(void)
+{
+    return rss_queues;
+}
+
+const uint8_t *rss_key(void)
+{
+    return rss_default_key;
+}
+
+const uint16_t *rss_indirection_table(void)
+{
+    return rss_indir;
+}
+
+void rss_get_stats(uint32_t cpu, rss_stats_t *out)
+{
+    if (cpu < MAX_CPUS)
+        *out = rss_backlogs[cpu].stats;
+}
+
+uint32_t rss_format(char *out, uint32_t out_size)
+{
+    uint32_t pos = 0;
+
+    pos += ksnprintf(out + pos, out_size - pos,
+                     "queues %u  steering %s\n"
+                     "cpu  local  steered_out  steered_in  drops  backlog  gro_merged  gro_flushed  gro_bypass\n",
+                     rss_queues, rss_hw ? "device" : "software");
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS && pos + 1 < out_size; cpu++) {
+        struct rss_backlog *b = &rss_backlogs[cpu];
+        gro_stats_t gro;
+
+        gro_get_stats(cpu, &gro);
+        pos += ksnprintf(out + pos, out_size - pos, "%u  %u  %u  %u  %u  %u  %u  %u  %u\n", cpu,
+                         (unsigned int)b->stats.local,
+                         (unsigned int)b->stats.steered_out,
+                         (unsigned int)b->stats.steered_in,
+                         (unsigned int)b->stats.drops,
+                         b->tail - b->head,
+                         (unsigned int)gro.merged,
+                         (unsigned int)gro.flushed,
+                         (unsigned int)gro.bypass);
+    }
+
+    return pos;
+}
@@ -4,6 +4,19 @@
 #include "drivers/ethernet/socket.h"
 #include "drivers/ethernet/tcp/tcp.h"
 #include "drivers/uart.h"
+#include "kernel/klog.h"
+#include "kernel/spinlock.h"
+#include "kernel/sched.h"
+#include "kernel/thread.h"
+#include "kernel/fiber.h"
+#include "kernel/irq.h"
+#include "kernel/atomic.h"
+#include "kernel/ipi.h"
+#include "kernel/dma.h"
+#include "kernel/timer.h"
+#include "drivers/virtio/virtio_net.h"
+#include "drivers/ethernet/rss.h"
+#include "common/utils.h"
 
 /* ============================================================
  *                  STATIC HTML CONTENT
@@ -20,8 +33,10 @@ static const char html_body[] =
 
 static const char http_header_prefix[] =
 "HTTP/1.0 200 OK\r\n"
-"Content-Type: text/html\r\n"
-"Content-Length: ";
+"Content-Type: ";
+
+/* One TCP segment is all tcp_send_data() can carry */
+#define HTTP_RESPONSE_MAX   1400
 
 /* ============================================================
  *                  SIMPLE HTTP CHECK
@@ -40,35 +55,87 @@ static int is_http_get(uint8_t *data, uint16_t len)
     return 0;
 }
 
-/* ============================================================
- *                  SOCKET DISPATCH
- * ============================================================ */
-
-void socket_dispatch(tcp_tcb_t *tcb,
-                     uint8_t *payload,
-                     uint16_t len)
+/* Matches "GET <path> " or "GET <path>?" */
+static int http_path_is(uint8_t *data, uint16_t len, const char *path)
 {
-    uart_debugps("[SOCKET] Packet received\n");
+    uint16_t i = 4;
 
-    uart_debugps("[SOCKET] First bytes: ");
-    uart_debugpc(payload[0]);
-    uart_debugpc(payload[1]);
-    uart_debugpc(payload[2]);
-    uart_debugps("\n");
+    while (*path) {
+        if (i >= len || data[i] != (uint8_t)*path)
+            return 0;
+        i++;
+        path++;
+    }
 
-    uart_debugps("[SOCKET] HTTP GET detected\n");
+    return i < len && (data[i] == ' ' || data[i] == '?');
+}
 
-    /* Build HTTP response in stack buffer */
-    char response[1024];
-    int offset = 0;
+static int append_str(char *out, int offset, const char *s)
+{
+    while (*s && offset < HTTP_RESPONSE_MAX)
+        out[offset++] = *s++;
+    return offset;
+}
 
-    /* Copy header prefix */
-    for (int i = 0; http_header_prefix[i] != 0; i++)
-        response[offset++] = http_header_prefix[i];
+/* ============================================================
+ *                  RESPONSE BUILDER
+ * ============================================================ */
 
-    /* Calculate body length */
+/* Formats the full HTTP response for @payload into @response */
+static int http_build_response(const uint8_t *payload, uint16_t len, char *response)
+{
+    char log_body[HTTP_RESPONSE_MAX - 96];
+    const char *content_type = "text/html";
+    const char *body = html_body;
     int body_len = sizeof(html_body) - 1;
 
+    if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/log")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = klog_format_recent(log_body, sizeof(log_body));
+    } else if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/locks")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = lock_stat_format(log_body, sizeof(log_body));
+    } else if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/tasks")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = sched_format(log_body, sizeof(log_body));
+    } else if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/threads")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = thread_format(log_body, sizeof(log_body));
+    } else if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/fibers")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = socket_format(log_body, sizeof(log_body));
+    } else if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/irqs")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = irq_format(log_body, sizeof(log_body));
+    } else if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/napi")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = virtio_net_format(log_body, sizeof(log_body));
+    } else if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/rss")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = rss_format(log_body, sizeof(log_body));
+    } else if (is_http_get((uint8_t *)payload, len) && http_path_is((uint8_t *)payload, len, "/dma")) {
+        content_type = "text/plain";
+        body = log_body;
+        body_len = dma_format(log_body, sizeof(log_body));
+    }
+
+    int offset = append_str(response, 0, http_header_prefix);
+    offset = append_str(response, offset, content_type);
+    offset = append_str(response, offset, "\r\nContent-Length: ");
+
+    /* Announce only what fits after the length digits and the blank line */
+    int room = HTTP_RESPONSE_MAX - offset - 10 - 4;
+    if (body_len > room)
+        body_len = room > 0 ? room : 0;
+
     /* Convert body_len to decimal string */
     int temp = body_len;
     char digits[10];
@@ -88,13 +155,426 @@ void socket_dispatch(tcp_tcb_t *tcb,
     response[offset++] = '\r';
     response[offset++] = '\n';
 
-    /* Copy HTML body */
-    for (int i = 0; i < body_len; i++)
-        response[offset++] = html_body[i];
+    /* Copy body */
+    for (int i = 0; i < body_len && offset < HTTP_RESPONSE_MAX; i++)
+        response[offset++] = body[i];
+
+    klog_debug(KLOG_SUB_HTTP, "built %u byte response (%s)",
+               offset, (uintptr_t)content_type);
+
+    return offset;
+}
+
+/* ============================================================
+ *                  SOCKETS
+ * ============================================================
+ *
+ * A socket couples a TCB with a receive ring and the fiber that serves
+ * it. tcp_input pushes payload into the ring and unparks the fiber;
+ * sock_recv/sock_send park the fiber until data, window space or EOF
+ * arrive. A connection's segments, its TCB and its fiber all stay on the
+ * core its flow is steered to (rss.h), so only the pool is shared.
+ */
+
+#define SOCK_MAX                FIBER_MAX
+#define SOCK_RX_SIZE            2048                    /* Power of two */
+#define SOCK_RECV_TIMEOUT_NS    (5000 * 1000000ULL)     /* Idle client */
+#define SOCK_SEND_TIMEOUT_NS    (2000 * 1000000ULL)     /* Window stuck shut */
+
+#define SOCK_F_EOF      0x01    /* Peer sent FIN */
+#define SOCK_F_CLOSED   0x02    /* TCB freed under us */
+
+struct sock {
+    tcp_tcb_t     *tcb;
+    struct fiber  *waiter;      /* Parked in sock_recv/sock_send */
+    uint32_t       rx_head;     /* Consumer */
+    uint32_t       rx_tail;     /* Producer */
+    uint8_t        flags;
+    struct sock   *next_free;
+    uint8_t        rx[SOCK_RX_SIZE];
+};
+
+static struct sock socks[SOCK_MAX];
+static struct sock *sock_free_list;
+static spinlock_t sock_pool_lock;
+static uint32_t sock_open;
+static unsigned long sock_rx_dropped;
+
+static sock_t *sock_alloc(tcp_tcb_t *tcb)
+{
+    uint64_t flags = spin_lock_irqsave(&sock_pool_lock);
+    struct sock *sk = sock_free_list;
+
+    if (!sk) {
+        spin_unlock_irqrestore(&sock_pool_lock, flags);
+        return NULL;
+    }
+
+    sock_free_list = sk->next_free;
+    sock_open++;
+    spin_unlock_irqrestore(&sock_pool_lock, flags);
+
+    sk->tcb = tcb;
+    sk->waiter = NULL;
+    sk->rx_head = sk->rx_tail = 0;
+    sk->flags = 0;
+
+    /* Advertise no more than the ring holds */
+    tcp_set_rcv_window(tcb, SOCK_RX_SIZE);
+    tcp_set_context(tcb, sk);
+    return sk;
+}
+
+static void sock_free(sock_t *sk)
+{
+    uint64_t flags = spin_lock_irqsave(&sock_pool_lock);
+    sk->next_free = sock_free_list;
+    sock_free_list = sk;
+    sock_open--;
+    spin_unlock_irqrestore(&sock_pool_lock, flags);
+}
+
+/* Called by the TCP layer; returns 1 if the socket owns the event */
+int socket_notify(tcp_tcb_t *tcb, int event)
+{
+    struct sock *sk = (struct sock *)tcp_get_context(tcb);
+
+    if (!sk)
+        return 0;
+
+    if (event == SOCK_EV_FIN)
+        sk->flags |= SOCK_F_EOF;
+
+    if (event == SOCK_EV_CLOSED) {
+        sk->flags |= SOCK_F_CLOSED;
+        sk->tcb = NULL;
+    }
+
+    fiber_unpark(sk->waiter);
+    return 1;
+}
+
+/*
+ * Takes what fits and returns how much that was: the rest is left
+ * unacknowledged for the peer to resend. The advertised window shrinks
+ * to the room left so a well-behaved peer never overruns the ring.
+ */
+static uint16_t sock_rx_push(sock_t *sk, const uint8_t *data, uint16_t len)
+{
+    uint32_t room = SOCK_RX_SIZE - (sk->rx_tail - sk->rx_head);
+
+    if (len > room) {
+        sock_rx_dropped += len - room;
+        len = room;
+    }
+
+    for (uint16_t i = 0; i < len; i++)
+        sk->rx[(sk->rx_tail + i) & (SOCK_RX_SIZE - 1)] = data[i];
+    sk->rx_tail += len;
+
+    if (sk->tcb)
+        tcp_set_rcv_window(sk->tcb, room - len);
+
+    fiber_unpark(sk->waiter);
+    return len;
+}
+
+int sock_recv(sock_t *sk, void *buf, uint32_t len)
+{
+    uint8_t *out = (uint8_t *)buf;
+
+    while (sk->rx_tail == sk->rx_head) {
+        if (sk->flags & SOCK_F_EOF)
+            return 0;
+        if (sk->flags & SOCK_F_CLOSED)
+            return -1;
+
+        sk->waiter = fiber_current();
+        int ret = fiber_park(SOCK_RECV_TIMEOUT_NS);
+        sk->waiter = NULL;
+
+        if (ret < 0 && sk->rx_tail == sk->rx_head)
+            return -1;
+    }
 
-    uart_debugps("[SOCKET] Sending HTTP response\n");
+    uint32_t n = sk->rx_tail - sk->rx_head;
+    if (n > len)
+        n = len;
+
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = sk->rx[(sk->rx_head + i) & (SOCK_RX_SIZE - 1)];
+    sk->rx_head += n;
+
+    /* Reopen the window; a peer that saw it shut waits for an update */
+    if (sk->tcb)
+        tcp_set_rcv_window(sk->tcb, SOCK_RX_SIZE - (sk->rx_tail - sk->rx_head));
+
+    return n;
+}
+
+int sock_send(sock_t *sk, const void *buf, uint32_t len)
+{
+    const uint8_t *data = (const uint8_t *)buf;
+    uint32_t sent = 0;
+
+    while (sent < len) {
+        if (!sk->tcb)
+            return -1;
+
+        uint32_t space = tcp_send_space(sk->tcb);
+
+        if (!space) {
+            sk->waiter = fiber_current();
+            int ret = fiber_park(SOCK_SEND_TIMEOUT_NS);
+            sk->waiter = NULL;
+
+            if (ret < 0)
+                return sent ? (int)sent : -1;
+            continue;
+        }
+
+        sent += tcp_send_bulk(sk->tcb, data + sent, len - sent);
+    }
+
+    return sent;
+}
+
+void sock_close(sock_t *sk)
+{
+    if (sk->tcb) {
+        tcp_set_context(sk->tcb, NULL);
+        tcp_close(sk->tcb);
+    }
+
+    sock_free(sk);
+}
+
+/* ============================================================
+ *                  HTTPD THREAD
+ * ============================================================
+ *
+ * Responses are formatted on a preemptible thread so a slow handler
+ * cannot hold up packet processing. It runs at kmain's priority and the
+ * two take turns (kmain yields each pass, THREAD_SLICE_NS otherwise), so
+ * sustained traffic cannot starve it either. The connection fiber that
+ * owns the request parks until the response is ready, then sends it.
+ */
+
+#define HTTPD_SLOTS     4
+#define HTTPD_REQ_MAX   256     /* Request line and first headers */
+#define HTTPD_TIMEOUT_NS    (1000 * 1000000ULL)     /* httpd thread wedged */
+
+enum { HTTPD_FREE = 0, HTTPD_CLAIMED, HTTPD_QUEUED, HTTPD_BUSY, HTTPD_DONE };
+
+struct httpd_req {
+    volatile uint32_t state;            /* Claimed by CAS: fibers on any core */
+    struct fiber    *waiter;
+    uint16_t         req_len;
+    uint16_t         resp_len;
+    uint8_t          req[HTTPD_REQ_MAX];
+    char             resp[HTTP_RESPONSE_MAX];
+};
+
+static struct httpd_req httpd_reqs[HTTPD_SLOTS];
+static struct wait_queue httpd_wq;
+static struct fiber_waitq httpd_slot_wq;    /* Fibers waiting for a slot */
+static struct thread *httpd_thread = NULL;
+
+static int httpd_has_queued(void)
+{
+    for (int i = 0; i < HTTPD_SLOTS; i++)
+        if (httpd_reqs[i].state == HTTPD_QUEUED)
+            return 1;
+    return 0;
+}
+
+static void httpd_main(void *arg)
+{
+    (void)arg;
+
+    while (1) {
+        wait_event(&httpd_wq, httpd_has_queued());
+
+        for (int i = 0; i < HTTPD_SLOTS; i++) {
+            struct httpd_req *r = &httpd_reqs[i];
+
+            /* Loses to a fiber that gave up on the slot */
+            if (atomic32_cmpxchg(&r->state, HTTPD_QUEUED, HTTPD_BUSY) != HTTPD_QUEUED)
+                continue;
+
+            r->resp_len = http_build_response(r->req, r->req_len, r->resp);
+            smp_store_release(&r->state, HTTPD_DONE);
+            fiber_unpark(r->waiter);
+        }
+    }
+}
+
+/* wait_event() orders its check against wakers on the thread's own core */
+static void httpd_wake_ipi(void *arg)
+{
+    (void)arg;
+    wake_up_one(&httpd_wq);
+}
+
+/*
+ * Fiber context; waits for a free slot. The scan runs under the wait
+ * list lock so a release on another core either lands before it or
+ * finds us on the list.
+ */
+static struct httpd_req *httpd_claim(void)
+{
+    while (1) {
+        uint64_t flags = spin_lock_irqsave(&httpd_slot_wq.lock);
+
+        for (int i = 0; i < HTTPD_SLOTS; i++) {
+            if (atomic32_cmpxchg(&httpd_reqs[i].state, HTTPD_FREE, HTTPD_CLAIMED) == HTTPD_FREE) {
+                spin_unlock_irqrestore(&httpd_slot_wq.lock, flags);
+                httpd_reqs[i].waiter = fiber_current();
+                return &httpd_reqs[i];
+            }
+        }
+
+        fiber_wait_locked(&httpd_slot_wq, flags);
+    }
+}
+
+static void httpd_release(struct httpd_req *r)
+{
+    smp_store_release(&r->state, HTTPD_FREE);
+    fiber_wake_one(&httpd_slot_wq);
+}
+
+static int http_request_complete(const uint8_t *req, uint16_t len)
+{
+    for (uint16_t i = 3; i < len; i++)
+        if (req[i - 3] == '\r' && req[i - 2] == '\n' &&
+            req[i - 1] == '\r' && req[i] == '\n')
+            return 1;
+    return 0;
+}
+
+/* One fiber per connection: read, hand off to httpd, send, close */
+static void http_conn_main(void *arg)
+{
+    sock_t *sk = (sock_t *)arg;
+    uint8_t req[HTTPD_REQ_MAX];
+    uint16_t len = 0;
+
+    while (len < HTTPD_REQ_MAX) {
+        int n = sock_recv(sk, req + len, HTTPD_REQ_MAX - len);
+
+        if (n <= 0)
+            break;
+
+        len += n;
+        if (http_request_complete(req, len))
+            break;
+    }
+
+    if (len) {
+        struct httpd_req *r = httpd_claim();
+
+        memcpy(r->req, req, len);
+        r->req_len = len;
+        smp_store_release(&r->state, HTTPD_QUEUED);
+        smp_call_on(httpd_thread->cpu, httpd_wake_ipi, NULL);
+
+        uint64_t deadline = timer_get_ns() + HTTPD_TIMEOUT_NS;
+
+        while (smp_load_acquire(&r->state) != HTTPD_DONE) {
+            uint64_t now = timer_get_ns();
+
+            /* Not picked up in time: take the slot back and drop the request */
+            if (now >= deadline &&
+                atomic32_cmpxchg(&r->state, HTTPD_QUEUED, HTTPD_CLAIMED) == HTTPD_QUEUED) {
+                klog_warn(KLOG_SUB_HTTP, "request not picked up in %u ms, dropped",
+                          (uint32_t)(HTTPD_TIMEOUT_NS / 1000000));
+                break;
+            }
+
+            /* Once BUSY the response is on its way; only poll for it */
+            fiber_park(now < deadline ? deadline - now : HTTPD_TIMEOUT_NS);
+        }
+
+        if (r->state == HTTPD_DONE)
+            sock_send(sk, r->resp, r->resp_len);
+        httpd_release(r);
+    }
+
+    sock_close(sk);
+}
+
+void socket_init(void)
+{
+    spin_lock_init(&sock_pool_lock, "sock_pool");
+
+    for (int i = SOCK_MAX - 1; i >= 0; i--) {
+        socks[i].next_free = sock_free_list;
+        sock_free_list = &socks[i];
+    }
+
+    wait_queue_init(&httpd_wq, "httpd_wq");
+    fiber_waitq_init(&httpd_slot_wq);
+
+    /* kmain's priority: slices and its per-pass yield keep it fed under load */
+    httpd_thread = thread_create("httpd", httpd_main, NULL, THREAD_PRIO_HIGH);
+}
+
+uint32_t socket_format(char *out, uint32_t out_size)
+{
+    fiber_stats_t fs;
+
+    fiber_get_stats(&fs);
+
+    return ksnprintf(out, out_size,
+                     "fibers   live %u  peak %u  spawned %u  exhausted %u\n"
+                     "         switches %u  timeouts %u  overflows %u\n"
+                     "sockets  open %u  rx_dropped %u\n",
+                     fs.live, fs.peak,
+                     (unsigned int)fs.spawned,
+                     (unsigned int)fs.exhausted,
+                     (unsigned int)fs.switches,
+                     (unsigned int)fs.timeouts,
+                     (unsigned int)fs.overflows,
+                     sock_open,
+                     (unsigned int)sock_rx_dropped);
+}
+
+/* ============================================================
+ *                  SOCKET DISPATCH
+ * ============================================================ */
+
+uint16_t socket_dispatch(tcp_tcb_t *tcb,
+                         uint8_t *payload,
+                         uint16_t len)
+{
+    klog_debug(KLOG_SUB_HTTP, "segment %u bytes '%c%c%c'", len,
+               len > 0 ? payload[0] : '?',
+               len > 1 ? payload[1] : '?',
+               len > 2 ? payload[2] : '?');
+
+    sock_t *sk = (sock_t *)tcp_get_context(tcb);
+
+    /* First data on a new connection: give it a socket and a fiber */
+    if (!sk && httpd_thread) {
+        sk = sock_alloc(tcb);
+
+        if (sk && !fiber_spawn("http", http_conn_main, sk)) {
+            tcp_set_context(tcb, NULL);
+            sock_free(sk);
+            sk = NULL;
+        }
+    }
+
+    if (sk)
+        return sock_rx_push(sk, payload, len);
+
+    /* No thread, no socket or no fiber stack left: answer inline */
+    char response[HTTP_RESPONSE_MAX];
+    int offset = http_build_response(payload, len, response);
 
     tcp_send_data(tcb, (uint8_t *)response, offset);
 
     tcp_close(tcb);
-}
\ No newline at end of file
+    return len;
+}
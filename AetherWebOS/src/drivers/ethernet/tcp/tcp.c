@@ -3,8 +3,11 @@
 
 #include "drivers/ethernet/tcp/tcp.h"
 #include "drivers/ethernet/tcp/tcp_internal.h"
+#include "drivers/ethernet/socket.h"
 #include "kernel/memory.h"
+#include "kernel/atomic.h"
 #include "drivers/uart.h"
+#include "kernel/klog.h"
 #include "kernel/timer.h" // For ISN generation
 
 /* ============================================================
@@ -12,6 +15,8 @@
  * ============================================================ */
 
 tcp_tcb_t *tcp_tcb_list = NULL;
+mcs_lock_t tcp_tcb_lock;
+volatile uint32_t tcp_global_isn;
 
 /* * aether_ip must be Host Order as defined in kernel.c 
  */
@@ -32,7 +37,7 @@ static uint32_t tcp_generate_isn(void) {
 tcp_tcb_t *tcp_allocate_tcb(void) {
     tcp_tcb_t *tcb = (tcp_tcb_t *)kmalloc(sizeof(tcp_tcb_t));
     if (!tcb) {
-        uart_debugps("[TCP] FATAL: TCB allocation failed\n");
+        klog_err(KLOG_SUB_TCP, "TCB allocation failed");
         return NULL;
     }
 
@@ -43,32 +48,54 @@ tcp_tcb_t *tcp_allocate_tcb(void) {
     tcb->rcv_wnd = TCP_DEFAULT_WINDOW; // Usually 4096-8192
     tcb->snd_wnd = TCP_DEFAULT_WINDOW;
     tcb->local_ip = aether_ip;
+    tcb->refcnt = 2;    /* The list's and the caller's */
 
     /* Link into the global connection list */
+    struct mcs_node node;
+    uint64_t flags = mcs_lock_irqsave(&tcp_tcb_lock, &node);
     tcb->next = tcp_tcb_list;
     tcp_tcb_list = tcb;
+    mcs_unlock_irqrestore(&tcp_tcb_lock, &node, flags);
 
     return tcb;
 }
 
+void tcp_tcb_put(tcp_tcb_t *tcb) {
+    if (!tcb) return;
+
+    /* Last one out frees it: another core may still be processing a segment */
+    if (atomic32_fetch_add(&tcb->refcnt, (uint32_t)-1) == 1) {
+        klog_debug(KLOG_SUB_TCP, "TCB for port %u purged", tcb->remote_port);
+        kfree(tcb);
+    }
+}
+
 void tcp_remove_tcb(tcp_tcb_t *tcb) {
     if (!tcb) return;
 
     tcp_tcb_t *prev = NULL;
+    struct mcs_node node;
+    uint64_t flags = mcs_lock_irqsave(&tcp_tcb_lock, &node);
     tcp_tcb_t *cur = tcp_tcb_list;
 
     while (cur) {
         if (cur == tcb) {
             if (prev) prev->next = cur->next;
             else tcp_tcb_list = cur->next;
+            mcs_unlock_irqrestore(&tcp_tcb_lock, &node, flags);
 
-            kfree(cur);
-            uart_debugps("[TCP] TCB purged from memory\n");
+            /* Wake a blocked reader/writer before the TCB goes away */
+            if (cur->context)
+                socket_notify(cur, SOCK_EV_CLOSED);
+
+            tcp_tcb_put(cur);     /* The list's reference */
             return;
         }
         prev = cur;
         cur = cur->next;
     }
+
+    mcs_unlock_irqrestore(&tcp_tcb_lock, &node, flags);
 }
 
 /**
@@ -77,6 +104,8 @@ void tcp_remove_tcb(tcp_tcb_t *tcb) {
  */
 tcp_tcb_t *tcp_find_tcb(uint32_t src_ip, uint16_t src_port, 
                         uint32_t dst_ip, uint16_t dst_port) {
+    struct mcs_node node;
+    uint64_t flags = mcs_lock_irqsave(&tcp_tcb_lock, &node);
     tcp_tcb_t *cur = tcp_tcb_list;
 
     while (cur) {
@@ -85,11 +114,39 @@ tcp_tcb_t *tcp_find_tcb(uint32_t src_ip, uint16_t src_port,
             cur->local_ip    == dst_ip   &&
             cur->local_port  == dst_port) 
         {
-            return cur;
+            /* Pin it: a close on another core must not free it under us */
+            atomic32_fetch_add(&cur->refcnt, 1);
+            break;
         }
         cur = cur->next;
     }
-    return NULL;
+
+    mcs_unlock_irqrestore(&tcp_tcb_lock, &node, flags);
+    return cur;
+}
+
+void tcp_set_context(tcp_tcb_t *tcb, void *ctx) {
+    tcb->context = ctx;
+}
+
+void *tcp_get_context(tcp_tcb_t *tcb) {
+    return tcb->context;
+}
+
+uint32_t tcp_send_space(tcp_tcb_t *tcb) {
+    if (tcb->state != TCP_STATE_ESTABLISHED && tcb->state != TCP_STATE_CLOSE_WAIT)
+        return 0;
+
+    uint32_t in_flight = tcb->snd_nxt - tcb->snd_una;
+    return in_flight < tcb->snd_wnd ? tcb->snd_wnd - in_flight : 0;
+}
+
+void tcp_set_rcv_window(tcp_tcb_t *tcb, uint16_t wnd) {
+    uint16_t was = tcb->rcv_wnd;
+
+    tcb->rcv_wnd = wnd;
+    if (was < TCP_MSS && wnd >= TCP_MSS && tcb->state == TCP_STATE_ESTABLISHED)
+        tcp_send_ack(tcb);
 }
 
 /* ============================================================
@@ -97,8 +154,10 @@ tcp_tcb_t *tcp_find_tcb(uint32_t src_ip, uint16_t src_port,
  * ============================================================ */
 
 void tcp_send_data(tcp_tcb_t *tcb, const uint8_t *data, uint16_t len) {
-    if (!tcb || tcb->state != TCP_STATE_ESTABLISHED) {
-        uart_debugps("[TCP] Send failed: Connection not ESTABLISHED\n");
+    /* CLOSE_WAIT: the peer is done sending but still reads our response */
+    if (!tcb || (tcb->state != TCP_STATE_ESTABLISHED &&
+                 tcb->state != TCP_STATE_CLOSE_WAIT)) {
+        klog_warn(KLOG_SUB_TCP, "send failed: connection not ESTABLISHED");
         return;
     }
 
@@ -113,11 +172,13 @@ void tcp_close(tcp_tcb_t *tcb) {
     if (tcb->state == TCP_STATE_ESTABLISHED || tcb->state == TCP_STATE_CLOSE_WAIT) {
         tcb->state = TCP_STATE_LAST_ACK;
         tcp_send_fin(tcb);
-        uart_debugps("[TCP] Active close -> LAST_ACK\n");
+        klog_debug(KLOG_SUB_TCP, "active close %I:%u -> LAST_ACK",
+                   tcb->remote_ip, tcb->remote_port);
     }
 }
 
 void tcp_init(void) {
+    mcs_lock_init(&tcp_tcb_lock, "tcp_tcb");
     tcp_tcb_list = NULL;
-    uart_debugps("[TCP] Core Stack Ready\n");
+    klog_info(KLOG_SUB_TCP, "core stack ready");
 }
\ No newline at end of file
@@ -35,10 +35,10 @@ static uint16_t checksum_finalize(uint32_t sum) {
 }
 
 /**
- * Computes the TCP Checksum including the mandatory IPv4 Pseudo-Header.
+ * IPv4 Pseudo-Header sum as an unfolded 32-bit accumulator; the caller
+ * folds it with checksum_finalize().
  */
-uint16_t tcp_compute_checksum(uint32_t src_ip, uint32_t dst_ip, 
-                               const uint8_t *segment, uint16_t tcp_len) {
+static uint32_t pseudo_header_accumulate(uint32_t src_ip, uint32_t dst_ip, uint16_t tcp_len) {
     uint32_t sum = 0;
 
     /* 1. Pseudo-Header: Source and Destination IPs 
@@ -53,6 +53,16 @@ uint16_t tcp_compute_checksum(uint32_t src_ip, uint32_t dst_ip,
     sum += (uint32_t)htons(IP_PROTO_TCP);
     sum += (uint32_t)htons(tcp_len);
 
+    return sum;
+}
+
+/**
+ * Computes the TCP Checksum including the mandatory IPv4 Pseudo-Header.
+ */
+uint16_t tcp_compute_checksum(uint32_t src_ip, uint32_t dst_ip, 
+                               const uint8_t *segment, uint16_t tcp_len) {
+    uint32_t sum = pseudo_header_accumulate(src_ip, dst_ip, tcp_len);
+
     /* 3. TCP Header + Payload */
     sum += checksum_accumulate(segment, tcp_len);
 
@@ -60,6 +70,14 @@ uint16_t tcp_compute_checksum(uint32_t src_ip, uint32_t dst_ip,
     return checksum_finalize(sum);
 }
 
+/**
+ * Seed for checksum offload: the device sums the segment on top of it
+ * and stores the inverted result, so it goes in uninverted.
+ */
+uint16_t tcp_pseudo_checksum(uint32_t src_ip, uint32_t dst_ip, uint16_t tcp_len) {
+    return (uint16_t)~checksum_finalize(pseudo_header_accumulate(src_ip, dst_ip, tcp_len));
+}
+
 /**
  * Validates an incoming TCP segment.
  * If the checksum is correct, the result of the accumulation over the 
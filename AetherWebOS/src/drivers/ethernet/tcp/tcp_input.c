@@ -6,6 +6,10 @@
 #include "drivers/ethernet/socket.h"
 #include "kernel/memory.h"
 #include "drivers/uart.h"
+#include "kernel/klog.h"
+#include "kernel/health.h"
+#include "kernel/atomic.h"
+#include "drivers/ethernet/net_meta.h"
 #include "common/utils.h"
 
 /* Externs from ipv4.c/tcp.c */
@@ -14,7 +18,8 @@ extern uint32_t aether_ip;
 /**
  * Main entry point for TCP segments from ipv4.c
  */
-void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t dst_ip) 
+void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t dst_ip,
+                       const struct net_meta *meta)
 {
     if (len < sizeof(tcp_hdr_t)) return;
 
@@ -34,10 +39,16 @@ void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t
     uint8_t *payload = segment + header_len;
     uint16_t payload_len = len - header_len;
 
-    /* 2. Validate Checksum */
-    if (!tcp_validate_checksum(src_ip, dst_ip, segment, len)) {
-        uart_debugps("[TCP] Checksum fail. Dropped.\n");
-        return;
+    /* 2. Validate Checksum (unless the NIC or GRO already did) */
+    if (meta && (meta->flags & NET_META_CSUM_VALID)) {
+        if (!(meta->flags & NET_META_GRO))
+            stat_inc(&global_net_stats.csum_rx_offload);
+    } else {
+        stat_inc(&global_net_stats.csum_rx_sw);
+        if (!tcp_validate_checksum(src_ip, dst_ip, segment, len)) {
+            klog_warn(KLOG_SUB_TCP, "bad checksum from %I:%u, dropped", src_ip, src_port);
+            return;
+        }
     }
 
     /* 3. TCB Lookup (4-tuple) */
@@ -46,7 +57,7 @@ void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t
     /* 4. Handle Passive Open (LISTEN state logic) */
     if (!tcb) {
         if ((flags & TCP_FLAG_SYN) && dst_port == 80) {
-            uart_debugps("[TCP] New connection request (SYN)\n");
+            klog_debug(KLOG_SUB_TCP, "SYN from %I:%u", src_ip, src_port);
             
             tcb = tcp_allocate_tcb();
             if (!tcb) return;
@@ -58,12 +69,15 @@ void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t
 
             /* Initialize sequence numbers */
             tcb->rcv_nxt = seg_seq + 1;
-            tcb->snd_una = tcp_global_isn;
-            tcb->snd_nxt = tcp_global_isn;
-            tcp_global_isn += 1000; // Increment for next connection
+            /* SYNs arrive on every RX core */
+            uint32_t isn = atomic32_fetch_add(&tcp_global_isn, 1000);
+
+            tcb->snd_una = isn;
+            tcb->snd_nxt = isn;
 
             tcb->state = TCP_STATE_SYN_RECEIVED;
             tcp_send_synack(tcb);
+            tcp_tcb_put(tcb);
         } else {
             /* No TCB and not a SYN? Send RST to tell the host to go away */
             tcp_send_rst(dst_ip, src_ip, dst_port, src_port, seg_ack, 0);
@@ -77,20 +91,37 @@ void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t
         case TCP_STATE_SYN_RECEIVED:
             if (flags & TCP_FLAG_ACK) {
                 tcb->snd_una = seg_ack;
+                tcb->snd_wnd = ntohs(hdr->window);
                 tcb->state = TCP_STATE_ESTABLISHED;
-                uart_debugps("[TCP] 3-way handshake complete.\n");
+                klog_debug(KLOG_SUB_TCP, "ESTABLISHED %I:%u", tcb->remote_ip, tcb->remote_port);
             }
             break;
 
         case TCP_STATE_ESTABLISHED:
+        case TCP_STATE_CLOSE_WAIT:
+            /* Peer acknowledged new data: open our send window */
+            if ((flags & TCP_FLAG_ACK) &&
+                (int32_t)(seg_ack - tcb->snd_una) > 0 &&
+                (int32_t)(seg_ack - tcb->snd_nxt) <= 0) {
+                tcb->snd_una = seg_ack;
+                tcb->snd_wnd = ntohs(hdr->window);
+                if (tcb->context)
+                    socket_notify(tcb, SOCK_EV_ACKED);
+            }
+
+            if (tcb->state == TCP_STATE_CLOSE_WAIT)
+                break;
+
             /* Data handling */
             if (payload_len > 0) {
                 // Check if segment is in-window (very basic check)
                 if (seg_seq == tcb->rcv_nxt) {
                     tcb->rcv_nxt += payload_len;
                     
-                    /* Bridge to HTTP layer (socket.c) */
-                    socket_dispatch(tcb, payload, payload_len);
+                    /* Bridge to HTTP layer (socket.c); what it could not
+                       take stays unacknowledged for the peer to resend */
+                    uint16_t taken = socket_dispatch(tcb, payload, payload_len);
+                    tcb->rcv_nxt -= payload_len - taken;
                     
                     /* Note: socket_dispatch should ideally trigger the ACK, 
                        but we do it here for reliability if it doesn't. */
@@ -104,14 +135,16 @@ void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t
                 tcp_send_ack(tcb);
                 tcb->state = TCP_STATE_CLOSE_WAIT;
                 
-                /* In our simple WebServer, we just close back immediately */
-                tcp_close(tcb);
+                /* A socket owner closes once it has answered; otherwise
+                   we just close back immediately */
+                if (!tcb->context || !socket_notify(tcb, SOCK_EV_FIN))
+                    tcp_close(tcb);
             }
             break;
 
         case TCP_STATE_LAST_ACK:
             if (flags & TCP_FLAG_ACK) {
-                uart_debugps("[TCP] Connection closed gracefully.\n");
+                klog_debug(KLOG_SUB_TCP, "closed %I:%u", tcb->remote_ip, tcb->remote_port);
                 tcb->state = TCP_STATE_CLOSED;
                 tcp_remove_tcb(tcb);
             }
@@ -124,4 +157,7 @@ void tcp_input_process(uint8_t *segment, uint16_t len, uint32_t src_ip, uint32_t
             }
             break;
     }
+
+    /* The lookup's reference: frees it here if it was removed meanwhile */
+    tcp_tcb_put(tcb);
 }
\ No newline at end of file
@@ -4,26 +4,77 @@
 #include "drivers/ethernet/tcp/tcp.h"
 #include "drivers/ethernet/tcp/tcp_internal.h"
 #include "drivers/uart.h"
+#include "kernel/klog.h"
 #include "kernel/memory.h"
+#include "kernel/dma.h"
 #include "common/utils.h"
 
-/* External IPv4 delivery */
-extern void ipv4_send(uint32_t dst_ip, uint8_t protocol, const uint8_t *data, uint32_t length);
+#include "drivers/ethernet/net_meta.h"
+#include "drivers/ethernet/netbuf.h"
+#include "kernel/health.h"
+#include "kernel/atomic.h"
+
+/* From ethernet.c (its header clashes with utils.h byte-order helpers) */
+extern int ethernet_tx_csum_offload(void);
+extern int ethernet_tx_tso(void);
+extern void ethernet_tx_batch_begin(void);
+extern void ethernet_tx_batch_end(void);
+
+/* ============================================================
+ * CHECKSUM
+ * ============================================================ */
+
+/**
+ * Fills in @hdr's checksum for a @len byte segment, or leaves it to the
+ * NIC: then the field holds the pseudo-header seed and @meta asks the
+ * device to finish it.
+ */
+static void tcp_fill_checksum(tcp_hdr_t *hdr, uint32_t src_ip, uint32_t dst_ip,
+                              uint16_t len, struct net_meta *meta)
+{
+    meta->flags = 0;
+    meta->gso_size = 0;
+    meta->hdr_len = 0;
+    hdr->checksum = 0;
+
+    if (ethernet_tx_csum_offload()) {
+        meta->flags = NET_META_CSUM_PARTIAL;
+        meta->csum_start = 0;
+        meta->csum_offset = offsetof(tcp_hdr_t, checksum);
+        hdr->checksum = tcp_pseudo_checksum(src_ip, dst_ip, len);
+        stat_inc(&global_net_stats.csum_tx_offload);
+        return;
+    }
+
+    hdr->checksum = tcp_compute_checksum(src_ip, dst_ip, (const uint8_t *)hdr, len);
+    stat_inc(&global_net_stats.csum_tx_sw);
+}
 
 /* ============================================================
  * CORE SEGMENT BUILDER
  * ============================================================ */
 
 void tcp_send_segment(tcp_tcb_t *tcb, uint8_t flags, const uint8_t *payload, uint16_t payload_len)
+{
+    tcp_send_segment_gso(tcb, flags, payload, payload_len, 0);
+}
+
+/**
+ * Builds one segment; with @gso_size the NIC (HOST_TSO4) cuts its
+ * payload into @gso_size pieces, copying the header into each and
+ * fixing up sequence numbers, lengths and checksums.
+ */
+void tcp_send_segment_gso(tcp_tcb_t *tcb, uint8_t flags, const uint8_t *payload,
+                          uint16_t payload_len, uint16_t gso_size)
 {
     if (!tcb) return;
 
     uint16_t total_len = sizeof(tcp_hdr_t) + payload_len;
 
-    /* 1. Allocate buffer for the full segment (Header + Data) */
-    uint8_t *buffer = (uint8_t *)kmalloc(total_len);
+    /* 1. Allocate buffer for the full segment (Header + Data), device-visible */
+    uint8_t *buffer = (uint8_t *)dma_alloc(total_len, DMA_STREAMING);
     if (!buffer) {
-        uart_debugps("[TCP] TX FATAL: kmalloc failed\n");
+        klog_err(KLOG_SUB_TCP, "TX dma_alloc(%u) failed", total_len);
         return;
     }
 
@@ -51,11 +102,24 @@ void tcp_send_segment(tcp_tcb_t *tcb, uint8_t flags, const uint8_t *payload, uin
         memcpy(buffer + sizeof(tcp_hdr_t), payload, payload_len);
     }
 
-    /* 4. Compute Checksum (Requires Pseudo-Header) */
-    hdr->checksum = tcp_compute_checksum(tcb->local_ip, tcb->remote_ip, buffer, total_len);
+    /* 4. Compute Checksum (Requires Pseudo-Header), here or on the NIC */
+    struct net_meta meta;
+    tcp_fill_checksum(hdr, tcb->local_ip, tcb->remote_ip, total_len, &meta);
 
-    /* 5. Handover to IPv4 Layer */
-    ipv4_send(tcb->remote_ip, IP_PROTO_TCP, buffer, total_len);
+    if (gso_size && payload_len > gso_size) {
+        meta.flags |= NET_META_GSO_TCPV4;
+        meta.gso_size = gso_size;
+        meta.hdr_len = sizeof(tcp_hdr_t);
+    }
+
+    /*
+     * 5. Handover to IPv4 Layer: the segment itself becomes a TX fragment
+     * and the buffer is no longer ours. net_tx_reaper() dma_free()s it once
+     * the device is done; ipv4_send_frags() and ethernet_send_frags() do
+     * so themselves on every path that cannot queue it.
+     */
+    struct netbuf seg = { buffer, total_len, NULL };
+    ipv4_send_frags(tcb->remote_ip, IP_PROTO_TCP, &seg, &meta);
 
     /* 6. Update Sequence Space 
        SYN and FIN occupy 1 byte of sequence space each. */
@@ -63,9 +127,53 @@ void tcp_send_segment(tcp_tcb_t *tcb, uint8_t flags, const uint8_t *payload, uin
         tcb->snd_nxt += 1;
     }
     tcb->snd_nxt += payload_len;
+}
+
+/* ============================================================
+ * BULK DATA
+ * ============================================================ */
+
+/**
+ * Queues as much of @data as the peer's window takes. With TSO each
+ * segment handed down carries up to TCP_TSO_MAX bytes, one header build,
+ * one (partial) checksum and one descriptor for up to 46 wire frames;
+ * without it the same data goes out as TCP_MSS frames built here.
+ */
+uint32_t tcp_send_bulk(tcp_tcb_t *tcb, const uint8_t *data, uint32_t len)
+{
+    uint32_t seg_max = (ethernet_tx_csum_offload() && ethernet_tx_tso()) ? TCP_TSO_MAX : TCP_MSS;
+    uint32_t sent = 0;
+
+    if (!tcb)
+        return 0;
+
+    /* One doorbell for the burst */
+    ethernet_tx_batch_begin();
+
+    while (sent < len) {
+        uint32_t space = tcp_send_space(tcb);
+        if (!space)
+            break;
+
+        uint32_t chunk = len - sent;
+        if (chunk > space)
+            chunk = space;
+        if (chunk > seg_max)
+            chunk = seg_max;
+
+        if (chunk > TCP_MSS) {
+            tcp_send_segment_gso(tcb, TCP_FLAG_PSH | TCP_FLAG_ACK, data + sent, chunk, TCP_MSS);
+            stat_inc(&global_net_stats.tso_sends);
+            stat_add(&global_net_stats.tso_frames, (chunk + TCP_MSS - 1) / TCP_MSS);
+        } else {
+            tcp_send_segment(tcb, TCP_FLAG_PSH | TCP_FLAG_ACK, data + sent, chunk);
+        }
+
+        sent += chunk;
+    }
 
-    /* Note: buffer is freed by net_tx_reaper in virtio_net.c 
-       Do NOT kfree(buffer) here. */
+    ethernet_tx_batch_end();
+    return sent;
 }
 
 /* ============================================================
@@ -100,7 +208,8 @@ void tcp_send_rst(uint32_t src_ip, uint32_t dst_ip, uint16_t src_port, uint16_t
     hdr.flags = TCP_FLAG_RST | TCP_FLAG_ACK;
     hdr.window = 0;
 
-    hdr.checksum = tcp_compute_checksum(src_ip, dst_ip, (uint8_t*)&hdr, sizeof(tcp_hdr_t));
+    struct net_meta meta;
+    tcp_fill_checksum(&hdr, src_ip, dst_ip, sizeof(tcp_hdr_t), &meta);
 
-    ipv4_send(dst_ip, IP_PROTO_TCP, (uint8_t*)&hdr, sizeof(tcp_hdr_t));
+    ipv4_send_meta(dst_ip, IP_PROTO_TCP, (uint8_t*)&hdr, sizeof(tcp_hdr_t), &meta);
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include "drivers/virtio/virtio_pci.h"
 #include "drivers/usb/xhci.h"
 #include "common/io.h"
+#include "kernel/memory.h"
+#include "kernel/its.h"
+#include "kernel/klog.h"
 #include <stddef.h>
 
 // 1. Linker Fix: The Global Device Tracker
@@ -113,4 +116,149 @@ void pcie_init() {
         pcie_probe_device(0, dev, 0);
     }
     uart_puts("[OK] PCIe Enumeration Complete.\r\n");
-}
\ No newline at end of file
+}
+
+/* =====================================================
+   Capabilities & BARs
+   ===================================================== */
+
+uint8_t pci_find_capability(uint32_t bus, uint32_t dev, uint32_t func, uint8_t cap_id) {
+    // Status bit 4: capability list present
+    if (!((pcie_read_config(bus, dev, func, 0x04) >> 16) & (1 << 4)))
+        return 0;
+
+    uint8_t ptr = pcie_read_config(bus, dev, func, 0x34) & 0xFC;
+    int guard = 48;                     // Malformed lists must not loop forever
+
+    while (ptr && guard--) {
+        uint32_t hdr = pcie_read_config(bus, dev, func, ptr);
+        if ((hdr & 0xFF) == cap_id)
+            return ptr;
+        ptr = (hdr >> 8) & 0xFC;
+    }
+    return 0;
+}
+
+uint64_t pci_bar_address(uint32_t bus, uint32_t dev, uint32_t func, uint32_t bar) {
+    uint32_t off = 0x10 + bar * 4;
+    uint32_t lo = pcie_read_config(bus, dev, func, off);
+
+    if (lo & 0x1)                       // I/O BAR
+        return 0;
+
+    int is64 = (lo & 0x6) == 0x4;
+    uint64_t addr = lo & ~0xFULL;
+
+    if (is64)
+        addr |= (uint64_t)pcie_read_config(bus, dev, func, off + 4) << 32;
+
+    if (addr)
+        return addr;
+
+    // Unassigned: size it (write all-ones, read back the mask), then place it
+    pcie_write_config(bus, dev, func, off, 0xFFFFFFFF);
+    uint32_t mask = pcie_read_config(bus, dev, func, off) & ~0xFU;
+    pcie_write_config(bus, dev, func, off, lo);
+
+    if (!mask)
+        return 0;
+
+    uint32_t size = ~mask + 1;
+    uint32_t align = size > 0x100000 ? size : 0x100000;
+    next_pci_mem_addr = (next_pci_mem_addr + align - 1) & ~(align - 1);
+
+    addr = next_pci_mem_addr;
+    next_pci_mem_addr += align;
+
+    pcie_write_config(bus, dev, func, off, (uint32_t)addr | (lo & 0xF));
+    if (is64)
+        pcie_write_config(bus, dev, func, off + 4, 0);
+
+    uart_puts("    [PCI] Assigned ");
+    uart_put_hex(addr);
+    uart_puts(" to BAR ");
+    uart_put_int(bar);
+    uart_puts("\r\n");
+
+    return addr;
+}
+
+/* =====================================================
+   MSI-X
+   ===================================================== */
+
+#define MSIX_CTRL_ENABLE      (1u << 15)
+#define MSIX_CTRL_FUNC_MASK   (1u << 14)
+#define MSIX_ENTRY_MASKED     (1u << 0)
+#define PCI_CMD_INTX_DISABLE  (1u << 10)
+
+int pci_msix_init(struct pci_msix *m, uint32_t bus, uint32_t dev, uint32_t func) {
+    m->bus = bus; m->dev = dev; m->func = func;
+    m->table = NULL;
+    m->nvec = 0;
+
+    if (!its_present())
+        return -1;
+
+    m->cap = pci_find_capability(bus, dev, func, PCI_CAP_ID_MSIX);
+    if (!m->cap)
+        return -1;
+
+    uint32_t ctrl = pcie_read_config(bus, dev, func, m->cap) >> 16;
+    uint32_t tbl  = pcie_read_config(bus, dev, func, m->cap + 4);
+    uint64_t bar  = pci_bar_address(bus, dev, func, tbl & 0x7);
+
+    if (!bar)
+        return -1;
+
+    m->nvec  = (ctrl & 0x7FF) + 1;
+    m->table = (volatile uint32_t *)ioremap(bar + (tbl & ~0x7U), m->nvec * 16);
+    if (!m->table)
+        return -1;
+
+    for (uint16_t v = 0; v < m->nvec; v++)
+        m->table[v * 4 + 3] = MSIX_ENTRY_MASKED;
+
+    klog_info(KLOG_SUB_PCIE, "%u:%u.%u MSI-X, %u vectors", bus, dev, func, m->nvec);
+    return 0;
+}
+
+int pci_msix_request(struct pci_msix *m, uint16_t vec, uint32_t cpu,
+                     irq_handler_t handler, irq_bh_t bh, void *ctx, const char *name) {
+    if (!m->table || vec >= m->nvec)
+        return -1;
+
+    uint32_t devid = ((m->bus & 0xFF) << 8) | ((m->dev & 0x1F) << 3) | (m->func & 0x7);
+    int lpi = its_map_event(devid, vec, cpu);
+    if (lpi < 0)
+        return -1;
+
+    if (request_irq(lpi, handler, bh, ctx, name, 0xA0, IRQF_EDGE) < 0)
+        return -1;
+
+    uint64_t addr = its_doorbell();
+    volatile uint32_t *entry = m->table + vec * 4;
+
+    entry[0] = (uint32_t)addr;
+    entry[1] = (uint32_t)(addr >> 32);
+    entry[2] = vec;                     // EventID
+    entry[3] = 0;                       // Unmask
+    return lpi;
+}
+
+void pci_msix_mask(struct pci_msix *m, uint16_t vec, int masked) {
+    if (m->table && vec < m->nvec)
+        m->table[vec * 4 + 3] = masked ? MSIX_ENTRY_MASKED : 0;
+}
+
+void pci_msix_enable(struct pci_msix *m) {
+    if (!m->table)
+        return;
+
+    uint32_t hdr = pcie_read_config(m->bus, m->dev, m->func, m->cap);
+    uint32_t ctrl = ((hdr >> 16) | MSIX_CTRL_ENABLE) & ~MSIX_CTRL_FUNC_MASK;
+    pcie_write_config(m->bus, m->dev, m->func, m->cap, (hdr & 0xFFFF) | (ctrl << 16));
+
+    uint32_t cmd = pcie_read_config(m->bus, m->dev, m->func, 0x04) & 0xFFFF;
+    pcie_write_config(m->bus, m->dev, m->func, 0x04, cmd | PCI_CMD_INTX_DISABLE);
+}
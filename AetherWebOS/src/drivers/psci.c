@@ -34,4 +34,9 @@ void psci_system_reset(void) {
     psci_call(PSCI_SYSTEM_RESET, 0, 0, 0);
     
     while(1) { asm volatile("wfi"); }
-}
\ No newline at end of file
+}
+
+int psci_cpu_on(uint64_t target_mpidr, uint64_t entry, uint64_t context_id) {
+    /* PSCI return codes are 32-bit signed in w0 */
+    return (int)psci_call(PSCI_CPU_ON, target_mpidr, entry, context_id);
+}
@@ -1,8 +1,26 @@
 #include "utils.h"
 #include "timer.h"
+#include "kernel/hrtimer.h"
+#include "kernel/irq.h"
+#include "kernel/gic.h"
 
 static uint64_t _timer_freq;
-static volatile uint64_t _uptime_ms = 0;
+static uint64_t _boot_cycles;
+
+/*
+ * Fixed-point conversion factors, computed once in timer_init():
+ *   ns     = (cycles * _ns_mult)  >> 32
+ *   cycles = (ns     * _cyc_mult) >> 32
+ */
+static uint64_t _ns_mult;
+static uint64_t _cyc_mult;
+
+#define TIMER_SHIFT   32
+
+static irqreturn_t timer_irq(uint32_t irq, void *ctx);
+
+#define CNTP_CTL_ENABLE   (1UL << 0)
+#define CNTP_CTL_IMASK    (1UL << 1)
 
 static uint64_t get_timer_freq() {
     uint64_t val;
@@ -10,28 +28,84 @@ static uint64_t get_timer_freq() {
     return val;
 }
 
+/* =====================================================
+   Monotonic Clock
+   ===================================================== */
+
+uint64_t timer_read_counter(void) {
+    uint64_t val;
+    /* ISB keeps the counter read from being hoisted above earlier code */
+    asm volatile ("isb; mrs %0, cntpct_el0" : "=r" (val) :: "memory");
+    return val;
+}
+
+uint64_t timer_cycles_to_ns(uint64_t cycles) {
+    return (uint64_t)(((__uint128_t)cycles * _ns_mult) >> TIMER_SHIFT);
+}
+
+uint64_t timer_ns_to_cycles(uint64_t ns) {
+    return (uint64_t)(((__uint128_t)ns * _cyc_mult) >> TIMER_SHIFT);
+}
+
+uint64_t timer_get_ns(void) {
+    return timer_cycles_to_ns(timer_read_counter() - _boot_cycles);
+}
+
+uint64_t timer_get_freq(void) {
+    return _timer_freq;
+}
+
+uint64_t get_system_uptime_ms() {
+    return timer_get_ns() / NSEC_PER_MSEC;
+}
+
+/* =====================================================
+   One-Shot Comparator
+   ===================================================== */
+
+void timer_program_deadline(uint64_t deadline_ns) {
+    uint64_t cval = _boot_cycles + timer_ns_to_cycles(deadline_ns);
+
+    asm volatile ("msr cntp_cval_el0, %0" : : "r" (cval));
+    asm volatile ("msr cntp_ctl_el0, %0" : : "r" (CNTP_CTL_ENABLE));
+    asm volatile ("isb");
+}
+
+void timer_disarm(void) {
+    /* Keep the counter running, just stop asserting the PPI */
+    asm volatile ("msr cntp_ctl_el0, %0" : : "r" (CNTP_CTL_ENABLE | CNTP_CTL_IMASK));
+    asm volatile ("isb");
+}
+
 void timer_init() {
     _timer_freq = get_timer_freq();
-    
-    // Set for 10ms (Frequency / 100)
-    uint64_t interval = _timer_freq / 100;
-    asm volatile ("msr cntp_tval_el0, %0" : : "r" (interval));
+    _boot_cycles = timer_read_counter();
+
+    _ns_mult  = (NSEC_PER_SEC << TIMER_SHIFT) / _timer_freq;
+    _cyc_mult = (_timer_freq << TIMER_SHIFT) / NSEC_PER_SEC;
 
-    // Enable=1, Unmask=0
-    asm volatile ("msr cntp_ctl_el0, %0" : : "r" (1));
+    timer_init_this_cpu();
+
+    /* Banked PPI: irq_cpu_init() enables it on the secondaries */
+    request_irq(TIMER_IRQ_ID, timer_irq, 0, 0, "timer", 0xA0, IRQF_EDGE | IRQF_PERCPU);
 }
 
-void handle_timer_irq() {
-    // 1. Increment global uptime
-    _uptime_ms += 10; 
+/**
+ * timer_init_this_cpu: The CNTP comparator is banked per core; every
+ * core starts with it masked and its own empty hrtimer queue.
+ */
+void timer_init_this_cpu(void) {
+    /* No periodic tick: the comparator is only armed for hrtimers */
+    timer_disarm();
+    hrtimer_init_subsystem();
+}
 
-    // 2. RELOAD: If you miss this, the timer never fires again!
-    // Set for another 10ms (assuming 100Hz)
-    uint64_t frq;
-    asm volatile ("mrs %0, cntfrq_el0" : "=r" (frq));
-    asm volatile ("msr cntp_tval_el0, %0" : : "r" (frq / 100)); 
+void handle_timer_irq() {
+    hrtimer_run_expired();
 }
 
-uint64_t get_system_uptime_ms() {
-    return _uptime_ms;
-}
\ No newline at end of file
+static irqreturn_t timer_irq(uint32_t irq, void *ctx) {
+    (void)irq; (void)ctx;
+    handle_timer_irq();
+    return IRQ_HANDLED;
+}
@@ -1,9 +1,38 @@
 #include "uart.h"
 #include "config.h"
 #include "kernel/mode.h"
+#include "kernel/gic.h"
+#include "kernel/irq.h"
+#include "kernel/irqflags.h"
+#include "kernel/spinlock.h"
 
 #include <stdint.h>
 
+/* =====================================
+    Buffered Console State
+    ===================================== */
+
+/*
+ * TX ring: filled by uart_putc() from any context and any core under
+ * uart_tx_lock (so one uart_puts() string is never split by another
+ * core's), drained by the TX-FIFO interrupt.
+ * RX ring: filled by the RX interrupt, drained by uart_getc().
+ */
+static uint8_t tx_ring[UART_TX_RING_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+
+static uint8_t rx_ring[UART_RX_RING_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+/* 0 until uart_irq_init(): early boot and panics write synchronously */
+static volatile int uart_irq_mode = 0;
+static int tx_irq_enabled = 0;
+static spinlock_t uart_tx_lock;
+
+static uart_stats_t uart_stats;
+
 /* =====================================
     Small Delay (Required for RPi4 GPIO)
     ===================================== */
@@ -60,36 +89,103 @@ int uart_is_writable(void)
     Transmission Helpers
     ===================================== */
 
-void uart_putc(unsigned char c)
+static void uart_putc_sync(unsigned char c)
 {
     while (!uart_is_writable()); // Wait until TX FIFO has space
     *UART0_DR = c;
 }
 
+/**
+ * uart_tx_fill: Moves bytes from the TX ring into the hardware FIFO
+ * until either runs out. Masks the TX interrupt once the ring is empty.
+ * Caller holds uart_tx_lock.
+ */
+static void uart_tx_fill(void)
+{
+    while (tx_tail != tx_head && uart_is_writable()) {
+        *UART0_DR = tx_ring[tx_tail & (UART_TX_RING_SIZE - 1)];
+        tx_tail++;
+        uart_stats.tx_bytes++;
+    }
+
+    /* Only touch IMSC when the TX interrupt actually changes state */
+    int want = (tx_tail != tx_head);
+    if (want != tx_irq_enabled) {
+        if (want)
+            *UART0_IMSC |= UART_INT_TX;
+        else
+            *UART0_IMSC &= ~UART_INT_TX;
+        tx_irq_enabled = want;
+    }
+}
+
+/* Caller holds uart_tx_lock */
+static void uart_tx_push(unsigned char c)
+{
+    /* Fast path: nothing queued and the FIFO has room */
+    if (tx_tail == tx_head && uart_is_writable()) {
+        *UART0_DR = c;
+        uart_stats.tx_bytes++;
+        return;
+    }
+
+    if (tx_head - tx_tail >= UART_TX_RING_SIZE) {
+        uart_stats.tx_dropped++;
+        return;
+    }
+
+    tx_ring[tx_head & (UART_TX_RING_SIZE - 1)] = c;
+    tx_head++;
+}
+
+void uart_putc(unsigned char c)
+{
+    if (!uart_irq_mode) {
+        uart_putc_sync(c);
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&uart_tx_lock);
+    uart_tx_push(c);
+    uart_tx_fill();
+    spin_unlock_irqrestore(&uart_tx_lock, flags);
+}
+
 void uart_puts(const char *str)
 {
+    if (!uart_irq_mode) {
+        while (*str) {
+            if (*str == '\n')
+                uart_putc_sync('\r');
+            uart_putc_sync(*str++);
+        }
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&uart_tx_lock);
     while (*str) {
         if (*str == '\n')
-            uart_putc('\r');
-        uart_putc(*str++);
+            uart_tx_push('\r');
+        uart_tx_push(*str++);
     }
+    uart_tx_fill();
+    spin_unlock_irqrestore(&uart_tx_lock, flags);
 }
 
 /**
  * uart_put_int: Prints a 32-bit integer as a decimal string.
  */
 void uart_put_int(uint32_t n) {
-    if (n == 0) {
-        uart_putc('0');
-        return;
-    }
     char buf[12];
-    int i = 0;
-    while (n > 0) {
-        buf[i++] = (n % 10) + '0';
+    int i = sizeof(buf) - 1;
+
+    // Built back to front and sent as one string: no other core cuts in
+    buf[i] = '\0';
+    do {
+        buf[--i] = (n % 10) + '0';
         n /= 10;
-    }
-    while (--i >= 0) uart_putc(buf[i]);
+    } while (n > 0);
+    uart_puts(&buf[i]);
 }
 
 /**
@@ -97,10 +193,16 @@ void uart_put_int(uint32_t n) {
  */
 void uart_put_hex(uint64_t n) {
     char *hextab = "0123456789ABCDEF";
-    uart_puts("0x");
+    char buf[19];
+    int pos = 0;
+
+    buf[pos++] = '0';
+    buf[pos++] = 'x';
     for (int i = 60; i >= 0; i -= 4) {
-        uart_putc(hextab[(n >> i) & 0xF]);
+        buf[pos++] = hextab[(n >> i) & 0xF];
     }
+    buf[pos] = '\0';
+    uart_puts(buf);
 }
 
 /* =====================================
@@ -109,15 +211,129 @@ void uart_put_hex(uint64_t n) {
 
 unsigned char uart_getc(void)
 {
+    if (uart_irq_mode) {
+        while (rx_tail == rx_head)
+            asm volatile("wfi");
+
+        unsigned char c = rx_ring[rx_tail & (UART_RX_RING_SIZE - 1)];
+        asm volatile("dmb ish" ::: "memory");
+        rx_tail++;
+        return c;
+    }
+
     // Bit 4 of Flag Register (FR) is RXFE (Receive FIFO Empty)
     while (*UART0_FR & (1 << 4));
     return (unsigned char)(*UART0_DR & 0xFF);
 }
 
 int uart_is_empty() {
+    if (uart_irq_mode)
+        return rx_tail == rx_head;
+
     return (*UART0_FR & (1 << 4));
 }
 
+/* =====================================
+    Interrupt-Driven Mode
+    ===================================== */
+
+static irqreturn_t uart_irq(uint32_t irq, void *ctx)
+{
+    (void)irq; (void)ctx;
+    uart_handle_irq();
+    return IRQ_HANDLED;
+}
+
+/**
+ * uart_irq_init: Switches the console to buffered operation.
+ * Must run after gic_init().
+ */
+void uart_irq_init(void)
+{
+    // Interrupt when TX FIFO <= 1/8 full, RX FIFO >= 1/2 full
+    *UART0_IFLS = (0 << 0) | (2 << 3);
+    *UART0_ICR = 0x7FF;
+    *UART0_IMSC = UART_INT_RX | UART_INT_RT | UART_INT_OE;
+
+    spin_lock_init(&uart_tx_lock, "uart_tx");
+    request_irq(UART0_IRQ_ID, uart_irq, 0, 0, "uart", 0xB0, IRQF_LEVEL);
+
+    uart_irq_mode = 1;
+    uart_puts("[OK] UART: Interrupt-driven console active.\r\n");
+}
+
+void uart_handle_irq(void)
+{
+    uint32_t mis = *UART0_MIS;
+    *UART0_ICR = mis;
+
+    uart_stats.irqs++;
+
+    if (mis & (UART_INT_RX | UART_INT_RT | UART_INT_OE)) {
+        while (!(*UART0_FR & (1 << 4))) {
+            uint32_t dr = *UART0_DR;
+
+            if (dr & (1 << 11))   // OE flag travels with the data word
+                uart_stats.hw_overruns++;
+
+            if (rx_head - rx_tail >= UART_RX_RING_SIZE) {
+                uart_stats.rx_overflows++;
+                continue;
+            }
+
+            rx_ring[rx_head & (UART_RX_RING_SIZE - 1)] = (uint8_t)dr;
+            asm volatile("dmb ish" ::: "memory");
+            rx_head++;
+            uart_stats.rx_bytes++;
+        }
+    }
+
+    if (mis & UART_INT_TX) {
+        spin_lock(&uart_tx_lock);
+        uart_tx_fill();
+        spin_unlock(&uart_tx_lock);
+    }
+}
+
+/**
+ * uart_flush: Busy-waits until everything queued has reached the FIFO.
+ */
+void uart_flush(void)
+{
+    if (!uart_irq_mode)
+        return;
+
+    /* Panic paths may have interrupted the holder: drain regardless */
+    uint64_t flags = local_irq_save();
+    int locked = spin_trylock(&uart_tx_lock);
+
+    while (tx_tail != tx_head) {
+        while (!uart_is_writable());
+        uart_tx_fill();
+    }
+
+    if (locked)
+        spin_unlock(&uart_tx_lock);
+    local_irq_restore(flags);
+}
+
+/**
+ * uart_console_sync: Drains the ring and falls back to polled output.
+ * Used by panic and shutdown paths that run with IRQs masked.
+ */
+void uart_console_sync(void)
+{
+    uart_flush();
+    *UART0_IMSC &= ~UART_INT_TX;
+    tx_irq_enabled = 0;
+    uart_irq_mode = 0;
+}
+
+const uart_stats_t *uart_get_stats(void)
+{
+    return &uart_stats;
+}
+
 void uart_print_hex16(uint16_t val) {
     char hex[] = "0123456789abcdef";
     // Simplified hex printer
@@ -1,6 +1,8 @@
 #include "drivers/usb/xhci.h"
 #include "drivers/pcie.h"
 #include "kernel/memory.h"
+#include "kernel/dma.h"
+#include "kernel/irq.h"
 #include "common/io.h"
 #include "uart.h"
 #include "utils.h"
@@ -14,8 +16,68 @@
 #define XHCI_CAP_CAPLENGTH     0x00
 #define XHCI_CAP_HCIVERSION    0x02
 #define XHCI_CAP_HCCPARAMS1    0x10
+#define XHCI_CAP_HCSPARAMS1    0x04
+#define XHCI_CAP_HCSPARAMS2    0x08
+#define XHCI_CAP_RTSOFF        0x18
 #define XHCI_OP_USBCMD         0x00
 #define XHCI_OP_USBSTS         0x04
+#define XHCI_OP_CRCR           0x18
+#define XHCI_OP_DCBAAP         0x30
+#define XHCI_OP_CONFIG         0x38
+
+// Interrupter 0 (Runtime Registers + 0x20)
+#define XHCI_IR0               0x20
+#define XHCI_IR_IMAN           0x00
+#define XHCI_IR_ERSTSZ         0x08
+#define XHCI_IR_ERSTBA         0x10
+#define XHCI_IR_ERDP           0x18
+
+#define XHCI_STS_EINT          (1 << 3)    // Event Interrupt (RW1C)
+#define XHCI_IMAN_IE           (1 << 1)
+#define XHCI_CRCR_RCS          (1 << 0)    // Ring Cycle State
+
+#define XHCI_TRB_LINK          6
+#define XHCI_TRB_TYPE(t)       ((t) << 10)
+#define XHCI_LINK_TC           (1 << 1)    // Toggle Cycle
+
+#define XHCI_RING_TRBS         (PAGE_SIZE / sizeof(struct xhci_trb))
+
+static struct pci_msix xhci_msix;
+static uintptr_t xhci_op_base;
+
+/*
+ * Controller memory. Everything the controller reads or writes lives in
+ * the coherent DMA arena and is handed over as a bus address.
+ */
+static struct {
+    uint32_t                max_slots;
+    uint64_t               *dcbaa;          // Device Context Base Address Array
+    uint64_t               *scratchpad;     // Scratchpad Buffer Array (DCBAA[0])
+    uint32_t                nr_scratchpad;
+    struct xhci_trb        *cmd_ring;
+    struct xhci_trb        *event_ring;
+    struct xhci_erst_entry *erst;
+} xhci_hc;
+
+static void xhci_write64(uintptr_t addr, uint64_t val) {
+    mmio_write32(addr, (uint32_t)val);
+    mmio_write32(addr + 4, (uint32_t)(val >> 32));
+}
+
+/**
+ * xhci_irq: Interrupter 0 top half. Only acknowledges for now; event
+ * ring processing arrives with the interrupter setup.
+ */
+static irqreturn_t xhci_irq(uint32_t irq, void *ctx) {
+    (void)irq; (void)ctx;
+
+    uint32_t sts = mmio_read32(xhci_op_base + XHCI_OP_USBSTS);
+    if (!(sts & XHCI_STS_EINT))
+        return IRQ_NONE;
+
+    mmio_write32(xhci_op_base + XHCI_OP_USBSTS, XHCI_STS_EINT);
+    return IRQ_HANDLED;
+}
 
 /**
  * xhci_claim_ownership: BIOS -> OS Handshake.
@@ -58,6 +120,71 @@ static void xhci_claim_ownership(uintptr_t base) {
     }
 }
 
+/**
+ * xhci_setup_memory: DCBAA, scratchpad, command ring and the event ring
+ * of interrupter 0, all from the DMA zone. Called on a halted, freshly
+ * reset controller; Run/Stop is left to the enumeration code.
+ */
+static int xhci_setup_memory(uintptr_t base, uintptr_t op_base) {
+    uint32_t hcs1 = mmio_read32(base + XHCI_CAP_HCSPARAMS1);
+    uint32_t hcs2 = mmio_read32(base + XHCI_CAP_HCSPARAMS2);
+
+    xhci_hc.max_slots = hcs1 & 0xFF;
+    xhci_hc.nr_scratchpad = (((hcs2 >> 21) & 0x1F) << 5) | ((hcs2 >> 27) & 0x1F);
+
+    // 1. DCBAA: one entry per slot plus the scratchpad pointer (64-byte aligned)
+    xhci_hc.dcbaa = dma_alloc((xhci_hc.max_slots + 1) * sizeof(uint64_t), DMA_COHERENT | DMA_ZERO);
+    if (!xhci_hc.dcbaa)
+        return -1;
+
+    // 2. Scratchpad: controller-private pages it asked for
+    if (xhci_hc.nr_scratchpad) {
+        xhci_hc.scratchpad = dma_alloc(xhci_hc.nr_scratchpad * sizeof(uint64_t),
+                                       DMA_COHERENT | DMA_ZERO);
+        if (!xhci_hc.scratchpad)
+            return -1;
+
+        for (uint32_t i = 0; i < xhci_hc.nr_scratchpad; i++) {
+            void *page = dma_alloc(PAGE_SIZE, DMA_COHERENT | DMA_ZERO);
+            if (!page)
+                return -1;
+            xhci_hc.scratchpad[i] = dma_to_bus(page);
+        }
+        xhci_hc.dcbaa[0] = dma_to_bus(xhci_hc.scratchpad);
+    }
+
+    // 3. Command ring: one page, closed by a Link TRB back to its start
+    xhci_hc.cmd_ring = dma_alloc(PAGE_SIZE, DMA_COHERENT | DMA_ZERO);
+    if (!xhci_hc.cmd_ring)
+        return -1;
+
+    struct xhci_trb *link = &xhci_hc.cmd_ring[XHCI_RING_TRBS - 1];
+    link->parameter = dma_to_bus(xhci_hc.cmd_ring);
+    link->control = XHCI_TRB_TYPE(XHCI_TRB_LINK) | XHCI_LINK_TC;
+
+    // 4. Event ring: one segment, described by a one-entry ERST
+    xhci_hc.event_ring = dma_alloc(PAGE_SIZE, DMA_COHERENT | DMA_ZERO);
+    xhci_hc.erst = dma_alloc(sizeof(struct xhci_erst_entry), DMA_COHERENT | DMA_ZERO);
+    if (!xhci_hc.event_ring || !xhci_hc.erst)
+        return -1;
+
+    xhci_hc.erst->ring_base = dma_to_bus(xhci_hc.event_ring);
+    xhci_hc.erst->ring_size = XHCI_RING_TRBS;
+
+    // 5. Hand it all over
+    mmio_write32(op_base + XHCI_OP_CONFIG, xhci_hc.max_slots);
+    xhci_write64(op_base + XHCI_OP_DCBAAP, dma_to_bus(xhci_hc.dcbaa));
+    xhci_write64(op_base + XHCI_OP_CRCR, dma_to_bus(xhci_hc.cmd_ring) | XHCI_CRCR_RCS);
+
+    uintptr_t ir0 = base + (mmio_read32(base + XHCI_CAP_RTSOFF) & ~0x1F) + XHCI_IR0;
+    mmio_write32(ir0 + XHCI_IR_ERSTSZ, 1);
+    xhci_write64(ir0 + XHCI_IR_ERDP, dma_to_bus(xhci_hc.event_ring));
+    xhci_write64(ir0 + XHCI_IR_ERSTBA, dma_to_bus(xhci_hc.erst));     // Written last: latches the ERST
+    mmio_write32(ir0 + XHCI_IR_IMAN, XHCI_IMAN_IE);
+
+    return 0;
+}
+
 /**
  * Main xHCI Initializer
  */
@@ -128,5 +255,21 @@ void xhci_init(uint32_t bus, uint32_t dev, uint32_t func) {
         uart_puts("[ERROR] USB: xHCI Controller Reset Timeout!\r\n");
     } else {
         uart_puts("[OK] USB: xHCI Host Controller is READY.\r\n");
+
+        if (xhci_setup_memory(base, op_base) < 0) {
+            uart_puts("[ERROR] USB: Out of DMA memory for xHCI rings.\r\n");
+        } else {
+            uart_puts("[OK] USB: DCBAA, command and event rings in DMA zone (");
+            uart_put_int(xhci_hc.max_slots);
+            uart_puts(" slots).\r\n");
+        }
+    }
+
+    // 5. Interrupter 0 -> MSI-X vector 0 on CPU0
+    xhci_op_base = op_base;
+    if (pci_msix_init(&xhci_msix, bus, dev, func) == 0 &&
+        pci_msix_request(&xhci_msix, 0, 0, xhci_irq, 0, 0, "xhci") >= 0) {
+        pci_msix_enable(&xhci_msix);
+        uart_puts("[OK] USB: MSI-X vector 0 routed through the ITS.\r\n");
     }
 }
\ No newline at end of file
@@ -7,43 +7,136 @@
 #include "uart.h"
 #include "utils.h"
 #include "kernel/memory.h"
+#include "kernel/dma.h"
 #include "kernel/health.h"
+#include "kernel/klog.h"
+#include "kernel/irq.h"
+#include "kernel/sched.h"
+#include "kernel/atomic.h"
+#include "kernel/timer.h"
+#include "kernel/smp.h"
+#include "kernel/its.h"
+#include "drivers/ethernet/rss.h"
+#include "drivers/ethernet/gro.h"
+#include "drivers/ethernet/netbuf.h"
 
 
 
 /* Forward Declarations */
 void virtio_net_setup_queues(struct virtio_pci_device *vdev);
-void virtio_net_poll(struct virtio_pci_device *vdev);
+int virtio_net_poll(struct virtio_pci_device *vdev, int budget);
+
+extern uint8_t aether_mac[6];
 
 
 /* ============================================
    Configuration
    ============================================ */
 
-#define RX_QUEUE_INDEX  0
-#define TX_QUEUE_INDEX  1
+/* Pair N: RX = 2N, TX = 2N + 1; the control queue follows the last pair */
+#define RX_QUEUE_INDEX(p)  ((p) * 2)
+#define TX_QUEUE_INDEX(p)  ((p) * 2 + 1)
 
-#define RX_QUEUE_SIZE   256
+#define RX_QUEUE_SIZE   256         /* Defaults; see virtio_net_set_queues() */
 #define TX_QUEUE_SIZE   256
-#define RX_BUF_SIZE     2048
+#define CTRL_QUEUE_SIZE 64
+#define RX_BUF_SIZE     PAGE_SIZE   /* One pool page per RX descriptor */
 
-/* ============================================
-   Global Queues
-   ============================================ */
+#define RX_FILL_MIN     64          /* Buffers kept posted when traffic is light */
+#define RX_POOL_KEEP    64          /* Returned pages a pool holds on to */
+
+/* Largest mergeable receive: a 64 KB GSO frame plus header, in pages */
+#define RX_MAX_FRAGS    ((65535 + 14 + 12 + RX_BUF_SIZE - 1) / RX_BUF_SIZE)
+
+#define CTRL_SPINS      1000000     /* Control commands complete synchronously */
 
-static struct virtqueue rx_queue;
-static struct virtqueue tx_queue;
+#define VNET_TX_BATCH_MAX  32       /* Held-back TX frames before the doorbell rings anyway */
 
-/* RX Buffers (Aligned for DMA safety) */
-static uint8_t rx_buffers[RX_QUEUE_SIZE][RX_BUF_SIZE]
-__attribute__((aligned(4096)));
+#define BENCH_FRAME_LEN 60          /* Minimum Ethernet frame, without FCS */
+#define BENCH_STALL_NS  1000000000ULL   /* Give up when nothing completes for 1 s */
 
-/* Ring Memory */
-static uint8_t rx_ring_mem[PAGE_SIZE * 4]
-__attribute__((aligned(4096)));
+/* ============================================
+   Queue Pairs
+   ============================================ */
+
+struct vnet_napi {
+    const char        *name;
+    struct virtqueue  *vq;
+    struct vnet_pair  *pair;
+    int              (*poll)(struct vnet_pair *pair, int budget);
+    struct sched_work  work;
+    uint64_t           last_work_ns;
+    vnet_napi_stats_t  stats;
+};
+
+struct vnet_pair {
+    struct virtqueue   rx;
+    struct virtqueue   tx;
+    struct vnet_napi   rx_napi;
+    struct vnet_napi   tx_napi;
+    int                rx_lpi;
+    int                tx_lpi;
+    struct virtio_pci_device *vdev;
 
-static uint8_t tx_ring_mem[PAGE_SIZE * 4]
-__attribute__((aligned(4096)));
+    /*
+     * RX buffers: descriptor i is bound to pool page rx_page[i] for as
+     * long as it is in use, so reposting it is just its id in the ring.
+     * Descriptors beyond the adaptive target give their page back.
+     */
+    struct page_pool   rx_pool;
+    uint8_t          **rx_page;             /* rx.size entries each */
+    uint16_t          *rx_idle;             /* Not with the device */
+    uint16_t           rx_nidle;
+    uint16_t          *rx_done;             /* Used this pass, to repost */
+    uint16_t           rx_ndone;
+    uint16_t           rx_posted;
+    uint16_t           rx_target;
+    unsigned long      tx_frames;           /* Queued through virtio_net_xmit() */
+    unsigned long      tx_doorbells;        /* ... and notifies it took */
+    unsigned long      tx_frags;            /* Buffers those frames were made of */
+    unsigned long      tx_indirect;         /* Frames sent through an indirect table */
+    unsigned long      tx_inflight;         /* Queued, not yet reaped */
+    unsigned long      tx_inflight_peak;
+    uint16_t           tx_slots_peak;       /* Most ring descriptors in use at once */
+
+    /* Indirect tables, one per TX ring slot (device-visible), and the free ones */
+    struct virtq_desc *tx_indir;
+    spinlock_t         tx_indir_lock;
+    uint16_t          *tx_indir_free;
+    uint16_t           tx_indir_nfree;
+    unsigned long      rx_multi;            /* Frames spanning several buffers */
+    unsigned long      rx_errors;           /* Truncated / oversized frames */
+};
+
+static struct vnet_pair vnet_pairs[VNET_MAX_PAIRS];
+static uint16_t vnet_max_pairs = 1;        /* Set up at init */
+static uint16_t vnet_active_pairs = 1;     /* Enabled through the control queue */
+
+/* Caps applied at setup (virtio_net_set_queues) */
+static uint16_t vnet_pairs_cap = VNET_MAX_PAIRS;
+static uint16_t vnet_rx_size_cap = RX_QUEUE_SIZE;
+static uint16_t vnet_tx_size_cap = TX_QUEUE_SIZE;
+
+static struct virtqueue ctrl_queue;
+static uint8_t  ctrl_ready;
+static uint64_t vnet_features;
+
+static const char *const vnet_queue_names[VNET_MAX_PAIRS * 2] = {
+    "vnet_rx0", "vnet_tx0", "vnet_rx1", "vnet_tx1",
+    "vnet_rx2", "vnet_tx2", "vnet_rx3", "vnet_tx3",
+};
+
+_Static_assert(VNET_MAX_PAIRS <= 4, "vnet_queue_names needs more entries");
+
+/* Control command staging: header, payload, ack (device-visible, DMA zone) */
+struct vnet_ctrl_buf {
+    uint8_t          data[512];
+    uint8_t          class;
+    uint8_t          cmd;
+    volatile uint8_t ack;
+};
+
+static struct vnet_ctrl_buf *ctrl_buf;
 
 
 /* ============================================
@@ -72,18 +165,61 @@ void virtio_net_init(struct virtio_pci_device *vdev)
     mmio_write32(common + 0x00, 1);
     uint32_t f1 = mmio_read32(common + 0x04);
 
-    uint32_t accept0 = 0;
-    uint32_t accept1 = 0;
+    uint64_t offered = f0 | ((uint64_t)f1 << 32);
+    uint64_t accept = 0;
 
-    if (f0 & (1 << 5)) accept0 |= (1 << 5);   // MAC
-    if (f0 & (1 << 27)) accept0 |= (1 << 27); // ANY_LAYOUT (Highly recommended)
-    if (f1 & (1 << 0)) accept1 |= (1 << 0);   // VERSION_1
+    if (offered & VIRTIO_NET_F_MAC)        accept |= VIRTIO_NET_F_MAC;
+    if (offered & VIRTIO_F_ANY_LAYOUT)     accept |= VIRTIO_F_ANY_LAYOUT;   // Highly recommended
+    if (offered & VIRTIO_F_VERSION_1)      accept |= VIRTIO_F_VERSION_1;
+
+    /* Multi-fragment TX frames take one ring slot instead of one per fragment */
+    if (offered & VIRTIO_RING_F_INDIRECT_DESC) accept |= VIRTIO_RING_F_INDIRECT_DESC;
+
+    /* Checksum offload: the device finishes TX checksums, vouches for RX ones */
+    if (offered & VIRTIO_NET_F_CSUM)       accept |= VIRTIO_NET_F_CSUM;
+    if (offered & VIRTIO_NET_F_GUEST_CSUM) accept |= VIRTIO_NET_F_GUEST_CSUM;
+
+    /* TSO needs the device to checksum the segments it cuts */
+    if ((accept & VIRTIO_NET_F_CSUM) && (offered & VIRTIO_NET_F_HOST_TSO4))
+        accept |= VIRTIO_NET_F_HOST_TSO4;
+
+    /*
+     * Mergeable RX buffers: a frame may span several page buffers, so
+     * large receives (GUEST_TSO4, which also needs GUEST_CSUM) fit
+     * without posting 64 KB per descriptor.
+     */
+    if (offered & VIRTIO_NET_F_MRG_RXBUF)  accept |= VIRTIO_NET_F_MRG_RXBUF;
+    if ((accept & VIRTIO_NET_F_MRG_RXBUF) && (accept & VIRTIO_NET_F_GUEST_CSUM) &&
+        (offered & VIRTIO_NET_F_GUEST_TSO4))
+        accept |= VIRTIO_NET_F_GUEST_TSO4;
+
+    /*
+     * Multiqueue needs per-queue interrupts to be worth it: without the
+     * ITS every queue would be polled from CPU0 anyway.
+     */
+#ifndef CONFIG_VIRTIO_RING_SPLIT
+    /*
+     * Packed ring: one descriptor array instead of desc/avail/used, so a
+     * frame touches one cache line of ring state. In-order completion
+     * lets the device answer a batch with a single used descriptor.
+     */
+    if (offered & VIRTIO_F_RING_PACKED) {
+        accept |= VIRTIO_F_RING_PACKED;
+        if (offered & VIRTIO_F_IN_ORDER) accept |= VIRTIO_F_IN_ORDER;
+    }
+#endif
+
+    if ((offered & VIRTIO_NET_F_CTRL_VQ) && vdev->msix_ready) {
+        accept |= VIRTIO_NET_F_CTRL_VQ;
+        if (offered & VIRTIO_NET_F_MQ)  accept |= VIRTIO_NET_F_MQ;
+        if (offered & VIRTIO_NET_F_RSS) accept |= VIRTIO_NET_F_RSS;
+    }
 
     mmio_write32(common + 0x08, 0);
-    mmio_write32(common + 0x0C, accept0);
+    mmio_write32(common + 0x0C, (uint32_t)accept);
 
     mmio_write32(common + 0x08, 1);
-    mmio_write32(common + 0x0C, accept1);
+    mmio_write32(common + 0x0C, (uint32_t)(accept >> 32));
 
     status |= VIRTIO_STATUS_FEATURES_OK;
     mmio_write32(common + 0x14, status);
@@ -93,10 +229,7 @@ void virtio_net_init(struct virtio_pci_device *vdev)
         return;
     }
 
-    status |= VIRTIO_STATUS_DRIVER_OK;
-    mmio_write32(common + 0x14, status);
-
-    uart_puts("[OK] VirtIO-Net: Device LIVE\r\n");
+    vnet_features = accept;
 
     /* Read MAC */
     uart_puts("[INFO] Hardware MAC: ");
@@ -117,8 +250,216 @@ void virtio_net_init(struct virtio_pci_device *vdev)
     }
     uart_puts("\r\n");
 
-    /* Setup Queues */
+    /* Setup Queues: the spec wants them live before DRIVER_OK */
     virtio_net_setup_queues(vdev);
+
+    status |= VIRTIO_STATUS_DRIVER_OK;
+    mmio_write32(common + 0x14, status);
+
+    uart_puts((vnet_features & VIRTIO_F_RING_PACKED) ?
+              "[OK] VirtIO-Net: Packed virtqueues\r\n" : "[OK] VirtIO-Net: Split virtqueues\r\n");
+    uart_puts("[OK] VirtIO-Net: Device LIVE\r\n");
+}
+
+
+/* ============================================
+   NAPI
+   ============================================ */
+
+static uint16_t napi_weight = VNET_NAPI_WEIGHT;
+static uint64_t napi_linger_ns = VNET_NAPI_LINGER_NS;
+
+static int vnet_rx_one(struct vnet_pair *pair);
+static void vnet_rx_refill(struct vnet_pair *pair);
+static int vnet_tx_reap(struct vnet_pair *pair, int budget);
+
+static int vnet_rx_poll(struct vnet_pair *pair, int budget)
+{
+    int done = 0;
+
+    /* Replies to this batch leave with one TX doorbell */
+    ethernet_tx_batch_begin();
+
+    while (done < budget && vnet_rx_one(pair))
+        done++;
+
+    /* Batch boundary: merged segments go up the stack now */
+    gro_flush();
+    ethernet_tx_batch_end();
+
+    /*
+     * A pass that drained half the posted buffers: post more. Empty
+     * passes let the target sink back; buffers above it are not
+     * replaced once used, and their pages return to the heap.
+     */
+    if ((uint32_t)done * 2 > pair->rx_target && pair->rx_target < pair->rx.size) {
+        pair->rx_target *= 2;
+        if (pair->rx_target > pair->rx.size)
+            pair->rx_target = pair->rx.size;
+    } else if (!done && pair->rx_target > RX_FILL_MIN) {
+        pair->rx_target--;
+    }
+
+    /* Everything used this pass goes back in one batch, one notify */
+    vnet_rx_refill(pair);
+    return done;
+}
+
+static void vnet_napi_run(struct sched_work *w)
+{
+    struct vnet_napi *n = w->data;
+    uint16_t weight = napi_weight;
+
+    int done = n->poll(n->pair, weight);
+    uint64_t now = timer_get_ns();
+
+    n->stats.polls++;
+    n->stats.packets += done;
+
+    if (done)
+        n->last_work_ns = now;
+
+    if (done >= weight) {
+        n->stats.budget_hits++;
+        sched_queue_work(w);
+        return;
+    }
+
+    /* Stay in poll mode a little longer: bursts rarely arrive alone */
+    if (now - n->last_work_ns < napi_linger_ns) {
+        sched_queue_work(w);
+        return;
+    }
+
+    if (virtqueue_enable_cb(n->vq)) {
+        virtqueue_disable_cb(n->vq);
+        n->stats.rearm_races++;
+        sched_queue_work(w);
+        return;
+    }
+
+    n->stats.rearms++;
+}
+
+/* Top half: mask the queue and hand over to the poll */
+static irqreturn_t vnet_napi_irq(uint32_t irq, void *ctx)
+{
+    struct vnet_napi *n = ctx;
+
+    (void)irq;
+    n->stats.irqs++;
+
+    virtqueue_disable_cb(n->vq);
+    sched_queue_work(&n->work);
+    return IRQ_HANDLED;
+}
+
+/* Vector number == queue index; every queue starts on CPU0 */
+static int vnet_napi_attach(struct vnet_pair *pair, struct vnet_napi *n, struct virtqueue *vq,
+                            int (*poll)(struct vnet_pair *, int))
+{
+    n->name = vnet_queue_names[vq->queue_index];
+    n->vq   = vq;
+    n->pair = pair;
+    n->poll = poll;
+    sched_init_work(&n->work, vnet_napi_run, n, SCHED_PRIO_NET);
+
+    int lpi = virtio_pci_queue_vector(pair->vdev, vq->queue_index, vq->queue_index, 0,
+                                      vnet_napi_irq, n, n->name);
+
+    /* No vector: a poller drains the queue, interrupts would be wasted */
+    if (lpi < 0)
+        virtqueue_disable_cb(vq);
+
+    return lpi;
+}
+
+void virtio_net_set_moderation(uint16_t weight, uint64_t linger_ns)
+{
+    if (weight)
+        napi_weight = weight;
+    napi_linger_ns = linger_ns;
+}
+
+void virtio_net_get_napi_stats(int queue, vnet_napi_stats_t *out)
+{
+    if (queue < 0 || queue >= vnet_max_pairs * 2)
+        return;
+
+    struct vnet_pair *pair = &vnet_pairs[queue / 2];
+    *out = (queue & 1) ? pair->tx_napi.stats : pair->rx_napi.stats;
+}
+
+uint16_t virtio_net_nr_pairs(void)
+{
+    return vnet_active_pairs;
+}
+
+uint32_t virtio_net_format(char *out, uint32_t out_size)
+{
+    uint32_t pos = 0;
+
+    pos += ksnprintf(out + pos, out_size - pos,
+                     "ring %s%s\n"
+                     "weight %u  linger_us %u  pairs %u/%u\n"
+                     "queue     irqs  polls  packets  budget_hits  rearms  races\n",
+                     (char *)((vnet_features & VIRTIO_F_RING_PACKED) ? "packed" : "split"),
+                     (char *)((vnet_features & VIRTIO_F_IN_ORDER) ? " in-order" : ""),
+                     napi_weight, (unsigned int)(napi_linger_ns / 1000),
+                     vnet_active_pairs, vnet_max_pairs);
+
+    for (int q = 0; q < vnet_max_pairs * 2 && pos + 1 < out_size; q++) {
+        vnet_napi_stats_t s;
+
+        virtio_net_get_napi_stats(q, &s);
+        pos += ksnprintf(out + pos, out_size - pos, "%s  %u  %u  %u  %u  %u  %u\n",
+                         vnet_queue_names[q],
+                         (unsigned int)s.irqs, (unsigned int)s.polls,
+                         (unsigned int)s.packets, (unsigned int)s.budget_hits,
+                         (unsigned int)s.rearms, (unsigned int)s.rearm_races);
+    }
+
+    pos += ksnprintf(out + pos, out_size - pos,
+                     "rx buffers: mergeable %s  gso %s\n"
+                     "pair  posted  target  pool_free  pool_used  allocs  recycled  multi  errors\n",
+                     (char *)((vnet_features & VIRTIO_NET_F_MRG_RXBUF) ? "yes" : "no"),
+                     (char *)((vnet_features & VIRTIO_NET_F_GUEST_TSO4) ? "yes" : "no"));
+
+    for (int p = 0; p < vnet_max_pairs && pos + 1 < out_size; p++) {
+        struct vnet_pair *pair = &vnet_pairs[p];
+
+        pos += ksnprintf(out + pos, out_size - pos, "%u  %u  %u  %u  %u  %u  %u  %u  %u\n", p,
+                         pair->rx_posted, pair->rx_target,
+                         pair->rx_pool.nr_free, pair->rx_pool.in_use,
+                         (unsigned int)pair->rx_pool.allocs,
+                         (unsigned int)pair->rx_pool.recycled,
+                         (unsigned int)pair->rx_multi,
+                         (unsigned int)pair->rx_errors);
+    }
+
+    pos += ksnprintf(out + pos, out_size - pos,
+                     "tx  frames  doorbells  per_doorbell  frags/frame  indirect  inflight  peak  slots_peak/size\n");
+
+    for (int p = 0; p < vnet_max_pairs && pos + 1 < out_size; p++) {
+        struct vnet_pair *pair = &vnet_pairs[p];
+        unsigned long frames = pair->tx_frames;
+        unsigned long kicks = pair->tx_doorbells ? pair->tx_doorbells : 1;
+        unsigned long ratio = frames * 100 / kicks;
+        unsigned long frags = pair->tx_frags * 100 / (frames ? frames : 1);
+
+        pos += ksnprintf(out + pos, out_size - pos,
+                         "%u  %u  %u  %u.%u%u  %u.%u%u  %u  %u  %u  %u/%u\n", p,
+                         (unsigned int)frames, (unsigned int)pair->tx_doorbells,
+                         (unsigned int)(ratio / 100), (unsigned int)(ratio / 10 % 10),
+                         (unsigned int)(ratio % 10),
+                         (unsigned int)(frags / 100), (unsigned int)(frags / 10 % 10),
+                         (unsigned int)(frags % 10),
+                         (unsigned int)pair->tx_indirect, (unsigned int)pair->tx_inflight,
+                         (unsigned int)pair->tx_inflight_peak,
+                         pair->tx_slots_peak, pair->tx.size);
+    }
+
+    return pos;
 }
 
 
@@ -126,172 +467,775 @@ void virtio_net_init(struct virtio_pci_device *vdev)
    Queue Setup (Modern VirtIO PCI, ARM64 Safe)
    ============================================ */
 
-void virtio_net_setup_queues(struct virtio_pci_device *vdev)
+/* Select @index and clamp the device's maximum to what we have memory for */
+static uint16_t vnet_queue_size(struct virtio_pci_device *vdev, uint16_t index, uint16_t max)
 {
-    uart_puts("[NET] Setting up RX/TX queues...\r\n");
+    vdev->common->queue_select = index;
+
+    uint16_t size = vdev->common->queue_size;
+    return size > max ? max : size;
+}
+
+/* Ring layout as negotiated, in coherent memory sized for @size */
+static int vnet_vq_init(struct virtqueue *vq, uint16_t size, uint16_t index)
+{
+    int packed = (vnet_features & VIRTIO_F_RING_PACKED) != 0;
+    size_t bytes = virtqueue_ring_bytes(size, packed);
+    void *mem = dma_alloc(bytes, DMA_COHERENT | DMA_ZERO);
+
+    if (!mem)
+        return -1;
+
+    if (!packed) {
+        virtqueue_init(vq, size, index, mem);
+        return 0;
+    }
+
+    if (virtqueue_init_packed(vq, size, index, mem,
+                              (vnet_features & VIRTIO_F_IN_ORDER) != 0) < 0) {
+        dma_free(mem, bytes);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Undo vnet_vq_init() for a queue the device was never given */
+static void vnet_vq_free(struct virtqueue *vq)
+{
+    if (vq->packed) {
+        dma_free(vq->ring, virtqueue_ring_bytes(vq->size, 1));
+        kfree(vq->desc);
+        kfree(vq->order);
+    } else {
+        dma_free(vq->desc, virtqueue_ring_bytes(vq->size, 0));
+    }
+}
+
+/* Split rings must be a power of two: so must anything min()'d with one */
+static uint16_t vnet_size_cap(uint16_t size)
+{
+    if (size > VNET_QUEUE_SIZE_MAX)
+        size = VNET_QUEUE_SIZE_MAX;
+
+    while (size & (size - 1))
+        size &= size - 1;
+
+    return size;
+}
+
+void virtio_net_set_queues(uint16_t pairs, uint16_t rx_size, uint16_t tx_size)
+{
+    if (pairs)
+        vnet_pairs_cap = pairs > VNET_MAX_PAIRS ? VNET_MAX_PAIRS : pairs;
+    if (rx_size)
+        vnet_rx_size_cap = vnet_size_cap(rx_size);
+    if (tx_size)
+        vnet_tx_size_cap = vnet_size_cap(tx_size);
+}
+
+static int vnet_setup_pair(struct virtio_pci_device *vdev, uint16_t p)
+{
+    struct vnet_pair *pair = &vnet_pairs[p];
+
+    pair->vdev = vdev;
+    page_pool_init(&pair->rx_pool, "vnet_rx_pool", RX_POOL_KEEP);
 
     /* =========================
        RX QUEUE
        ========================= */
 
-    vdev->common->queue_select = RX_QUEUE_INDEX;
-
-    uint16_t rx_size = vdev->common->queue_size;
+    uint16_t rx_size = vnet_queue_size(vdev, RX_QUEUE_INDEX(p), vnet_rx_size_cap);
     if (rx_size == 0) {
         uart_puts("[ERROR] RX queue size is 0!\r\n");
-        return;
+        return -1;
     }
 
-    virtqueue_init(&rx_queue, rx_size, RX_QUEUE_INDEX, rx_ring_mem);
-    virtio_pci_bind_queue(vdev, &rx_queue);
+    uint16_t tx_size = vnet_queue_size(vdev, TX_QUEUE_INDEX(p), vnet_tx_size_cap);
+    if (tx_size == 0) {
+        uart_puts("[ERROR] TX queue size is 0!\r\n");
+        return -1;
+    }
 
-    /* CRITICAL: expose queues to global device */
-    vdev->rx_vq = &rx_queue;
+    /* Everything is allocated before the device sees any of it */
+    size_t indir_bytes = sizeof(struct virtq_desc) * VNET_TX_MAX_FRAGS * tx_size;
 
-    /*
-     * Prefill RX buffers
-     * Publish them without notifying per descriptor
-     */
-    for (uint16_t i = 0; i < rx_size; i++) {
+    pair->rx_page = kmalloc(sizeof(*pair->rx_page) * rx_size);
+    pair->rx_idle = kmalloc(sizeof(*pair->rx_idle) * rx_size);
+    pair->rx_done = kmalloc(sizeof(*pair->rx_done) * rx_size);
+    pair->tx_indir = dma_alloc(indir_bytes, DMA_COHERENT | DMA_ZERO);
+    pair->tx_indir_free = kmalloc(sizeof(*pair->tx_indir_free) * tx_size);
+    if (!pair->rx_page || !pair->rx_idle || !pair->rx_done ||
+        !pair->tx_indir || !pair->tx_indir_free)
+        goto fail_bookkeeping;
 
-        uint16_t id = virtqueue_add_descriptor(
-            &rx_queue,
-            (uint64_t)&rx_buffers[i][0],
-            RX_BUF_SIZE,
-            VIRTQ_DESC_F_WRITE
-        );
+    if (vnet_vq_init(&pair->rx, rx_size, RX_QUEUE_INDEX(p)) < 0)
+        goto fail_bookkeeping;
+    if (vnet_vq_init(&pair->tx, tx_size, TX_QUEUE_INDEX(p)) < 0)
+        goto fail_rx_ring;
 
-        uint16_t idx = rx_queue.avail->idx;
-        rx_queue.avail->ring[idx % rx_queue.size] = id;
-        rx_queue.avail->idx = idx + 1;
-    }
+    memset(pair->rx_page, 0, sizeof(*pair->rx_page) * rx_size);
+    pair->rx_lpi = vnet_napi_attach(pair, &pair->rx_napi, &pair->rx, vnet_rx_poll);
+    virtio_pci_bind_queue(vdev, &pair->rx);
 
-    /* Ensure descriptors + avail ring visible before notify */
-    asm volatile("dsb sy" ::: "memory");
+    /* Prefill RX buffers up to the idle target, one notify for the batch */
+    for (uint16_t i = 0; i < rx_size; i++)
+        pair->rx_idle[i] = rx_size - 1 - i;
+    pair->rx_nidle = rx_size;
 
-    /* Single notify for RX batch */
-    virtqueue_notify(vdev, RX_QUEUE_INDEX);
+    pair->rx_target = rx_size < RX_FILL_MIN ? rx_size : RX_FILL_MIN;
+    vnet_rx_refill(pair);
 
 
     /* =========================
        TX QUEUE
        ========================= */
 
-    vdev->common->queue_select = TX_QUEUE_INDEX;
+    spin_lock_init(&pair->tx_indir_lock, "vnet_tx_indir");
+    for (uint16_t i = 0; i < tx_size; i++)
+        pair->tx_indir_free[i] = i;
+    pair->tx_indir_nfree = tx_size;
+    pair->tx_lpi = vnet_napi_attach(pair, &pair->tx_napi, &pair->tx, vnet_tx_reap);
+    virtio_pci_bind_queue(vdev, &pair->tx);
 
-    uint16_t tx_size = vdev->common->queue_size;
-    if (tx_size == 0) {
-        uart_puts("[ERROR] TX queue size is 0!\r\n");
-        return;
+    asm volatile("dsb sy" ::: "memory");
+    return 0;
+
+fail_rx_ring:
+    vnet_vq_free(&pair->rx);
+fail_bookkeeping:
+    kfree(pair->rx_page);
+    kfree(pair->rx_idle);
+    kfree(pair->rx_done);
+    dma_free(pair->tx_indir, indir_bytes);
+    kfree(pair->tx_indir_free);
+    pair->rx_page = NULL;
+    pair->rx_idle = NULL;
+    pair->rx_done = NULL;
+    pair->tx_indir = NULL;
+    pair->tx_indir_free = NULL;
+    pair->vdev = NULL;
+    return -1;
+}
+
+void virtio_net_setup_queues(struct virtio_pci_device *vdev)
+{
+    uint16_t max_pairs = 1;
+
+    if (vnet_features & VIRTIO_NET_F_MQ) {
+        max_pairs = vdev->device->max_virtqueue_pairs;
+        if (max_pairs == 0)
+            max_pairs = 1;
     }
 
-    virtqueue_init(&tx_queue, tx_size, TX_QUEUE_INDEX, tx_ring_mem);
-    virtio_pci_bind_queue(vdev, &tx_queue);
+    /* All of them must be set up; only vnet_pairs_cap get used */
+    uint16_t pairs = max_pairs > vnet_pairs_cap ? vnet_pairs_cap : max_pairs;
 
-    /* CRITICAL: expose TX queue for ethernet_send() */
-    vdev->tx_vq = &tx_queue;
+    uart_puts("[NET] Setting up ");
+    uart_put_int(pairs);
+    uart_puts(" RX/TX queue pair(s)...\r\n");
 
-    asm volatile("dsb sy" ::: "memory");
+    for (uint16_t p = 0; p < pairs; p++) {
+        if (vnet_setup_pair(vdev, p) < 0) {
+            if (p == 0)
+                return;
+            pairs = p;
+            break;
+        }
+    }
+
+    vnet_max_pairs = pairs;
 
-    vdev->rx_vq = &rx_queue;
-    vdev->tx_vq = &tx_queue;
+    /* CRITICAL: expose pair 0 to the global device (pollers, ethernet_send fallback) */
+    vdev->rx_vq  = &vnet_pairs[0].rx;
+    vdev->tx_vq  = &vnet_pairs[0].tx;
+    vdev->rx_lpi = vnet_pairs[0].rx_lpi;
+    vdev->tx_lpi = vnet_pairs[0].tx_lpi;
+
+    /* =========================
+       CONTROL QUEUE
+       ========================= */
+
+    if (vnet_features & VIRTIO_NET_F_CTRL_VQ) {
+        uint16_t index = max_pairs * 2;
+        uint16_t size = vnet_queue_size(vdev, index, CTRL_QUEUE_SIZE);
+
+        if (!ctrl_buf)
+            ctrl_buf = dma_alloc(sizeof(*ctrl_buf), DMA_COHERENT | DMA_ZERO);
+
+        if (size && ctrl_buf && vnet_vq_init(&ctrl_queue, size, index) == 0) {
+            virtqueue_disable_cb(&ctrl_queue);      /* Polled to completion */
+            virtio_pci_bind_queue(vdev, &ctrl_queue);
+            ctrl_ready = 1;
+        }
+    }
 
     uart_puts("[NET] Queues Ready\r\n");
 }
 
 
 /* ============================================
-   Poll RX Queue
+   Control Queue & Multiqueue
    ============================================ */
 
-void virtio_net_poll(struct virtio_pci_device *vdev)
+/**
+ * vnet_ctrl_cmd: One command through the control queue.
+ * Header and payload are device-readable, the ack byte device-writable;
+ * the device answers before the notify returns on QEMU, the spin bound
+ * covers anything slower. Returns 0 if the device acked VIRTIO_NET_OK.
+ */
+static int vnet_ctrl_cmd(struct virtio_pci_device *vdev, uint8_t class, uint8_t cmd, uint32_t len)
 {
+    if (!ctrl_ready)
+        return -1;
 
-    uint32_t len;
+    ctrl_buf->class = class;
+    ctrl_buf->cmd = cmd;
+    ctrl_buf->ack = 0xFF;
 
-    /* Ensure DMA writes are visible to CPU */
-    asm volatile("dsb sy" ::: "memory");
+    uint16_t h = virtqueue_add_descriptor(&ctrl_queue, (uint64_t)&ctrl_buf->class, 2, 0);
+    uint16_t d = virtqueue_add_descriptor(&ctrl_queue, (uint64_t)ctrl_buf->data, len, 0);
+    uint16_t a = virtqueue_add_descriptor(&ctrl_queue, (uint64_t)&ctrl_buf->ack, 1, VIRTQ_DESC_F_WRITE);
 
-    int id = virtqueue_pop_used(&rx_queue, &len);
+    if (h == 0xFFFF || d == 0xFFFF || a == 0xFFFF)
+        return -1;
 
-    if (id < 0)
-        return;
+    ctrl_queue.desc[h].flags |= VIRTQ_DESC_F_NEXT;
+    ctrl_queue.desc[h].next = d;
+    ctrl_queue.desc[d].flags |= VIRTQ_DESC_F_NEXT;
+    ctrl_queue.desc[d].next = a;
 
-    /* Memory barrier AFTER popping used ring */
-    asm volatile("dsb sy" ::: "memory");
+    virtqueue_push_available(vdev, &ctrl_queue, h);
+
+    int spins = CTRL_SPINS;
+    while (!virtqueue_has_used(&ctrl_queue)) {
+        if (--spins <= 0) {
+            klog_err(KLOG_SUB_VIRTIO, "control command %u/%u timed out", class, cmd);
+            return -1;
+        }
+    }
 
-    uint8_t *full_buffer = rx_buffers[id];
+    virtqueue_pop_used(&ctrl_queue, NULL);
+    return ctrl_buf->ack == VIRTIO_NET_OK ? 0 : -1;
+}
+
+/* Device-side RSS with the same key and indirection table rss_receive uses */
+static int vnet_set_rss(struct virtio_pci_device *vdev, uint16_t pairs)
+{
+    const uint16_t *indir = rss_indirection_table();
+    uint16_t table_len = vdev->device->rss_max_indirection_table_length;
+    uint8_t key_len = vdev->device->rss_max_key_size;
+    uint32_t pos = 0;
+
+    if (table_len > RSS_INDIR_SIZE)
+        table_len = RSS_INDIR_SIZE;
+    if (key_len > RSS_KEY_SIZE)
+        key_len = RSS_KEY_SIZE;
+
+    /* Power of two, or the mask below would skip entries */
+    while (table_len & (table_len - 1))
+        table_len &= table_len - 1;
+
+    if (!table_len || key_len < RSS_KEY_SIZE || !ctrl_ready)
+        return -1;
+
+    uint8_t *ctrl_data = ctrl_buf->data;
+
+    uint32_t hash_types = VIRTIO_NET_RSS_HASH_TYPE_IPv4 |
+                          VIRTIO_NET_RSS_HASH_TYPE_TCPv4 |
+                          VIRTIO_NET_RSS_HASH_TYPE_UDPv4;
+
+    memcpy(ctrl_data + pos, &hash_types, 4);                pos += 4;
+    uint16_t mask = table_len - 1;
+    memcpy(ctrl_data + pos, &mask, 2);                      pos += 2;
+    uint16_t unclassified = 0;
+    memcpy(ctrl_data + pos, &unclassified, 2);              pos += 2;
+
+    /* A shorter table still matches: ours repeats with period @pairs */
+    for (uint16_t i = 0; i < table_len; i++) {
+        memcpy(ctrl_data + pos, &indir[i], 2);              pos += 2;
+    }
 
-    /* Modern VirtIO v1.0 header is 12 bytes */
-    #define VIRTIO_NET_HDR_SZ 12
-    uint8_t *eth_frame = full_buffer + VIRTIO_NET_HDR_SZ;
+    memcpy(ctrl_data + pos, &pairs, 2);                     pos += 2;   /* max_tx_vq */
+    ctrl_data[pos++] = key_len;
+    memcpy(ctrl_data + pos, rss_key(), key_len);            pos += key_len;
 
+    return vnet_ctrl_cmd(vdev, VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_RSS_CONFIG, pos);
+}
 
-    uint32_t eth_len = 0;
-    if (len > sizeof(struct virtio_net_hdr)) {
-        eth_len = len - sizeof(struct virtio_net_hdr);
+void virtio_net_enable_mq(struct virtio_pci_device *vdev)
+{
+    uint32_t cpus = smp_num_online();
+    uint16_t pairs = vnet_max_pairs;
+
+    /* Queue pair N and steering target N are both CPU N */
+    if (pairs > cpus)
+        pairs = cpus;
+
+    /* Only pair 0 has a polled fallback: stop at the first without LPIs */
+    for (uint16_t p = 1; p < pairs; p++) {
+        if (vnet_pairs[p].rx_lpi < 0 || vnet_pairs[p].tx_lpi < 0) {
+            klog_warn(KLOG_SUB_VIRTIO, "queue pair %u has no LPIs, using %u", p, p);
+            pairs = p;
+            break;
+        }
     }
 
-    if (eth_len == 0)
-        goto refill;
+    rss_init(cpus);
 
-    /* Debug MAC verification */
-    uart_puts("[RX] Dest MAC: ");
-    for (int i = 0; i < 6; i++) {
-        uart_put_hex(eth_frame[i]);
-        if (i < 5) uart_puts(":");
+    if (pairs > 1) {
+        for (uint16_t p = 1; p < pairs; p++) {
+            its_route_event(vnet_pairs[p].rx_lpi, p);
+            its_route_event(vnet_pairs[p].tx_lpi, p);
+        }
+
+        if ((vnet_features & VIRTIO_NET_F_RSS) && pairs == cpus &&
+            vnet_set_rss(vdev, pairs) == 0) {
+            rss_set_hw_steering(1);
+        } else {
+            if (ctrl_ready) {
+                ctrl_buf->data[0] = pairs & 0xFF;
+                ctrl_buf->data[1] = pairs >> 8;
+            }
+            if (vnet_ctrl_cmd(vdev, VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, 2) < 0) {
+                klog_warn(KLOG_SUB_VIRTIO, "device refused %u queue pairs", pairs);
+                pairs = 1;
+            }
+        }
+
+        vnet_active_pairs = pairs;
+    }
+
+    uart_puts("[OK] VirtIO-Net: ");
+    uart_put_int(vnet_active_pairs);
+    uart_puts(" queue pair(s), RX steered over ");
+    uart_put_int(cpus);
+    uart_puts(" core(s).\r\n");
+}
+
+int virtio_net_tx_csum(void)
+{
+    return (vnet_features & VIRTIO_NET_F_CSUM) != 0;
+}
+
+int virtio_net_tx_tso(void)
+{
+    return (vnet_features & VIRTIO_NET_F_HOST_TSO4) != 0;
+}
+
+/* Doorbell for everything queued on @pair's TX ring so far */
+static void vnet_tx_kick(struct vnet_pair *pair)
+{
+    if (virtqueue_kick(pair->vdev, &pair->tx))
+        stat_inc(&pair->tx_doorbells);
+}
+
+static struct virtq_desc *vnet_indir_get(struct vnet_pair *pair)
+{
+    struct virtq_desc *table = NULL;
+    uint64_t flags = spin_lock_irqsave(&pair->tx_indir_lock);
+
+    if (pair->tx_indir_nfree) {
+        uint16_t i = pair->tx_indir_free[--pair->tx_indir_nfree];
+        table = pair->tx_indir + i * VNET_TX_MAX_FRAGS;
+    }
+
+    spin_unlock_irqrestore(&pair->tx_indir_lock, flags);
+    return table;
+}
+
+static void vnet_indir_put(struct vnet_pair *pair, struct virtq_desc *table)
+{
+    uint16_t i = (uint16_t)((table - pair->tx_indir) / VNET_TX_MAX_FRAGS);
+    uint64_t flags = spin_lock_irqsave(&pair->tx_indir_lock);
+
+    pair->tx_indir_free[pair->tx_indir_nfree++] = i;
+    spin_unlock_irqrestore(&pair->tx_indir_lock, flags);
+}
+
+/* One frame of @n buffers: one slot (plain or indirect), else a chain */
+static uint16_t vnet_tx_add(struct vnet_pair *pair, const uint64_t *addrs, const uint32_t *lens,
+                            uint16_t n)
+{
+    if (n == 1)
+        return virtqueue_add_descriptor(&pair->tx, addrs[0], lens[0], 0);
+
+    if (vnet_features & VIRTIO_RING_F_INDIRECT_DESC) {
+        struct virtq_desc *table = vnet_indir_get(pair);
+
+        if (table) {
+            uint16_t head = virtqueue_add_indirect(&pair->tx, table, addrs, lens, n);
+            if (head != 0xFFFF) {
+                stat_inc(&pair->tx_indirect);
+                return head;
+            }
+            vnet_indir_put(pair, table);
+        }
+    }
+
+    return virtqueue_add_chain(&pair->tx, addrs, lens, n);
+}
+
+int virtio_net_xmit_sg(const struct netbuf *frags, int more)
+{
+    struct vnet_pair *pair = &vnet_pairs[smp_processor_id() % vnet_active_pairs];
+    uint64_t addrs[VNET_TX_MAX_FRAGS];
+    uint32_t lens[VNET_TX_MAX_FRAGS];
+    uint16_t n = 0;
+
+    for (const struct netbuf *nb = frags; nb; nb = nb->next) {
+        if (n == VNET_TX_MAX_FRAGS)
+            return -1;
+        addrs[n] = (uint64_t)nb->data;
+        lens[n] = nb->len;
+        n++;
+    }
+
+    uint16_t head = vnet_tx_add(pair, addrs, lens, n);
+
+    if (head == 0xFFFF) {
+        /* Full: let the device have what is held back, then make room */
+        vnet_tx_kick(pair);
+        vnet_tx_reap(pair, napi_weight);
+
+        head = vnet_tx_add(pair, addrs, lens, n);
+        if (head == 0xFFFF)
+            return -1;
+    }
+
+    virtqueue_add_available(&pair->tx, head);
+    stat_inc(&pair->tx_frames);
+    stat_add(&pair->tx_frags, n);
+    stat_inc(&pair->tx_inflight);
+
+    /* Peaks are only indicative: racing cores may each miss the other's */
+    uint16_t slots = pair->tx.size - pair->tx.num_free;
+    if (slots > pair->tx_slots_peak)
+        pair->tx_slots_peak = slots;
+    if (pair->tx_inflight > pair->tx_inflight_peak)
+        pair->tx_inflight_peak = pair->tx_inflight;
+
+    if (!more || pair->tx.num_free == 0 || pair->tx.batch_pending >= VNET_TX_BATCH_MAX)
+        vnet_tx_kick(pair);
+
+    return 0;
+}
+
+int virtio_net_xmit(void *buf, uint32_t len, int more)
+{
+    struct netbuf frame = { buf, len, NULL };
+
+    return virtio_net_xmit_sg(&frame, more);
+}
+
+void virtio_net_tx_flush(void)
+{
+    struct vnet_pair *pair = &vnet_pairs[smp_processor_id() % vnet_active_pairs];
+
+    if (pair->vdev)
+        vnet_tx_kick(pair);
+}
+
+
+/* ============================================
+   Poll RX Queue
+   ============================================ */
+
+/*
+ * Repost this pass's used descriptors and, up to rx_target, idle ones
+ * (binding a pool page first if they have none); one notify for all.
+ */
+static void vnet_rx_refill(struct vnet_pair *pair)
+{
+    while (pair->rx_posted + pair->rx_ndone < pair->rx_target && pair->rx_nidle) {
+        uint16_t id = pair->rx_idle[pair->rx_nidle - 1];
+
+        if (!pair->rx_page[id]) {
+            uint8_t *page = page_pool_get(&pair->rx_pool);
+            if (!page)
+                break;
+
+            /* The pool's free-list link may still sit in a dirty line */
+            dma_sync_for_device(page, RX_BUF_SIZE);
+            pair->rx_page[id] = page;
+            virtqueue_bind_buffer(&pair->rx, id, (uint64_t)page, RX_BUF_SIZE, VIRTQ_DESC_F_WRITE);
+        }
+
+        pair->rx_nidle--;
+        pair->rx_done[pair->rx_ndone++] = id;
+    }
+
+    if (!pair->rx_ndone)
+        return;
+
+    virtqueue_rx_recycle(&pair->rx, pair->rx_done, pair->rx_ndone);
+    pair->rx_posted += pair->rx_ndone;
+    pair->rx_ndone = 0;
+
+    virtqueue_kick(pair->vdev, &pair->rx);
+}
+
+/* Descriptor @id came back: queue it for reposting, or retire it above the target */
+static void vnet_rx_release(struct vnet_pair *pair, uint16_t id)
+{
+    pair->rx_posted--;
+
+    if (pair->rx_posted + pair->rx_ndone < pair->rx_target) {
+        pair->rx_done[pair->rx_ndone++] = id;
+        return;
+    }
+
+    page_pool_put(&pair->rx_pool, pair->rx_page[id]);
+    pair->rx_page[id] = NULL;
+    pair->rx_idle[pair->rx_nidle++] = id;
+}
+
+/* Hand one received frame (a chain of @nfrags buffers) to the stack */
+static void vnet_rx_deliver(struct vnet_pair *pair, const struct virtio_net_hdr *vh,
+                            struct netbuf *frags, uint16_t nfrags)
+{
+    uint8_t *eth_frame = frags[0].data;
+    uint32_t eth_len = frags[0].len;
+
+    /* Spread over several pages: the stack wants it in one piece */
+    if (nfrags > 1) {
+        eth_len = netbuf_chain_len(frags);
+        eth_frame = (uint8_t *)kmalloc(eth_len);
+        if (!eth_frame) {
+            stat_inc(&global_net_stats.dropped_packets);
+            return;
+        }
+        netbuf_linearize(frags, eth_frame, eth_len);
+        pair->rx_multi++;
     }
-    uart_puts("\r\n");
 
     uint16_t ethertype = (eth_frame[12] << 8) | eth_frame[13];
-    uart_puts("[RX] EtherType: ");
-    uart_put_hex(ethertype);
-    uart_puts("\r\n");
+    klog_trace(KLOG_SUB_NET, "RX dst %M type 0x%x len %u",
+               klog_mac(eth_frame), ethertype, eth_len);
 
-    global_net_stats.rx_packets++;
+    stat_inc(&global_net_stats.rx_packets);
 
-    ethernet_handle_packet(eth_frame, eth_len);
+    /*
+     * DATA_VALID: checked by the device. NEEDS_CSUM: never left the
+     * host's stack, so there is nothing to check yet (only the
+     * pseudo-header sum is in the field).
+     */
+    struct net_meta meta = { 0 };
+    if ((vnet_features & VIRTIO_NET_F_GUEST_CSUM) &&
+        (vh->flags & (VIRTIO_NET_HDR_F_DATA_VALID | VIRTIO_NET_HDR_F_NEEDS_CSUM)))
+        meta.flags = NET_META_CSUM_VALID;
 
-refill:
-    uint16_t new_id = virtqueue_add_descriptor(
-        &rx_queue,
-        (uint64_t)full_buffer,
-        RX_BUF_SIZE,
-        VIRTQ_DESC_F_WRITE
-    );
+    /* Runs it here or hands it to the core that owns the flow */
+    rss_receive(eth_frame, eth_len, &meta);
 
-    virtqueue_push_available(vdev, &rx_queue, new_id);
+    if (nfrags > 1)
+        kfree(eth_frame);
 }
 
+/* One frame from @pair's RX ring; returns frames consumed (0 or 1) */
+static int vnet_rx_one(struct vnet_pair *pair)
+{
+    struct netbuf frags[RX_MAX_FRAGS];
+    uint16_t ids[RX_MAX_FRAGS];
+    uint16_t nfrags = 0;
+    uint32_t len;
+
+    /* Ensure DMA writes are visible to CPU */
+    asm volatile("dsb sy" ::: "memory");
+
+    int id = virtqueue_pop_used(&pair->rx, &len);
+
+    if (id < 0)
+        return 0;
+
+    /* Memory barrier AFTER popping used ring */
+    asm volatile("dsb sy" ::: "memory");
+
+    uint8_t *page = pair->rx_page[id];
+    struct virtio_net_hdr *vh = (struct virtio_net_hdr *)page;
+    uint32_t lens[RX_MAX_FRAGS];
+
+    dma_sync_for_cpu(page, len);
+    lens[0] = len;
+
+    /* Without MRG_RXBUF every frame fits one buffer */
+    uint16_t nbufs = (vnet_features & VIRTIO_NET_F_MRG_RXBUF) ? vh->num_buffers : 1;
+    int ok = len > sizeof(struct virtio_net_hdr) && nbufs >= 1 && nbufs <= RX_MAX_FRAGS;
+
+    ids[0] = id;
+    frags[0].data = page + sizeof(struct virtio_net_hdr);
+    frags[0].len = ok ? len - sizeof(struct virtio_net_hdr) : 0;
+    frags[0].next = NULL;
+    nfrags = 1;
+
+    /* The device publishes a frame's buffers together: the rest are used too */
+    for (uint16_t i = 1; i < nbufs; i++) {
+        int next = virtqueue_pop_used(&pair->rx, &len);
+        if (next < 0) {
+            ok = 0;
+            break;
+        }
+
+        if (nfrags == RX_MAX_FRAGS) {
+            vnet_rx_release(pair, next);
+            continue;
+        }
+
+        dma_sync_for_cpu(pair->rx_page[next], len);
+        lens[nfrags] = len;
+        ids[nfrags] = next;
+        frags[nfrags].data = pair->rx_page[next];
+        frags[nfrags].len = len;
+        frags[nfrags].next = NULL;
+        frags[nfrags - 1].next = &frags[nfrags];
+        nfrags++;
+    }
+
+    if (ok) {
+        vnet_rx_deliver(pair, vh, frags, nfrags);
+    } else {
+        pair->rx_errors++;
+        stat_inc(&global_net_stats.dropped_packets);
+    }
+
+    /* Reposted by the poll once the batch is done; the stack may have written to them */
+    for (uint16_t i = 0; i < nfrags; i++) {
+        dma_sync_for_device(pair->rx_page[ids[i]], lens[i]);
+        vnet_rx_release(pair, ids[i]);
+    }
+
+    return 1;
+}
 
 /**
- * net_tx_reaper: Reclaims memory after packets are sent.
- * This should be called in your main kernel loop.
+ * virtio_net_poll: Handles at most @budget received frames on pair 0
+ * and reposts their buffers in one batch. Returns the number of frames
+ * (0 = queue empty), which the idle loop uses as its activity signal.
  */
-void net_tx_reaper() {
-    uint32_t len;
-    int desc_id;
+int virtio_net_poll(struct virtio_pci_device *vdev, int budget)
+{
+    (void)vdev;
+    return vnet_rx_poll(&vnet_pairs[0], budget);
+}
 
-    // Use the local tx_queue pointer initialized in setup_queues
-    // We use &tx_queue because it's a static struct in this file.
-    while ((desc_id = virtqueue_pop_used(&tx_queue, &len)) != -1) {
-        
-        // 1. Get the address stored in the descriptor
-        // This is the pointer we kmalloc'd in ethernet_send()
-        void* buffer_to_free = (void*)tx_queue.desc[desc_id].addr;
-        
-        // 2. Safety check: Don't free NULL or obvious garbage
-        if (buffer_to_free) {
-            kfree(buffer_to_free);
+
+/* Reclaims at most @budget sent buffers of @pair; returns how many */
+static int vnet_tx_reap(struct vnet_pair *pair, int budget) {
+    struct virtqueue *tx_queue = &pair->tx;
+    struct virtq_desc chain[VNET_TX_MAX_FRAGS];
+    uint16_t links;
+    uint32_t len;
+    int reaped = 0;
+
+    // Other cores transmit on this pair: work from a copy of the chain,
+    // its descriptors may be reused the moment they are popped
+    while (reaped < budget &&
+           virtqueue_pop_used_chain(tx_queue, &len, chain, VNET_TX_MAX_FRAGS, &links) != -1) {
+
+        // 1. Free every buffer of the frame (DMA zone, sized by its descriptor):
+        // the one descriptor, its indirect table, or the chain
+        if (chain[0].flags & VIRTQ_DESC_F_INDIRECT) {
+            // Entries keep addr and len first in either ring layout; the
+            // table stays ours until vnet_indir_put()
+            struct virtq_desc *table = dma_from_bus(chain[0].addr);
+            uint32_t n = chain[0].len / sizeof(struct virtq_desc);
+
+            for (uint32_t i = 0; i < n; i++)
+                dma_free(dma_from_bus(table[i].addr), table[i].len);
+            vnet_indir_put(pair, table);
+        } else {
+            for (uint16_t i = 0; i < links; i++) {
+                // 2. Safety check: Don't free NULL or obvious garbage
+                if (chain[i].addr)
+                    dma_free(dma_from_bus(chain[i].addr), chain[i].len);
+            }
         }
+
+        stat_dec(&pair->tx_inflight);
         
         // 3. Update Ankana's stats
         // We decrement usage because the buffer is back in the heap
-        if (global_net_stats.buffer_usage > 0) {
-            global_net_stats.buffer_usage--;
+        if (atomic_read(&global_net_stats.buffer_usage) > 0) {
+            stat_dec(&global_net_stats.buffer_usage);
         }
         
         // Increment total TX count for Roheet's WebUI
-        global_net_stats.tx_packets++;
+        stat_inc(&global_net_stats.tx_packets);
+        reaped++;
+    }
+
+    return reaped;
+}
+
+/**
+ * net_tx_reaper: Reclaims memory after packets are sent.
+ * Runs as a scheduler poller on pair 0 when it has no vector; reclaims
+ * at most @budget buffers and returns how many it freed.
+ */
+int net_tx_reaper(int budget) {
+    return vnet_tx_reap(&vnet_pairs[0], budget);
+}
+
+
+/* ============================================
+   Ring Benchmark
+   ============================================ */
+
+uint32_t virtio_net_bench(uint32_t frames, char *out, uint32_t out_size)
+{
+    struct vnet_pair *pair = &vnet_pairs[smp_processor_id() % vnet_active_pairs];
+    const char *layout = (vnet_features & VIRTIO_F_RING_PACKED) ?
+                         ((vnet_features & VIRTIO_F_IN_ORDER) ? "packed in-order" : "packed") : "split";
+    uint32_t sent = 0;
+    uint32_t total = sizeof(struct virtio_net_hdr) + BENCH_FRAME_LEN;
+
+    if (!pair->vdev)
+        return ksnprintf(out, out_size, "bench: no device\n");
+
+    uint64_t start = timer_get_ns();
+    uint64_t progress = start;
+
+    while (sent < frames) {
+        uint8_t *buf = dma_alloc(total, DMA_STREAMING);
+        if (!buf)
+            break;
+
+        /* Broadcast, local experimental EtherType: dropped by any receiver */
+        memset(buf, 0, total);
+        uint8_t *eth = buf + sizeof(struct virtio_net_hdr);
+        memset(eth, 0xFF, 6);
+        memcpy(eth + 6, aether_mac, 6);
+        eth[12] = 0x88;
+        eth[13] = 0xB5;
+        dma_sync_for_device(buf, total);
+
+        if (virtio_net_xmit(buf, total, 0) < 0) {
+            dma_free(buf, total);
+
+            /* Ring full: reap, and stop if the device has stopped */
+            if (vnet_tx_reap(pair, napi_weight))
+                progress = timer_get_ns();
+            else if (timer_get_ns() - progress > BENCH_STALL_NS)
+                break;
+            continue;
+        }
+
+        sent++;
     }
+
+    /* Until the device has used every frame we gave it */
+    while (pair->tx.num_free < pair->tx.size) {
+        if (vnet_tx_reap(pair, napi_weight))
+            progress = timer_get_ns();
+        else if (timer_get_ns() - progress > BENCH_STALL_NS)
+            break;
+    }
+
+    uint64_t elapsed_us = (timer_get_ns() - start) / 1000;
+    if (!elapsed_us)
+        elapsed_us = 1;
+
+    return ksnprintf(out, out_size, "bench: %s ring, %u frames in %u us, %u pps\n",
+                     (char *)layout, sent, (unsigned int)elapsed_us,
+                     (unsigned int)((uint64_t)sent * 1000000 / elapsed_us));
 }
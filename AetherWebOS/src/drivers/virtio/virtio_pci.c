@@ -2,6 +2,7 @@
 #include "drivers/virtio/virtio_net.h"
 #include "drivers/pcie.h"
 #include "kernel/memory.h"
+#include "kernel/klog.h"
 #include "common/io.h"
 #include "uart.h"
 #include "utils.h"
@@ -86,10 +87,21 @@ void virtio_pci_init(uint32_t bus, uint32_t dev, uint32_t func) {
 
     vdev->bus = bus; vdev->dev = dev; vdev->func = func;
     vdev->common = NULL; vdev->device = NULL; vdev->isr = NULL; vdev->notify_base = NULL;
+    vdev->rx_vq = NULL; vdev->tx_vq = NULL;
+    vdev->msix_ready = 0;
+    vdev->rx_lpi = -1; vdev->tx_lpi = -1;
 
     // Walk the capabilities to map Common, Notify, ISR, and Device regions
     virtio_pci_cap_lookup(vdev);
 
+    // MSI-X on, all vectors masked until a queue claims one
+    if (pci_msix_init(&vdev->msix, bus, dev, func) == 0) {
+        pci_msix_enable(&vdev->msix);
+        vdev->msix_ready = 1;
+    } else {
+        uart_puts("[INFO] VirtIO: No MSI-X/ITS, queues will be polled.\r\n");
+    }
+
     if (vdev->common && vdev->device) {
         // ASSIGNMENT: Bridge the live hardware to the Portal/WebUI
         global_vnet_dev = vdev;
@@ -122,4 +134,34 @@ void virtio_pci_reset(struct virtio_pci_device *vdev) {
     }
 
     uart_puts("[OK] VirtIO Device Parked.\r\n");
-}
\ No newline at end of file
+}
+
+/**
+ * virtio_pci_queue_vector: MSI-X vector for one virtqueue
+ */
+int virtio_pci_queue_vector(struct virtio_pci_device *vdev, uint16_t queue_index,
+                            uint16_t vec, uint32_t cpu, irq_handler_t handler,
+                            void *ctx, const char *name)
+{
+    if (!vdev->msix_ready)
+        return -1;
+
+    int lpi = pci_msix_request(&vdev->msix, vec, cpu, handler, 0, ctx, name);
+    if (lpi < 0)
+        return -1;
+
+    vdev->common->queue_select = queue_index;
+    vdev->common->queue_msix_vector = vec;
+
+    // The device answers NO_VECTOR if it could not allocate the vector
+    if (vdev->common->queue_msix_vector != vec) {
+        pci_msix_mask(&vdev->msix, vec, 1);
+        free_irq(lpi);
+        klog_warn(KLOG_SUB_VIRTIO, "queue %u refused MSI-X vector %u", queue_index, vec);
+        return -1;
+    }
+
+    klog_info(KLOG_SUB_VIRTIO, "queue %u -> vector %u (LPI %u, CPU%u)",
+              queue_index, vec, lpi, cpu);
+    return lpi;
+}
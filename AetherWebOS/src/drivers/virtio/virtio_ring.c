@@ -3,14 +3,21 @@
 #include "drivers/virtio/virtio_net.h"
 #include "kernel/health.h"
 #include "kernel/memory.h"
+#include "kernel/dma.h"
 #include "drivers/uart.h"
 #include "utils.h"
 
-/**
- * get_phys: Identity mapping helper for Aether OS
- */
-static uint64_t get_phys(void* virt) {
-    return (uint64_t)virt; 
+/* ==========================================================================
+   virtqueue_ring_bytes: Device-visible memory a ring of @size needs
+   ========================================================================== */
+size_t virtqueue_ring_bytes(uint16_t size, int packed) {
+    if (packed)
+        return sizeof(struct vring_packed_desc) * size + 2 * sizeof(struct vring_packed_desc_event);
+
+    // Same layout virtqueue_init() carves: desc, avail (+used_event), used (+avail_event)
+    size_t bytes = sizeof(struct virtq_desc) * size + 2 + 2 + sizeof(uint16_t) * size + 2;
+    bytes = (bytes + 3) & ~3;
+    return bytes + 2 + 2 + sizeof(struct virtq_used_elem) * size + 2;
 }
 
 /* ==========================================================================
@@ -60,13 +67,77 @@ void virtqueue_init(struct virtqueue *vq, uint16_t size, uint16_t index, void *p
     }
     vq->desc[size - 1].next = 0xFFFF;
     vq->last_used_idx = 0;
+    vq->avail_idx = 0;
+    vq->packed = 0;
+    vq->fixed = 0;
+    vq->batch_pending = 0;
+
+    spin_lock_init(&vq->lock, (index & 1) ? "virtq_tx" : "virtq_rx");
+}
+
+/* ==========================================================================
+   virtqueue_init_packed: One descriptor ring plus the two event areas
+   ========================================================================== */
+int virtqueue_init_packed(struct virtqueue *vq, uint16_t size, uint16_t index, void *p, int in_order) {
+    uintptr_t base = (uintptr_t)p;
+
+    /* Driver-private: the device only ever sees the ring */
+    struct virtq_desc *shadow = kmalloc(sizeof(struct virtq_desc) * size);
+    uint16_t *order = in_order ? kmalloc(sizeof(uint16_t) * size) : 0;
+
+    if (!shadow || (in_order && !order)) {
+        kfree(shadow);
+        kfree(order);
+        return -1;
+    }
+
+    memset(vq, 0, sizeof(*vq));
+    vq->size = size;
+    vq->queue_index = index;
+    vq->packed = 1;
+    vq->in_order = in_order ? 1 : 0;
+    vq->order = order;
+
+    // Descriptor Ring (16-byte aligned per spec)
+    vq->ring = (struct vring_packed_desc *)base;
+    base += sizeof(struct vring_packed_desc) * size;
+    memset(vq->ring, 0, sizeof(struct vring_packed_desc) * size);
+
+    // Driver and Device Event Suppression (4-byte aligned)
+    vq->driver_event = (struct vring_packed_desc_event *)base;
+    vq->device_event = vq->driver_event + 1;
+    vq->driver_event->off_wrap = 0;
+    vq->driver_event->flags = VRING_PACKED_EVENT_FLAG_ENABLE;
+    vq->device_event->off_wrap = 0;
+    vq->device_event->flags = VRING_PACKED_EVENT_FLAG_ENABLE;
+
+    // Both wrap counters start at 1: a zeroed ring reads as "not available"
+    vq->avail_wrap = 1;
+    vq->used_wrap = 1;
+
+    vq->desc = shadow;
+    vq->free_head = 0;
+    vq->num_free = size;
+
+    for (uint16_t i = 0; i < size - 1; i++) {
+        vq->desc[i].next = i + 1;
+    }
+    vq->desc[size - 1].next = 0xFFFF;
+
+    spin_lock_init(&vq->lock, (index & 1) ? "virtq_tx" : "virtq_rx");
+    return 0;
 }
 
 /* ==========================================================================
    virtqueue_add_descriptor: Grabs a descriptor from the free list
    ========================================================================== */
 uint16_t virtqueue_add_descriptor(struct virtqueue *vq, uint64_t virt_addr, uint32_t len, uint16_t flags) {
-    if (vq->num_free == 0) return 0xFFFF;
+    uint64_t irq_flags = spin_lock_irqsave(&vq->lock);
+
+    if (vq->num_free == 0) {
+        spin_unlock_irqrestore(&vq->lock, irq_flags);
+        return 0xFFFF;
+    }
 
     uint16_t head = vq->free_head;
     struct virtq_desc *desc = &vq->desc[head];
@@ -74,49 +145,238 @@ uint16_t virtqueue_add_descriptor(struct virtqueue *vq, uint64_t virt_addr, uint
     vq->free_head = desc->next;
     vq->num_free--;
 
-    global_net_stats.buffer_usage++; // <--- YOUR HOOK
-
-    desc->addr  = get_phys((void*)virt_addr);
+    desc->addr  = dma_to_bus((void*)virt_addr);
     desc->len   = len;
     desc->flags = flags;
     desc->next  = 0;
 
+    spin_unlock_irqrestore(&vq->lock, irq_flags);
+
+    stat_inc(&global_net_stats.buffer_usage); // <--- YOUR HOOK
+
     return head;
 }
 
 /* ==========================================================================
-   virtqueue_push_available: Publishes descriptor to hardware (Modern PCI)
-   Developer: Roheet Purkayastha (Patched)
+   virtqueue_add_available: Queues a chain; the device sees it on kick
    ========================================================================== */
-void virtqueue_push_available(struct virtio_pci_device *vdev,
-                               struct virtqueue *vq,
-                               uint16_t desc_head)
+
+/* Copy the shadow chain at @head into consecutive ring slots */
+static void packed_add_chain(struct virtqueue *vq, uint16_t head)
 {
-    uint16_t idx = vq->avail->idx;
+    uint16_t d = head;
+
+    for (;;) {
+        struct virtq_desc *src = &vq->desc[d];
+        struct vring_packed_desc *slot = &vq->ring[vq->next_avail];
+        uint16_t flags = (src->flags & (VIRTQ_DESC_F_NEXT | VIRTQ_DESC_F_WRITE | VIRTQ_DESC_F_INDIRECT)) |
+                         (vq->avail_wrap ? VRING_PACKED_DESC_F_AVAIL : VRING_PACKED_DESC_F_USED);
+
+        slot->addr = src->addr;
+        slot->len  = src->len;
+        slot->id   = head;
+
+        /*
+         * The device stops at the first slot that is not available, so
+         * everything behind the batch's first head may be written in any
+         * order; that one flag store publishes the whole batch.
+         */
+        if (vq->batch_pending == 0 && d == head) {
+            vq->batch_slot = vq->next_avail;
+            vq->batch_flags = flags;
+        } else {
+            slot->flags = flags;
+        }
+
+        if (++vq->next_avail == vq->size) {
+            vq->next_avail = 0;
+            vq->avail_wrap ^= 1;
+        }
+
+        if (!(src->flags & VIRTQ_DESC_F_NEXT))
+            break;
+        d = src->next;
+    }
 
-    /* 1. Write descriptor head into avail ring */
-    vq->avail->ring[idx % vq->size] = desc_head;
+    if (vq->in_order) {
+        vq->order[vq->order_tail] = head;
+        if (++vq->order_tail == vq->size)
+            vq->order_tail = 0;
+    }
+}
+
+void virtqueue_add_available(struct virtqueue *vq, uint16_t desc_head)
+{
+    uint64_t flags = spin_lock_irqsave(&vq->lock);
+
+    if (vq->packed) {
+        packed_add_chain(vq, desc_head);
+    } else {
+        vq->avail->ring[vq->avail_idx % vq->size] = desc_head;
+        vq->avail_idx++;
+    }
+
+    vq->batch_pending++;
+    spin_unlock_irqrestore(&vq->lock, flags);
+}
+
+/* ==========================================================================
+   Fixed RX mapping: bind once, recycle by id
+   ========================================================================== */
+void virtqueue_bind_buffer(struct virtqueue *vq, uint16_t id, uint64_t virt_addr, uint32_t len, uint16_t flags)
+{
+    uint64_t irq_flags = spin_lock_irqsave(&vq->lock);
+
+    /* Every descriptor now belongs to the driver's own bookkeeping */
+    if (!vq->fixed) {
+        vq->fixed = 1;
+        vq->free_head = 0xFFFF;
+        vq->num_free = 0;
+    }
+
+    vq->desc[id].addr  = dma_to_bus((void*)virt_addr);
+    vq->desc[id].len   = len;
+    vq->desc[id].flags = flags;
+    vq->desc[id].next  = 0;
+
+    spin_unlock_irqrestore(&vq->lock, irq_flags);
+}
+
+void virtqueue_rx_recycle(struct virtqueue *vq, const uint16_t *ids, uint16_t count)
+{
+    uint64_t flags = spin_lock_irqsave(&vq->lock);
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (vq->packed) {
+            packed_add_chain(vq, ids[i]);
+        } else {
+            vq->avail->ring[vq->avail_idx % vq->size] = ids[i];
+            vq->avail_idx++;
+        }
+        vq->batch_pending++;
+    }
+
+    spin_unlock_irqrestore(&vq->lock, flags);
+}
+
+/* ==========================================================================
+   virtqueue_kick: Publishes every queued chain, then rings the doorbell
+   ========================================================================== */
+uint16_t virtqueue_kick(struct virtio_pci_device *vdev, struct virtqueue *vq)
+{
+    uint64_t flags = spin_lock_irqsave(&vq->lock);
+    uint16_t published = vq->batch_pending;
+
+    if (!published) {
+        spin_unlock_irqrestore(&vq->lock, flags);
+        return 0;
+    }
 
     /*
-     * 2. Ensure descriptor table + ring entry
-     *    are globally visible before updating idx
+     * 1. Ensure descriptors + ring entries
+     *    are globally visible before publishing
      */
     asm volatile("dsb st" ::: "memory");
 
-    /* 3. Publish new available index */
-    vq->avail->idx = idx + 1;
+    /* 2. Publish: one index store (split) or one flag store (packed) */
+    if (vq->packed)
+        *(volatile uint16_t *)&vq->ring[vq->batch_slot].flags = vq->batch_flags;
+    else
+        vq->avail->idx = vq->avail_idx;
+
+    vq->batch_pending = 0;
 
     /*
-     * 4. FULL barrier before notifying device
-     *    Ensures idx write reaches memory before MMIO notify
+     * 3. FULL barrier before notifying device
+     *    Ensures the publish reaches memory before MMIO notify
      */
     asm volatile("dsb sy" ::: "memory");
 
-    /* 5. Ring the doorbell */
+    spin_unlock_irqrestore(&vq->lock, flags);
+
+    /* 4. Ring the doorbell */
     virtqueue_notify(vdev, vq->queue_index);
+    return published;
+}
+
+/* ==========================================================================
+   virtqueue_push_available: Publishes descriptor to hardware (Modern PCI)
+   Developer: Roheet Purkayastha (Patched)
+   ========================================================================== */
+void virtqueue_push_available(struct virtio_pci_device *vdev,
+                               struct virtqueue *vq,
+                               uint16_t desc_head)
+{
+    virtqueue_add_available(vq, desc_head);
+    virtqueue_kick(vdev, vq);
 }
 
 
+/* ==========================================================================
+   Multi-buffer frames: chained or indirect
+   ========================================================================== */
+uint16_t virtqueue_add_chain(struct virtqueue *vq, const uint64_t *addrs, const uint32_t *lens, uint16_t n)
+{
+    uint64_t irq_flags = spin_lock_irqsave(&vq->lock);
+
+    if (n == 0 || vq->num_free < n) {
+        spin_unlock_irqrestore(&vq->lock, irq_flags);
+        return 0xFFFF;
+    }
+
+    uint16_t head = vq->free_head;
+    uint16_t d = head;
+
+    for (uint16_t i = 0; i < n; i++) {
+        struct virtq_desc *desc = &vq->desc[d];
+
+        desc->addr  = dma_to_bus((void*)addrs[i]);
+        desc->len   = lens[i];
+        desc->flags = (i + 1 < n) ? VIRTQ_DESC_F_NEXT : 0;
+
+        /* Free descriptors are already linked: keep the links */
+        if (i + 1 < n)
+            d = desc->next;
+    }
+
+    vq->free_head = vq->desc[d].next;
+    vq->desc[d].next = 0;
+    vq->num_free -= n;
+
+    spin_unlock_irqrestore(&vq->lock, irq_flags);
+
+    stat_add(&global_net_stats.buffer_usage, n);
+    return head;
+}
+
+uint16_t virtqueue_add_indirect(struct virtqueue *vq, void *table,
+                                const uint64_t *addrs, const uint32_t *lens, uint16_t n)
+{
+    /* Same 16 bytes per entry, different field order */
+    if (vq->packed) {
+        struct vring_packed_desc *t = table;
+
+        for (uint16_t i = 0; i < n; i++) {
+            t[i].addr  = dma_to_bus((void*)addrs[i]);
+            t[i].len   = lens[i];
+            t[i].id    = 0;
+            t[i].flags = 0;
+        }
+    } else {
+        struct virtq_desc *t = table;
+
+        for (uint16_t i = 0; i < n; i++) {
+            t[i].addr  = dma_to_bus((void*)addrs[i]);
+            t[i].len   = lens[i];
+            t[i].flags = (i + 1 < n) ? VIRTQ_DESC_F_NEXT : 0;
+            t[i].next  = i + 1;
+        }
+    }
+
+    return virtqueue_add_descriptor(vq, (uint64_t)table, n * sizeof(struct virtq_desc),
+                                    VIRTQ_DESC_F_INDIRECT);
+}
+
 /* ==========================================================================
    virtio_pci_bind_queue: Registers the rings with the PCI device (FIXED)
    Developer: Pritam Mondal (Patched)
@@ -137,10 +397,10 @@ void virtio_pci_bind_queue(struct virtio_pci_device *vdev,
     /* Ensure size write completes */
     asm volatile("dsb sy" ::: "memory");
 
-    /* 3. Program physical addresses */
-    uint64_t desc_phys  = get_phys(vq->desc);
-    uint64_t avail_phys = get_phys(vq->avail);
-    uint64_t used_phys  = get_phys(vq->used);
+    /* 3. Program physical addresses (packed: ring, driver and device areas) */
+    uint64_t desc_phys  = dma_to_bus(vq->packed ? (void *)vq->ring : (void *)vq->desc);
+    uint64_t avail_phys = dma_to_bus(vq->packed ? (void *)vq->driver_event : (void *)vq->avail);
+    uint64_t used_phys  = dma_to_bus(vq->packed ? (void *)vq->device_event : (void *)vq->used);
 
     vdev->common->queue_desc_lo = (uint32_t)(desc_phys & 0xFFFFFFFF);
     vdev->common->queue_desc_hi = (uint32_t)(desc_phys >> 32);
@@ -165,40 +425,179 @@ void virtio_pci_bind_queue(struct virtio_pci_device *vdev,
    Developer: Adrija Ghosh
    ========================================================================== */
 
+/* Packed: is the slot at last_used_idx a used descriptor of this lap? */
+static int packed_slot_used(struct virtqueue *vq)
+{
+    uint16_t flags = *(volatile uint16_t *)&vq->ring[vq->last_used_idx].flags;
+    int avail = !!(flags & VRING_PACKED_DESC_F_AVAIL);
+    int used  = !!(flags & VRING_PACKED_DESC_F_USED);
+
+    return avail == used && used == vq->used_wrap;
+}
+
+/*
+ * Packed: the next completed chain, or 0xFFFF. Out of order every chain
+ * gets its own used slot; in order, one slot may stand for a batch that
+ * ends with @used_last_id, and the buffers before it were used in full.
+ */
+static uint16_t packed_pop(struct virtqueue *vq, uint32_t *len)
+{
+    uint16_t id;
+
+    if (!vq->used_batch) {
+        if (!packed_slot_used(vq))
+            return 0xFFFF;
+
+        // Memory Barrier: flags before the rest of the slot
+        asm volatile("dmb ish" : : : "memory");
+
+        vq->used_last_id  = vq->ring[vq->last_used_idx].id;
+        vq->used_last_len = vq->ring[vq->last_used_idx].len;
+        vq->used_batch = 1;
+    }
+
+    if (vq->in_order) {
+        id = vq->order[vq->order_head];
+        if (++vq->order_head == vq->size)
+            vq->order_head = 0;
+        *len = (id == vq->used_last_id) ? vq->used_last_len : vq->desc[id].len;
+    } else {
+        id = vq->used_last_id;
+        *len = vq->used_last_len;
+    }
+
+    if (id == vq->used_last_id)
+        vq->used_batch = 0;
+
+    return id;
+}
+
 int virtqueue_pop_used(struct virtqueue *vq, uint32_t *len_out) {
+    return virtqueue_pop_used_chain(vq, len_out, NULL, 0, NULL);
+}
+
+int virtqueue_pop_used_chain(struct virtqueue *vq, uint32_t *len_out,
+                             struct virtq_desc *chain_out, uint16_t max, uint16_t *count_out) {
     // 'dsb sy' ensures all previous memory instructions are complete across the whole system
     __asm__ volatile("dsb sy" : : : "memory");
-    // 1. Check if hardware has processed anything
-    if (vq->last_used_idx == *(volatile uint16_t *)&vq->used->idx) {
-        return -1; 
-    }
 
-    // Memory Barrier: Ensure we see what the hardware wrote
-    asm volatile("dmb ish" : : : "memory");
+    uint64_t flags = spin_lock_irqsave(&vq->lock);
+    uint16_t desc_id;
+    uint32_t len;
+
+    if (vq->packed) {
+        desc_id = packed_pop(vq, &len);
+        if (desc_id == 0xFFFF) {
+            spin_unlock_irqrestore(&vq->lock, flags);
+            return -1;
+        }
+    } else {
+        // 1. Check if hardware has processed anything
+        if (vq->last_used_idx == *(volatile uint16_t *)&vq->used->idx) {
+            spin_unlock_irqrestore(&vq->lock, flags);
+            return -1; 
+        }
+
+        // Memory Barrier: Ensure we see what the hardware wrote
+        asm volatile("dmb ish" : : : "memory");
+
+        // 2. Grab the "receipt" from the hardware
+        struct virtq_used_elem *receipt = &vq->used->ring[vq->last_used_idx % vq->size];
+        desc_id = (uint16_t)receipt->id;
+        len = receipt->len;
+    }
 
-    // 2. Grab the "receipt" from the hardware
-    struct virtq_used_elem *receipt = &vq->used->ring[vq->last_used_idx % vq->size];
-    uint16_t desc_id = (uint16_t)receipt->id;
-    
     if (len_out) {
-        *len_out = receipt->len; 
+        *len_out = len; 
     }
 
-    // 3. YOUR TELEMETRY HOOKS
-    global_net_stats.buffer_usage--; 
-    
-    // Logic to distinguish RX (usually queue 0) from TX (usually queue 1)
-    if (vq->queue_index == 0) {
-        global_net_stats.rx_packets++;
-    } else if (vq->queue_index == 1) {
-        global_net_stats.tx_packets++;
+    /* Bound descriptors stay with their buffer: nothing to free */
+    if (vq->fixed) {
+        if (count_out)
+            *count_out = 0;
+        if (vq->packed) {
+            if (++vq->last_used_idx == vq->size) {
+                vq->last_used_idx = 0;
+                vq->used_wrap ^= 1;
+            }
+        } else {
+            vq->last_used_idx++;
+        }
+
+        spin_unlock_irqrestore(&vq->lock, flags);
+        return (int)desc_id;
     }
 
-    // 4. Move counter and recycle the descriptor back to the free list
-    vq->last_used_idx++;
-    vq->desc[desc_id].next = vq->free_head;
+    // 3. Move counter and recycle the whole chain back to the free list,
+    // copying it out first: once the lock drops, any core may reuse it
+    uint16_t tail = desc_id;
+    uint16_t chain = 1;
+
+    if (chain_out && max)
+        chain_out[0] = vq->desc[tail];
+
+    while (vq->desc[tail].flags & VIRTQ_DESC_F_NEXT) {
+        tail = vq->desc[tail].next;
+        if (chain_out && chain < max)
+            chain_out[chain] = vq->desc[tail];
+        chain++;
+    }
+
+    if (count_out)
+        *count_out = chain < max ? chain : max;
+
+    if (vq->packed) {
+        /* The chain occupied @chain slots; the next used one follows them */
+        vq->last_used_idx += chain;
+        if (vq->last_used_idx >= vq->size) {
+            vq->last_used_idx -= vq->size;
+            vq->used_wrap ^= 1;
+        }
+    } else {
+        vq->last_used_idx++;
+    }
+
+    vq->desc[tail].next = vq->free_head;
     vq->free_head = desc_id;
-    vq->num_free++;
+    vq->num_free += chain;
+
+    spin_unlock_irqrestore(&vq->lock, flags);
+
+    // 4. YOUR TELEMETRY HOOKS
+    // Frames are counted by the driver: with several queue pairs (and a
+    // control queue) the index no longer says RX or TX
+    stat_add(&global_net_stats.buffer_usage, -(unsigned long)chain);
 
     return (int)desc_id;
-}
\ No newline at end of file
+}
+
+/* ==========================================================================
+   Interrupt suppression (NAPI)
+   ========================================================================== */
+
+int virtqueue_has_used(struct virtqueue *vq) {
+    __asm__ volatile("dsb sy" : : : "memory");
+
+    if (vq->packed)
+        return vq->used_batch || packed_slot_used(vq);
+
+    return vq->last_used_idx != *(volatile uint16_t *)&vq->used->idx;
+}
+
+void virtqueue_disable_cb(struct virtqueue *vq) {
+    /* Only a hint: the device may still interrupt once more */
+    if (vq->packed)
+        *(volatile uint16_t *)&vq->driver_event->flags = VRING_PACKED_EVENT_FLAG_DISABLE;
+    else
+        *(volatile uint16_t *)&vq->avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+}
+
+int virtqueue_enable_cb(struct virtqueue *vq) {
+    if (vq->packed)
+        *(volatile uint16_t *)&vq->driver_event->flags = VRING_PACKED_EVENT_FLAG_ENABLE;
+    else
+        *(volatile uint16_t *)&vq->avail->flags &= ~VRING_AVAIL_F_NO_INTERRUPT;
+
+    /* Flag store before the used check, or a completion in between is lost */
+    return virtqueue_has_used(vq);
+}
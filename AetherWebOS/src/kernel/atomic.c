@@ -0,0 +1,20 @@
+#include "kernel/atomic.h"
+#include "drivers/uart.h"
+
+/* Read on every atomic op: keep it in its own line, written once at boot */
+int cpu_has_lse __attribute__((aligned(64))) = 0;
+
+/**
+ * atomic_init: ID_AA64ISAR0_EL1.Atomic [23:20] >= 2 means the
+ * ARMv8.1 LSE instructions are implemented.
+ */
+void atomic_init(void)
+{
+    uint64_t isar0;
+    asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+    cpu_has_lse = ((isar0 >> 20) & 0xF) >= 2;
+
+    uart_puts(cpu_has_lse ? "[OK] Atomics: ARMv8.1 LSE.\r\n"
+                          : "[OK] Atomics: LDXR/STXR fallback.\r\n");
+}
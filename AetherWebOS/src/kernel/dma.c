@@ -0,0 +1,298 @@
+#include "kernel/dma.h"
+#include "kernel/mmu.h"
+#include "kernel/spinlock.h"
+#include "uart.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Arenas
+   ===================================================== */
+
+#define DMA_ZONE_PAGES      (DMA_ZONE_SIZE / PAGE_SIZE)
+#define DMA_NR_CLASSES      6           /* 64, 128, ... DMA_SMALL_MAX */
+
+_Static_assert((DMA_ALIGN << (DMA_NR_CLASSES - 1)) == DMA_SMALL_MAX, "size classes");
+_Static_assert(DMA_COHERENT_SIZE % 0x200000 == 0 && DMA_ZONE_START % 0x200000 == 0,
+               "arenas are retyped in 2MB blocks");
+
+struct dma_arena {
+    const char  *name;
+    uintptr_t    base;
+    uint32_t     pages;
+    uint32_t     hint;                  /* No free page below this one */
+    uint8_t      map[DMA_ZONE_PAGES / 8];   /* Bit set: page in use */
+    void        *classes[DMA_NR_CLASSES];   /* Free objects, linked through themselves */
+    spinlock_t   lock;
+    dma_stats_t  stats;
+};
+
+static struct dma_arena dma_arenas[2];     /* Indexed by DMA_STREAMING */
+
+static inline struct dma_arena *dma_arena_of(uint32_t flags)
+{
+    return &dma_arenas[flags & DMA_STREAMING];
+}
+
+static inline int dma_page_busy(struct dma_arena *a, uint32_t pg)
+{
+    return a->map[pg / 8] & (1 << (pg % 8));
+}
+
+static void dma_mark(struct dma_arena *a, uint32_t first, uint32_t n, int busy)
+{
+    for (uint32_t pg = first; pg < first + n; pg++) {
+        if (busy)
+            a->map[pg / 8] |= 1 << (pg % 8);
+        else
+            a->map[pg / 8] &= ~(1 << (pg % 8));
+    }
+}
+
+/* First fit from the hint; caller holds the lock */
+static void *dma_pages_alloc(struct dma_arena *a, uint32_t n)
+{
+    uint32_t run = 0;
+
+    for (uint32_t pg = a->hint; pg < a->pages; pg++) {
+        if (dma_page_busy(a, pg)) {
+            run = 0;
+            continue;
+        }
+
+        if (++run == n) {
+            uint32_t first = pg + 1 - n;
+
+            dma_mark(a, first, n, 1);
+            if (first == a->hint)
+                a->hint = pg + 1;
+            a->stats.pages_used += n;
+            return (void *)(a->base + (uintptr_t)first * PAGE_SIZE);
+        }
+    }
+
+    return NULL;
+}
+
+/* Every page of the run must be one dma_pages_alloc() handed out */
+static int dma_pages_free(struct dma_arena *a, void *ptr, uint32_t n)
+{
+    uintptr_t off = (uintptr_t)ptr - a->base;
+    uint32_t first = off / PAGE_SIZE;
+
+    if (off % PAGE_SIZE || first + n > a->pages)
+        return -1;
+
+    for (uint32_t pg = first; pg < first + n; pg++)
+        if (!dma_page_busy(a, pg))
+            return -1;
+
+    dma_mark(a, first, n, 0);
+    if (first < a->hint)
+        a->hint = first;
+    a->stats.pages_used -= n;
+    return 0;
+}
+
+/* Smallest class that holds @size */
+static uint32_t dma_class(size_t size)
+{
+    uint32_t c = 0;
+
+    while ((size_t)DMA_ALIGN << c < size)
+        c++;
+
+    return c;
+}
+
+/* An empty class takes a fresh page and splits it; caller holds the lock */
+static void *dma_class_alloc(struct dma_arena *a, uint32_t c)
+{
+    uint32_t obj = DMA_ALIGN << c;
+    uint8_t *p = a->classes[c];
+
+    if (p) {
+        a->classes[c] = *(void **)p;
+        return p;
+    }
+
+    p = dma_pages_alloc(a, 1);
+    if (!p)
+        return NULL;
+
+    /* Carved pages stay with their class */
+    for (uint32_t off = PAGE_SIZE - obj; off >= obj; off -= obj) {
+        *(void **)(p + off) = a->classes[c];
+        a->classes[c] = p + off;
+    }
+
+    return p;
+}
+
+static void dma_arena_init(struct dma_arena *a, const char *name, uintptr_t base, size_t size)
+{
+    memset(a, 0, sizeof(*a));
+    a->name = name;
+    a->base = base;
+    a->pages = size / PAGE_SIZE;
+    a->stats.pages = a->pages;
+    spin_lock_init(&a->lock, name);
+}
+
+void dma_init(void)
+{
+    /*
+     * Nothing may be left in a cache over memory that turns uncached, or
+     * a late eviction would overwrite device writes; the retype flushes.
+     */
+    mmu_set_ram_attrs(DMA_ZONE_START, DMA_COHERENT_SIZE, MM_ATTR_NORMAL_INDEX);
+
+    dma_arena_init(&dma_arenas[DMA_COHERENT], "dma_coherent",
+                   DMA_ZONE_START, DMA_COHERENT_SIZE);
+    dma_arena_init(&dma_arenas[DMA_STREAMING], "dma_streaming",
+                   DMA_ZONE_START + DMA_COHERENT_SIZE, DMA_ZONE_SIZE - DMA_COHERENT_SIZE);
+
+    uart_puts("[OK] DMA Zone: ");
+    uart_put_int(DMA_COHERENT_SIZE >> 20);
+    uart_puts(" MB coherent + ");
+    uart_put_int((DMA_ZONE_SIZE - DMA_COHERENT_SIZE) >> 20);
+    uart_puts(" MB streaming.\r\n");
+}
+
+/* =====================================================
+   Allocation
+   ===================================================== */
+
+void *dma_alloc(size_t size, uint32_t flags)
+{
+    struct dma_arena *a = dma_arena_of(flags);
+    void *p;
+
+    if (!size)
+        return NULL;
+
+    uint64_t irq = spin_lock_irqsave(&a->lock);
+
+    if (size <= DMA_SMALL_MAX)
+        p = dma_class_alloc(a, dma_class(size));
+    else
+        p = dma_pages_alloc(a, (size + PAGE_SIZE - 1) / PAGE_SIZE);
+
+    if (p)
+        a->stats.allocs++;
+    else
+        a->stats.failures++;
+
+    spin_unlock_irqrestore(&a->lock, irq);
+
+    if (!p) {
+        uart_puts("[ERROR] dma_alloc: ");
+        uart_puts(a->name);
+        uart_puts(" exhausted!\r\n");
+        return NULL;
+    }
+
+    if (flags & DMA_ZERO)
+        memset(p, 0, size);
+
+    return p;
+}
+
+void dma_free(void *ptr, size_t size)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+    int ret = 0;
+
+    if (!ptr)
+        return;
+
+    if (addr < DMA_ZONE_START || addr >= DMA_ZONE_START + DMA_ZONE_SIZE) {
+        uart_puts("[WARN] dma_free: pointer outside the DMA zone!\r\n");
+        return;
+    }
+
+    struct dma_arena *a = &dma_arenas[addr >= dma_arenas[DMA_STREAMING].base];
+    uint64_t irq = spin_lock_irqsave(&a->lock);
+
+    if (size <= DMA_SMALL_MAX) {
+        uint32_t c = dma_class(size ? size : 1);
+
+        /* Objects sit at multiples of their size inside a carved page */
+        if (((addr - a->base) % ((uint32_t)DMA_ALIGN << c)) ||
+            !dma_page_busy(a, (addr - a->base) / PAGE_SIZE)) {
+            ret = -1;
+        } else {
+            *(void **)ptr = a->classes[c];
+            a->classes[c] = ptr;
+        }
+    } else {
+        ret = dma_pages_free(a, ptr, (size + PAGE_SIZE - 1) / PAGE_SIZE);
+    }
+
+    if (!ret)
+        a->stats.frees++;
+    spin_unlock_irqrestore(&a->lock, irq);
+
+    if (ret < 0) {
+        uart_puts("[WARN] dma_free: ");
+        uart_puts(a->name);
+        uart_puts(" pages not allocated with that size!\r\n");
+    }
+}
+
+/* =====================================================
+   Streaming Ownership
+   ===================================================== */
+
+static inline int dma_is_streaming(const void *ptr)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+
+    return addr >= DMA_ZONE_START + DMA_COHERENT_SIZE && addr < DMA_ZONE_START + DMA_ZONE_SIZE;
+}
+
+/* CPU writes must reach RAM before the device reads it */
+void dma_sync_for_device(const void *ptr, size_t size)
+{
+    if (size && dma_is_streaming(ptr))
+        clean_cache_range((uintptr_t)ptr, (uintptr_t)ptr + size);
+}
+
+/* Drop lines the CPU may still hold, so it reads what the device wrote */
+void dma_sync_for_cpu(const void *ptr, size_t size)
+{
+    if (!size || !dma_is_streaming(ptr))
+        return;
+
+    uintptr_t addr = (uintptr_t)ptr & ~(uintptr_t)(DMA_ALIGN - 1);
+
+    for (; addr < (uintptr_t)ptr + size; addr += DMA_ALIGN)
+        asm volatile("dc civac, %0" : : "r" (addr) : "memory");
+    asm volatile("dsb sy" ::: "memory");
+}
+
+/* =====================================================
+   Stats
+   ===================================================== */
+
+void dma_get_stats(uint32_t flags, dma_stats_t *out)
+{
+    *out = dma_arena_of(flags)->stats;
+}
+
+uint32_t dma_format(char *out, uint32_t out_size)
+{
+    uint32_t pos = ksnprintf(out, out_size,
+                             "arena  base_mb  pages  used  allocs  frees  failures\n");
+
+    for (int i = 0; i < 2 && pos + 1 < out_size; i++) {
+        struct dma_arena *a = &dma_arenas[i];
+
+        pos += ksnprintf(out + pos, out_size - pos, "%s  %u  %u  %u  %u  %u  %u\n",
+                         (char *)(i == DMA_STREAMING ? "streaming" : "coherent"),
+                         (unsigned int)(a->base >> 20), a->stats.pages, a->stats.pages_used,
+                         (unsigned int)a->stats.allocs, (unsigned int)a->stats.frees,
+                         (unsigned int)a->stats.failures);
+    }
+
+    return pos;
+}
@@ -2,13 +2,15 @@
 #include "utils.h"
 #include "gic.h"
 #include "config.h"
-#include "timer.h"
+#include "kernel/smp.h"
+#include "kernel/irq.h"
 
 typedef struct {
     uint64_t x[31]; 
 } trap_frame_t;
 
 void handle_sync_exception(uint64_t esr, uint64_t elr, uint64_t far, trap_frame_t *frame) {
+    uart_console_sync(); // IRQs are masked from here on: no TX interrupt to drain the ring
     uart_puts("\r\n--- [!!!] KERNEL PANIC: SYNCHRONOUS ABORT [!!!] ---\r\n");
 
     uint32_t ec = (esr >> 26) & 0x3F;
@@ -17,6 +19,7 @@ void handle_sync_exception(uint64_t esr, uint64_t elr, uint64_t far, trap_frame_
     uart_puts("Condition: ");
     switch(ec) {
         case 0x00: uart_puts("Unknown/Undefined Instruction"); break;
+        case 0x07: uart_puts("FP/SIMD Access Trap (missing kernel_neon_begin?)"); break;
         case 0x21: uart_puts("Instruction Abort (Lower EL)"); break;
         case 0x25: 
             uart_puts("Data Abort (EL1)"); 
@@ -64,12 +67,20 @@ void handle_irq_exception(uint64_t esr, uint64_t elr, uint64_t far, trap_frame_t
     asm volatile("isb"); // Ensure the read is synchronized
 #endif
 
+#ifdef BOARD_RPI4
     uint32_t irq_id = iar & 0x3FF;
+#else
+    uint32_t irq_id = iar & 0xFFFFFF;   // 24-bit INTIDs: LPIs start at 8192
+#endif
 
-    if (irq_id == TIMER_IRQ_ID) {
-        handle_timer_irq();
-    } 
-    // ... rest of logic ...
+    /* Nothing pending any more (raced with another core or a mask): no EOI */
+    if (irq_id == GIC_SPURIOUS_ID) {
+        irq_note_spurious();
+        return;
+    }
+
+    this_cpu()->irqs++;
+    irq_dispatch(irq_id);
 
 #ifdef BOARD_RPI4
     GICC_EOIR = iar;
@@ -78,4 +89,4 @@ void handle_irq_exception(uint64_t esr, uint64_t elr, uint64_t far, trap_frame_t
     asm volatile("msr ICC_EOIR1_EL1, %0" : : "r" (iar));
     asm volatile("isb");
 #endif
-}
\ No newline at end of file
+}
@@ -0,0 +1,403 @@
+#include "kernel/fiber.h"
+#include "kernel/sched.h"
+#include "kernel/smp.h"
+#include "kernel/spinlock.h"
+#include "kernel/atomic.h"
+#include "kernel/irqflags.h"
+#include "kernel/timer.h"
+#include "kernel/klog.h"
+#include "kernel/ipi.h"
+#include "drivers/uart.h"
+#include "common/utils.h"
+
+/* arch/aarch64/fiber_switch.S */
+extern void fiber_switch(struct fiber_ctx *from, const struct fiber_ctx *to);
+extern void fiber_trampoline(void);
+
+#define FIBER_CANARY    0x46494245524f4b21ULL   /* "FIBEROK!" */
+
+enum { CTX_X19 = 0, CTX_FP = 10, CTX_LR = 11, CTX_SP = 12 };
+
+/* =====================================================
+   Pool & Per-CPU Run Queues
+   ===================================================== */
+
+struct fiber_rq {
+    struct fiber        *current;
+    struct fiber        *ready_head;
+    struct fiber        *ready_tail;
+    struct fiber_ctx     sched_ctx;         /* The poller we return to */
+    struct sched_poller  poller;
+    struct sched_work    init_work;         /* Brings up a secondary's rq */
+    uint8_t              online;
+} __attribute__((aligned(64)));
+
+static struct fiber_rq fiber_rqs[MAX_CPUS];
+
+static struct fiber fibers[FIBER_MAX];
+static uint64_t fiber_stacks[FIBER_MAX][FIBER_STACK_SIZE / 8] __attribute__((aligned(16)));
+
+static struct fiber *fiber_free_list;
+static spinlock_t fiber_pool_lock;
+static fiber_stats_t fiber_stats;
+static uint8_t fiber_pool_ready;
+
+static inline struct fiber_rq *this_rq(void)
+{
+    return &fiber_rqs[smp_processor_id()];
+}
+
+struct fiber *fiber_current(void)
+{
+    return this_rq()->current;
+}
+
+int fiber_has_ready(void)
+{
+    return this_rq()->ready_head != 0;
+}
+
+/* IRQs masked by the caller */
+static void rq_enqueue(struct fiber_rq *rq, struct fiber *f)
+{
+    f->state = FIBER_READY;
+    f->next = 0;
+
+    if (rq->ready_tail)
+        rq->ready_tail->next = f;
+    else
+        rq->ready_head = f;
+    rq->ready_tail = f;
+}
+
+static struct fiber *rq_dequeue(struct fiber_rq *rq)
+{
+    struct fiber *f = rq->ready_head;
+
+    if (f) {
+        rq->ready_head = f->next;
+        if (!rq->ready_head)
+            rq->ready_tail = 0;
+        f->next = 0;
+    }
+
+    return f;
+}
+
+static void fiber_release(struct fiber *f)
+{
+    uint64_t flags = spin_lock_irqsave(&fiber_pool_lock);
+
+    f->state = FIBER_FREE;
+    f->next = fiber_free_list;
+    fiber_free_list = f;
+    fiber_stats.live--;
+
+    spin_unlock_irqrestore(&fiber_pool_lock, flags);
+}
+
+/* =====================================================
+   Switching
+   ===================================================== */
+
+/* Back to the poller; the caller has already set f->state */
+static void fiber_switch_out(struct fiber *f)
+{
+    fiber_switch(&f->ctx, &fiber_rqs[f->cpu].sched_ctx);
+}
+
+void fiber_entry(struct fiber *f)
+{
+    f->fn(f->arg);
+
+    f->state = FIBER_DONE;
+    fiber_switch_out(f);
+}
+
+static int fiber_poll(void *arg, int budget)
+{
+    struct fiber_rq *rq = (struct fiber_rq *)arg;
+    int ran = 0;
+
+    while (ran < budget) {
+        uint64_t flags = local_irq_save();
+        struct fiber *f = rq_dequeue(rq);
+
+        if (f)
+            f->state = FIBER_RUNNING;
+        local_irq_restore(flags);
+
+        if (!f)
+            break;
+
+        rq->current = f;
+        f->switches++;
+        stat_inc(&fiber_stats.switches);
+
+        fiber_switch(&rq->sched_ctx, &f->ctx);
+
+        rq->current = 0;
+        ran++;
+
+        if (f->stack[0] != FIBER_CANARY) {
+            stat_inc(&fiber_stats.overflows);
+            klog_err(KLOG_SUB_KERNEL, "fiber %s overflowed its stack", (uintptr_t)f->name);
+            f->stack[0] = FIBER_CANARY;
+        }
+
+        if (f->state == FIBER_DONE)
+            fiber_release(f);
+    }
+
+    return ran;
+}
+
+/* =====================================================
+   Lifecycle
+   ===================================================== */
+
+struct fiber *fiber_spawn(const char *name, fiber_fn_t fn, void *arg)
+{
+    struct fiber_rq *rq = this_rq();
+
+    if (!rq->online)
+        return 0;
+
+    uint64_t flags = spin_lock_irqsave(&fiber_pool_lock);
+    struct fiber *f = fiber_free_list;
+
+    if (!f) {
+        fiber_stats.exhausted++;
+        spin_unlock_irqrestore(&fiber_pool_lock, flags);
+        return 0;
+    }
+
+    fiber_free_list = f->next;
+    fiber_stats.spawned++;
+    if (++fiber_stats.live > fiber_stats.peak)
+        fiber_stats.peak = fiber_stats.live;
+    spin_unlock_irqrestore(&fiber_pool_lock, flags);
+
+    f->name     = name;
+    f->fn       = fn;
+    f->arg      = arg;
+    f->woken    = 0;
+    f->cpu      = smp_processor_id();
+    f->switches = 0;
+    f->stack[0] = FIBER_CANARY;
+
+    memset(&f->ctx, 0, sizeof(f->ctx));
+    f->ctx.regs[CTX_X19] = (uint64_t)f;
+    f->ctx.regs[CTX_LR]  = (uint64_t)fiber_trampoline;
+    f->ctx.regs[CTX_SP]  = (uint64_t)(f->stack + FIBER_STACK_SIZE / 8);
+
+    flags = local_irq_save();
+    rq_enqueue(rq, f);
+    local_irq_restore(flags);
+
+    return f;
+}
+
+/* =====================================================
+   Parking
+   ===================================================== */
+
+static void fiber_timeout_fn(struct hrtimer *timer)
+{
+    struct fiber *f = (struct fiber *)timer->data;
+
+    /* IRQ context on f's core: IRQs already masked */
+    if (f->state == FIBER_PARKED) {
+        stat_inc(&fiber_stats.timeouts);
+        rq_enqueue(&fiber_rqs[f->cpu], f);
+    }
+}
+
+int fiber_park(uint64_t timeout_ns)
+{
+    struct fiber *f = fiber_current();
+
+    if (!f)
+        return -1;
+
+    uint64_t flags = local_irq_save();
+
+    if (f->woken) {
+        f->woken = 0;
+        local_irq_restore(flags);
+        return 0;
+    }
+
+    f->state = FIBER_PARKED;
+    if (timeout_ns)
+        hrtimer_start_rel(&f->timeout, timeout_ns);
+
+    /* An unpark from here on just queues us; the poller resumes us later */
+    local_irq_restore(flags);
+    fiber_switch_out(f);
+
+    flags = local_irq_save();
+    if (timeout_ns)
+        hrtimer_cancel(&f->timeout);
+
+    int ret = f->woken ? 0 : -1;
+    f->woken = 0;
+    local_irq_restore(flags);
+
+    return ret;
+}
+
+static void fiber_unpark_ipi(void *arg)
+{
+    fiber_unpark((struct fiber *)arg);
+}
+
+void fiber_unpark(struct fiber *f)
+{
+    if (!f)
+        return;
+
+    uint64_t flags = local_irq_save();
+
+    /* Run queues are core-local: let the owner do it */
+    if (f->cpu != smp_processor_id()) {
+        local_irq_restore(flags);
+        if (smp_call_on(f->cpu, fiber_unpark_ipi, f) < 0)
+            klog_warn(KLOG_SUB_KERNEL, "lost unpark of fiber on CPU%u", f->cpu);
+        return;
+    }
+
+    f->woken = 1;
+    if (f->state == FIBER_PARKED)
+        rq_enqueue(&fiber_rqs[f->cpu], f);
+
+    local_irq_restore(flags);
+}
+
+/* =====================================================
+   Wait Lists
+   ===================================================== */
+
+void fiber_waitq_init(struct fiber_waitq *wq)
+{
+    spin_lock_init(&wq->lock, "fiber_waitq");
+    wq->head = 0;
+    wq->tail = 0;
+}
+
+void fiber_wait(struct fiber_waitq *wq)
+{
+    fiber_wait_locked(wq, spin_lock_irqsave(&wq->lock));
+}
+
+void fiber_wait_locked(struct fiber_waitq *wq, uint64_t flags)
+{
+    struct fiber *f = fiber_current();
+
+    if (!f) {
+        spin_unlock_irqrestore(&wq->lock, flags);
+        return;
+    }
+
+    f->wait_next = 0;
+    if (wq->tail)
+        wq->tail->wait_next = f;
+    else
+        wq->head = f;
+    wq->tail = f;
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    fiber_park(0);
+
+    /* Woken by someone else (e.g. socket readiness): leave the list */
+    flags = spin_lock_irqsave(&wq->lock);
+    struct fiber **link = &wq->head;
+    struct fiber *prev = 0;
+
+    while (*link && *link != f) {
+        prev = *link;
+        link = &(*link)->wait_next;
+    }
+
+    if (*link) {
+        *link = f->wait_next;
+        if (wq->tail == f)
+            wq->tail = prev;
+        f->wait_next = 0;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void fiber_wake_one(struct fiber_waitq *wq)
+{
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    struct fiber *f = wq->head;
+
+    if (f) {
+        wq->head = f->wait_next;
+        if (!wq->head)
+            wq->tail = 0;
+        f->wait_next = 0;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    fiber_unpark(f);
+}
+
+/* =====================================================
+   Setup & Stats
+   ===================================================== */
+
+/* Runs on the secondary itself, between poller passes */
+static void fiber_cpu_init(struct sched_work *w)
+{
+    struct fiber_rq *rq = (struct fiber_rq *)w->data;
+
+    sched_register_poller(&rq->poller, "fibers", fiber_poll, rq,
+                          SCHED_PRIO_NET, FIBER_RUN_BUDGET, 0);
+    rq->online = 1;
+}
+
+void fiber_init(void)
+{
+    struct fiber_rq *rq = this_rq();
+
+    if (!fiber_pool_ready) {
+        spin_lock_init(&fiber_pool_lock, "fiber_pool");
+
+        for (int i = FIBER_MAX - 1; i >= 0; i--) {
+            fibers[i].stack = fiber_stacks[i];
+            fibers[i].state = FIBER_FREE;
+            hrtimer_init(&fibers[i].timeout, fiber_timeout_fn, &fibers[i]);
+            fibers[i].next = fiber_free_list;
+            fiber_free_list = &fibers[i];
+        }
+
+        fiber_pool_ready = 1;
+    }
+
+    sched_register_poller(&rq->poller, "fibers", fiber_poll, rq,
+                          SCHED_PRIO_NET, FIBER_RUN_BUDGET, 0);
+    rq->online = 1;
+
+    /* Flows steered to other cores spawn their fibers there */
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (cpu == smp_processor_id() || !cpu_data[cpu].online)
+            continue;
+
+        sched_init_work(&fiber_rqs[cpu].init_work, fiber_cpu_init, &fiber_rqs[cpu],
+                        SCHED_PRIO_NET);
+        sched_queue_work_on(cpu, &fiber_rqs[cpu].init_work);
+    }
+
+    uart_puts("[OK] Fibers: ");
+    uart_put_int(FIBER_MAX);
+    uart_puts(" x ");
+    uart_put_int(FIBER_STACK_SIZE / 1024);
+    uart_puts(" KB pooled stacks.\r\n");
+}
+
+void fiber_get_stats(fiber_stats_t *out)
+{
+    *out = fiber_stats;
+}
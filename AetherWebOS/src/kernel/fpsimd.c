@@ -0,0 +1,128 @@
+#include "kernel/fpsimd.h"
+#include "kernel/irqflags.h"
+#include "kernel/smp.h"
+#include "kernel/preempt.h"
+#include "drivers/uart.h"
+
+/* =====================================================
+   Lazy FP/SIMD Context Tracking
+   ===================================================== */
+
+#define CPACR_FPEN_MASK   (3UL << 20)
+
+/* The register file is per core, so is everything tracking it */
+struct fpsimd_cpu {
+    /* Save slots for an interrupted owner, indexed by exception depth */
+    struct fpsimd_state save_area[FPSIMD_MAX_DEPTH];
+    int saved[FPSIMD_MAX_DEPTH];
+
+    /* 0 = thread context, 1 = inside an IRQ handler */
+    int exception_depth;
+
+    /* Depth whose values currently live in V0-V31, or -1 if none */
+    int neon_owner;
+};
+
+static struct fpsimd_cpu fpsimd_cpus[MAX_CPUS];
+
+static inline struct fpsimd_cpu *this_fpsimd(void)
+{
+    return &fpsimd_cpus[smp_processor_id()];
+}
+
+static inline void fpsimd_set_access(int enable)
+{
+    uint64_t cpacr;
+    asm volatile("mrs %0, cpacr_el1" : "=r" (cpacr));
+
+    if (enable)
+        cpacr |= CPACR_FPEN_MASK;
+    else
+        cpacr &= ~CPACR_FPEN_MASK;
+
+    asm volatile("msr cpacr_el1, %0" : : "r" (cpacr));
+    asm volatile("isb");
+}
+
+/**
+ * fpsimd_init: boot.S leaves FPEN open; from here on FP/SIMD
+ * instructions trap on the calling core unless bracketed by
+ * kernel_neon_begin/end. Every core runs this during bring-up.
+ */
+void fpsimd_init(void)
+{
+    struct fpsimd_cpu *fc = this_fpsimd();
+
+    for (int i = 0; i < FPSIMD_MAX_DEPTH; i++)
+        fc->saved[i] = 0;
+
+    fc->neon_owner = -1;
+    fc->exception_depth = 0;
+    fpsimd_set_access(0);
+
+    if (smp_processor_id() == 0)
+        uart_puts("[OK] FPSIMD: Kernel-mode NEON ready (lazy save).\r\n");
+}
+
+/* =====================================================
+   Kernel NEON Sections
+   ===================================================== */
+
+void kernel_neon_begin(void)
+{
+    /* The live V registers are not part of a thread's saved context */
+    preempt_disable();
+
+    uint64_t flags = local_irq_save();
+    struct fpsimd_cpu *fc = this_fpsimd();
+    int depth = fc->exception_depth;
+
+    /*
+     * An interrupted context still owns the register file:
+     * spill it now, exception exit will reload it.
+     */
+    if (fc->neon_owner >= 0 && fc->neon_owner != depth) {
+        fpsimd_set_access(1);
+        fpsimd_save_state(&fc->save_area[fc->neon_owner]);
+        fc->saved[fc->neon_owner] = 1;
+    }
+
+    fc->neon_owner = depth;
+    fpsimd_set_access(1);
+
+    local_irq_restore(flags);
+}
+
+void kernel_neon_end(void)
+{
+    uint64_t flags = local_irq_save();
+
+    this_fpsimd()->neon_owner = -1;
+    fpsimd_set_access(0);
+
+    local_irq_restore(flags);
+    preempt_enable();
+}
+
+/* =====================================================
+   Exception Path Hooks
+   ===================================================== */
+
+void fpsimd_exception_enter(void)
+{
+    this_fpsimd()->exception_depth++;
+}
+
+void fpsimd_exception_exit(void)
+{
+    struct fpsimd_cpu *fc = this_fpsimd();
+    int depth = --fc->exception_depth;
+
+    /* Only pay for the reload if the handler actually used NEON */
+    if (fc->saved[depth]) {
+        fpsimd_set_access(1);
+        fpsimd_load_state(&fc->save_area[depth]);
+        fc->saved[depth] = 0;
+        fc->neon_owner = depth;
+    }
+}
@@ -2,6 +2,14 @@
 #include "config.h"
 #include "uart.h"
 #include "utils.h"
+#include "kernel/smp.h"
+#include "kernel/its.h"
+
+#ifndef BOARD_RPI4
+/* SGI/PPI frame of each core's redistributor (set by gic_cpu_init) */
+static uint64_t gic_sgi_base[MAX_CPUS];
+static uint64_t gic_boot_affinity = 0;
+#endif
 
 void gic_init() {
     uart_puts("[INFO] GIC: Initializing Interrupt Controller...\r\n");
@@ -15,9 +23,31 @@ void gic_init() {
 #endif
 
 #ifdef BOARD_RPI4
-    /* --- GICv2 (Raspberry Pi 4) --- */
-    GICD_ISENABLER[0] = (1 << TIMER_IRQ_ID);
     GICD_ITARGETSR[7] |= (1 << 16); 
+#else
+    uint64_t mpidr;
+    asm volatile("mrs %0, mpidr_el1" : "=r" (mpidr));
+    gic_boot_affinity = mpidr & 0xFF00FFFFFFULL;
+
+    // MSI translation for PCIe; must precede the redistributor LPI setup
+    its_init();
+#endif
+
+    gic_cpu_init();
+
+    uart_puts("[OK] GIC: Ready to receive interrupts.\r\n");
+}
+
+/**
+ * gic_cpu_init: Per-core half of the GIC setup. Wakes this core's
+ * redistributor and enables the CPU interface; banked SGIs/PPIs are
+ * left masked until irq_cpu_init() applies the registered ones. Runs
+ * on the boot core from gic_init() and on every secondary during SMP
+ * bring-up.
+ */
+void gic_cpu_init(void) {
+#ifdef BOARD_RPI4
+    /* --- GICv2 (Raspberry Pi 4): PPI enables and GICC are banked --- */
     GICC_PMR = 0xFF; 
     GICC_CTLR = 1;   
 #else
@@ -43,34 +73,144 @@ void gic_init() {
 
     /* --- PPI/SGI Configuration (SGI_base) --- */
     uint64_t sgi_base = redist_base + 0x10000;
+    gic_sgi_base[smp_processor_id()] = sgi_base;
 
-    // 3. Set Group 1 Non-Secure (CRITICAL FIX)
-    // GICR_IGROUPR0 (Offset 0x80): Bit must be 1 (Group 1)
-    *(volatile uint32_t*)(sgi_base + 0x080) |= (1 << TIMER_IRQ_ID);
-    
-    // GICR_IGRPMODR0 (Offset 0x88): Bit must be 0 (Non-Secure)
-    // Your previous code was setting this to 1, which made it Secure-only.
-    *(volatile uint32_t*)(sgi_base + 0x088) &= ~(1 << TIMER_IRQ_ID); 
-
-    // 4. Set Priority (GICR_IPRIORITYR at offset 0x400)
-    // PPI priorities are handled in the Redistributor for GICv3
-    *(volatile uint8_t*)(sgi_base + 0x400 + TIMER_IRQ_ID) = 0xA0;
-
-    // 5. Set Trigger (Edge-triggered for Timer)
-    // GICR_ICFGR1 (Offset 0xC04) handles PPIs 16-31
-    *(volatile uint32_t*)(sgi_base + 0xC04) |= (2 << ((TIMER_IRQ_ID % 16) * 2));
+    /* SGIs and PPIs are configured per core by irq_cpu_init() */
 
-    // 6. Enable the Timer Interrupt
-    *(volatile uint32_t*)(sgi_base + 0x100) = (1 << TIMER_IRQ_ID);
+    // LPIs: property/pending tables and this core's ITS collection
+    its_cpu_init(redist_base);
 
     /* --- CPU Interface (System Registers) --- */
     uint64_t sre;
     asm volatile("mrs %0, ICC_SRE_EL1" : "=r" (sre));
     asm volatile("msr ICC_SRE_EL1, %0" : : "r" (sre | 0x7)); // Enable System Reg Access
+    asm volatile("isb");
     
     asm volatile("msr ICC_PMR_EL1, %0" : : "r" (0xFF));      // Priority Mask: Allow all
     asm volatile("msr ICC_IGRPEN1_EL1, %0" : : "r" (1));     // Enable Group 1 IRQs
 #endif
+}
 
-    uart_puts("[OK] GIC: Ready to receive interrupts.\r\n");
-}
\ No newline at end of file
+/**
+ * gic_configure_irq: Sets group (1 NS), priority and trigger of an
+ * interrupt without unmasking it. SGIs/PPIs (< 32) live in the calling
+ * core's redistributor on GICv3; SPIs are configured in the distributor
+ * and routed to the boot core. SGIs are always edge-triggered.
+ */
+void gic_configure_irq(uint32_t id, uint8_t priority, int edge) {
+    uint32_t cfg_shift = (id % 16) * 2;
+
+    if (id >= ITS_LPI_BASE) {           // LPIs: message-based, no trigger
+        its_lpi_set_priority(id, priority);
+        return;
+    }
+
+#ifdef BOARD_RPI4
+    GICD_IPRIORITYR[id] = priority;
+    if (id >= 16) {
+        GICD_ICFGR[id / 16] = (GICD_ICFGR[id / 16] & ~(3 << cfg_shift)) |
+                              ((edge ? 2 : 0) << cfg_shift);
+    }
+    if (id >= 32)
+        ((volatile uint8_t *)GICD_ITARGETSR)[id] = 0x01;   // CPU interface 0
+#else
+    if (id < 32) {
+        uint64_t sgi_base = gic_sgi_base[smp_processor_id()];
+        *(volatile uint32_t*)(sgi_base + 0x080) |= (1 << id);                 // IGROUPR0
+        *(volatile uint32_t*)(sgi_base + 0x088) &= ~(1 << id);                // IGRPMODR0
+        *(volatile uint8_t*)(sgi_base + 0x400 + id) = priority;
+        if (id >= 16) {
+            volatile uint32_t *icfgr1 = (volatile uint32_t*)(sgi_base + 0xC04);
+            *icfgr1 = (*icfgr1 & ~(3 << cfg_shift)) | ((edge ? 2 : 0) << cfg_shift);
+        }
+        return;
+    }
+
+    GICD_IGROUPR[id / 32] |= (1 << (id % 32));
+    *(volatile uint32_t*)((uintptr_t)GIC_DIST_BASE + 0xD00 + (id / 32) * 4) &= ~(1 << (id % 32)); // IGRPMODR
+    GICD_IPRIORITYR[id] = priority;
+    GICD_ICFGR[id / 16] = (GICD_ICFGR[id / 16] & ~(3 << cfg_shift)) | ((edge ? 2 : 0) << cfg_shift);
+    *(volatile uint64_t*)((uintptr_t)GIC_DIST_BASE + 0x6000 + id * 8) = gic_boot_affinity;        // IROUTER
+#endif
+}
+
+void gic_unmask_irq(uint32_t id) {
+    if (id >= ITS_LPI_BASE) {
+        its_lpi_enable(id, 1);
+        return;
+    }
+#ifndef BOARD_RPI4
+    if (id < 32) {
+        *(volatile uint32_t*)(gic_sgi_base[smp_processor_id()] + 0x100) = (1 << id);  // ISENABLER0
+        return;
+    }
+#endif
+    GICD_ISENABLER[id / 32] = (1 << (id % 32));
+}
+
+void gic_mask_irq(uint32_t id) {
+    if (id >= ITS_LPI_BASE) {
+        its_lpi_enable(id, 0);
+        return;
+    }
+#ifndef BOARD_RPI4
+    if (id < 32) {
+        *(volatile uint32_t*)(gic_sgi_base[smp_processor_id()] + 0x180) = (1 << id); // ICENABLER0
+        return;
+    }
+#endif
+    GICD_ICENABLER[id / 32] = (1 << (id % 32));
+}
+
+/**
+ * gic_enable_irq: Level-triggered shorthand for configure + unmask.
+ */
+void gic_enable_irq(uint32_t id, uint8_t priority) {
+    gic_configure_irq(id, priority, 0);
+    gic_unmask_irq(id);
+}
+
+/**
+ * gic_send_sgi: Raises a Software Generated Interrupt on a set of cores.
+ * On GICv3 one ICC_SGI1R_EL1 write reaches up to 16 cores sharing
+ * Aff3.Aff2.Aff1, so a batch of targets in one cluster costs one write.
+ * Stores made before the call are visible to the targets' handlers.
+ */
+void gic_send_sgi(uint32_t sgi, uint32_t cpu_mask) {
+    /* Order mailbox writes before the interrupt */
+    asm volatile("dsb ishst" ::: "memory");
+
+#ifdef BOARD_RPI4
+    /* GICD_SGIR: CPU target list in [23:16], interface n == core n */
+    *(volatile uint32_t *)(GIC_DIST_BASE + 0xF00) = ((cpu_mask & 0xFF) << 16) | (sgi & 0xF);
+#else
+    while (cpu_mask) {
+        uint32_t first = __builtin_ctz(cpu_mask);
+        uint64_t cluster = cpu_data[first].mpidr & 0xFF00FFFF00ULL;
+        uint32_t rs = (cpu_data[first].mpidr & 0xFF) >> 4;
+        uint64_t targets = 0;
+
+        for (uint32_t cpu = first; cpu < MAX_CPUS; cpu++) {
+            uint64_t mpidr = cpu_data[cpu].mpidr;
+
+            if (!(cpu_mask & (1u << cpu)))
+                continue;
+            if ((mpidr & 0xFF00FFFF00ULL) != cluster || ((mpidr & 0xFF) >> 4) != rs)
+                continue;
+
+            targets |= 1ULL << (mpidr & 0xF);
+            cpu_mask &= ~(1u << cpu);
+        }
+
+        uint64_t val = targets |
+                       ((cluster >> 8) & 0xFF) << 16 |      /* Aff1 */
+                       (uint64_t)(sgi & 0xF) << 24 |
+                       ((cluster >> 16) & 0xFF) << 32 |     /* Aff2 */
+                       (uint64_t)rs << 44 |                 /* RangeSelector */
+                       ((cluster >> 32) & 0xFF) << 48;      /* Aff3 */
+
+        asm volatile("msr S3_0_C12_C11_5, %0" : : "r" (val));  /* ICC_SGI1R_EL1 */
+    }
+    asm volatile("isb");
+#endif
+}
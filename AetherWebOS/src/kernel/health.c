@@ -2,6 +2,7 @@
 #include "drivers/ethernet/tcp/tcp_internal.h"
 #include "common/utils.h"
 #include "drivers/uart.h"
+#include "kernel/atomic.h"
 
 /* =====================================================
    Global System Health Stats
@@ -15,8 +16,8 @@ net_stats_t global_net_stats = {0};
 
 void health_report_checksum_error(void)
 {
-    global_net_stats.checksum_errors++;
-    global_net_stats.dropped_packets++;
+    stat_inc(&global_net_stats.checksum_errors);
+    stat_inc(&global_net_stats.dropped_packets);
 }
 
 /* =====================================================
@@ -43,6 +44,8 @@ void health_update_tcp_stats(void)
 {
     uint32_t established_count = 0;
 
+    struct mcs_node node;
+    uint64_t flags = mcs_lock_irqsave(&tcp_tcb_lock, &node);
     tcp_tcb_t *cur = tcp_tcb_list;
 
     while (cur) {
@@ -53,5 +56,7 @@ void health_update_tcp_stats(void)
         cur = cur->next;
     }
 
+    mcs_unlock_irqrestore(&tcp_tcb_lock, &node, flags);
+
     global_net_stats.tcp_active = established_count;
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "kernel/hrtimer.h"
+#include "kernel/timer.h"
+#include "kernel/irqflags.h"
+#include "kernel/smp.h"
+#include "drivers/uart.h"
+
+/* =====================================================
+   Timer Queue
+   ===================================================== */
+
+/* One queue per core: each core's CNTP comparator only serves its own */
+struct hrtimer_base {
+    struct hrtimer *head;
+    hrtimer_stats_t stats;
+} __attribute__((aligned(64)));
+
+static struct hrtimer_base hrtimer_bases[MAX_CPUS];
+
+static inline struct hrtimer_base *this_base(void)
+{
+    return &hrtimer_bases[smp_processor_id()];
+}
+
+/* Called with IRQs masked */
+static void hrtimer_reprogram(struct hrtimer_base *base)
+{
+    if (base->head) {
+        timer_program_deadline(base->head->expires_ns);
+        base->stats.programmed++;
+    } else {
+        timer_disarm();
+    }
+}
+
+/* Called with IRQs masked; returns 1 if @timer became the new head */
+static int hrtimer_enqueue(struct hrtimer_base *base, struct hrtimer *timer)
+{
+    struct hrtimer **link = &base->head;
+
+    while (*link && (*link)->expires_ns <= timer->expires_ns)
+        link = &(*link)->next;
+
+    timer->next = *link;
+    *link = timer;
+    timer->queued = 1;
+
+    return link == &base->head;
+}
+
+/* Called with IRQs masked; returns 1 if @timer was the head */
+static int hrtimer_dequeue(struct hrtimer_base *base, struct hrtimer *timer)
+{
+    struct hrtimer **link = &base->head;
+
+    while (*link && *link != timer)
+        link = &(*link)->next;
+
+    if (!*link)
+        return 0;
+
+    int was_head = (link == &base->head);
+    *link = timer->next;
+    timer->next = 0;
+    timer->queued = 0;
+
+    return was_head;
+}
+
+/* =====================================================
+   Public API
+   ===================================================== */
+
+void hrtimer_init_subsystem(void)
+{
+    this_base()->head = 0;
+
+    if (smp_processor_id() == 0)
+        uart_puts("[OK] HRTimer: Tickless one-shot timers on CNTP.\r\n");
+}
+
+void hrtimer_init(struct hrtimer *timer, hrtimer_fn_t fn, void *data)
+{
+    timer->expires_ns = 0;
+    timer->fn = fn;
+    timer->data = data;
+    timer->next = 0;
+    timer->queued = 0;
+    timer->cpu = 0;
+}
+
+void hrtimer_start(struct hrtimer *timer, uint64_t expires_ns)
+{
+    uint64_t flags = local_irq_save();
+    struct hrtimer_base *base = this_base();
+    int reprogram = 0;
+
+    if (timer->queued)
+        reprogram = hrtimer_dequeue(base, timer);
+
+    timer->expires_ns = expires_ns;
+    timer->cpu = smp_processor_id();
+    reprogram |= hrtimer_enqueue(base, timer);
+
+    if (reprogram)
+        hrtimer_reprogram(base);
+
+    local_irq_restore(flags);
+}
+
+void hrtimer_start_rel(struct hrtimer *timer, uint64_t delta_ns)
+{
+    hrtimer_start(timer, timer_get_ns() + delta_ns);
+}
+
+int hrtimer_cancel(struct hrtimer *timer)
+{
+    uint64_t flags = local_irq_save();
+    struct hrtimer_base *base = this_base();
+    int was_queued = timer->queued;
+
+    if (was_queued && hrtimer_dequeue(base, timer))
+        hrtimer_reprogram(base);
+
+    local_irq_restore(flags);
+    return was_queued;
+}
+
+uint64_t hrtimer_next_deadline(void)
+{
+    uint64_t flags = local_irq_save();
+    struct hrtimer_base *base = this_base();
+    uint64_t next = base->head ? base->head->expires_ns : UINT64_MAX;
+    local_irq_restore(flags);
+    return next;
+}
+
+/* =====================================================
+   Expiry (IRQ context)
+   ===================================================== */
+
+void hrtimer_run_expired(void)
+{
+    struct hrtimer_base *base = this_base();
+    uint64_t now = timer_get_ns();
+
+    /*
+     * Re-check after reprogramming: a deadline that slipped into the past
+     * while callbacks ran would otherwise wait for an edge that never comes.
+     */
+    do {
+        while (base->head && base->head->expires_ns <= now) {
+            struct hrtimer *t = base->head;
+
+            base->head = t->next;
+            t->next = 0;
+            t->queued = 0;
+
+            uint64_t late = now - t->expires_ns;
+            if (late > base->stats.max_late_ns)
+                base->stats.max_late_ns = late;
+
+            base->stats.fired++;
+            t->fn(t);
+
+            now = timer_get_ns();
+        }
+
+        hrtimer_reprogram(base);
+        now = timer_get_ns();
+    } while (base->head && base->head->expires_ns <= now);
+}
+
+const hrtimer_stats_t *hrtimer_get_stats(void)
+{
+    return &this_base()->stats;
+}
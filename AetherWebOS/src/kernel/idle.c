@@ -0,0 +1,108 @@
+#include "kernel/idle.h"
+#include "kernel/hrtimer.h"
+#include "kernel/timer.h"
+#include "kernel/sched.h"
+#include "kernel/thread.h"
+#include "kernel/fiber.h"
+#include "drivers/uart.h"
+
+/* =====================================================
+   State
+   ===================================================== */
+
+static uint64_t poll_window_ns = IDLE_POLL_WINDOW_NS;
+static uint64_t last_activity_ns = 0;
+static uint64_t max_sleep_ns = IDLE_MAX_SLEEP_NS;
+
+static idle_stats_t idle_stats;
+static uint64_t idle_total_base_ns = 0;
+
+/* Wakeup source while parked; the interrupt itself is the point */
+static struct hrtimer idle_wakeup;
+
+static void idle_wakeup_fn(struct hrtimer *t)
+{
+    (void)t;
+}
+
+void idle_init(void)
+{
+    hrtimer_init(&idle_wakeup, idle_wakeup_fn, 0);
+    last_activity_ns = timer_get_ns();
+    idle_total_base_ns = last_activity_ns;
+
+    uart_puts("[OK] Idle: Adaptive busy-poll + WFI.\r\n");
+}
+
+void idle_set_poll_window(uint64_t ns)
+{
+    poll_window_ns = ns;
+}
+
+void idle_set_max_sleep(uint64_t ns)
+{
+    max_sleep_ns = ns;
+}
+
+void idle_note_activity(int did_work)
+{
+    if (did_work)
+        last_activity_ns = timer_get_ns();
+    else
+        idle_stats.polls++;
+}
+
+/* =====================================================
+   Idle Entry
+   ===================================================== */
+
+void idle_enter(uint64_t deadline_ns)
+{
+    uint64_t now = timer_get_ns();
+
+    if (now - last_activity_ns < poll_window_ns)
+        return;
+
+    if (max_sleep_ns && deadline_ns > now + max_sleep_ns)
+        deadline_ns = now + max_sleep_ns;
+
+    if (deadline_ns <= now)
+        return;
+
+    /* Other threads want the CPU: block instead of parking the core */
+    if (thread_others_ready()) {
+        idle_stats.yields++;
+        thread_sleep_until(deadline_ns);
+        return;
+    }
+
+    hrtimer_start(&idle_wakeup, deadline_ns);
+
+    /*
+     * Mask, re-check, then WFI. An interrupt that became pending after
+     * the check still wakes WFI (PSTATE.I only blocks delivery) and is
+     * taken as soon as we unmask.
+     */
+    asm volatile("msr daifset, #2" ::: "memory");
+
+    if (!uart_is_empty() || sched_has_pending_work() || fiber_has_ready()) {
+        idle_stats.aborted++;
+    } else {
+        uint64_t t0 = timer_get_ns();
+        asm volatile("dsb sy; wfi" ::: "memory");
+        idle_stats.idle_ns += timer_get_ns() - t0;
+        idle_stats.wfi_entries++;
+    }
+
+    asm volatile("msr daifclr, #2" ::: "memory");
+
+    hrtimer_cancel(&idle_wakeup);
+}
+
+void idle_get_stats(idle_stats_t *out)
+{
+    *out = idle_stats;
+
+    uint64_t total = timer_get_ns() - idle_total_base_ns;
+    out->busy_ns = total > idle_stats.idle_ns ? total - idle_stats.idle_ns : 0;
+}
@@ -0,0 +1,227 @@
+#include "kernel/ipi.h"
+#include "kernel/gic.h"
+#include "kernel/irq.h"
+#include "kernel/atomic.h"
+#include "kernel/irqflags.h"
+#include "kernel/timer.h"
+#include "drivers/uart.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Mailboxes
+   ===================================================== */
+
+struct ipi_msg {
+    ipi_fn_t           fn;
+    void              *arg;
+    uint64_t           sent_ns;
+    volatile uint32_t *done;        /* Set after fn returns (sync calls) */
+};
+
+/* head is written by the consumer, tail by the producer: keep them apart */
+struct ipi_ring {
+    volatile uint32_t head __attribute__((aligned(64)));
+    volatile uint32_t tail __attribute__((aligned(64)));
+    struct ipi_msg    slots[IPI_RING_SIZE];
+};
+
+struct ipi_cpu {
+    volatile uint32_t doorbell;     /* 1 from an SGI being raised until the drain starts */
+    uint32_t          kick_mask;    /* Targets this core must still kick */
+    ipi_stats_t       stats;
+} __attribute__((aligned(64)));
+
+/* ipi_rings[dst][src] */
+static struct ipi_ring ipi_rings[MAX_CPUS][MAX_CPUS];
+static struct ipi_cpu  ipi_cpus[MAX_CPUS];
+
+/* =====================================================
+   Sending
+   ===================================================== */
+
+static int ipi_queue_msg(uint32_t cpu, ipi_fn_t fn, void *arg, volatile uint32_t *done)
+{
+    uint64_t flags = local_irq_save();
+    struct ipi_cpu *self = &ipi_cpus[smp_processor_id()];
+
+    if (cpu >= MAX_CPUS || !cpu_data[cpu].online) {
+        self->stats.dropped++;
+        local_irq_restore(flags);
+        return -1;
+    }
+
+    struct ipi_ring *ring = &ipi_rings[cpu][smp_processor_id()];
+    uint32_t tail = ring->tail;
+
+    if (tail - smp_load_acquire(&ring->head) >= IPI_RING_SIZE) {
+        self->stats.dropped++;
+        local_irq_restore(flags);
+        return -1;
+    }
+
+    struct ipi_msg *msg = &ring->slots[tail & (IPI_RING_SIZE - 1)];
+    msg->fn      = fn;
+    msg->arg     = arg;
+    msg->done    = done;
+    msg->sent_ns = timer_get_ns();
+
+    smp_store_release(&ring->tail, tail + 1);
+    self->stats.sent++;
+    self->kick_mask |= 1u << cpu;
+
+    local_irq_restore(flags);
+    return 0;
+}
+
+int ipi_queue(uint32_t cpu, ipi_fn_t fn, void *arg)
+{
+    return ipi_queue_msg(cpu, fn, arg, 0);
+}
+
+void ipi_flush(void)
+{
+    uint64_t flags = local_irq_save();
+    struct ipi_cpu *self = &ipi_cpus[smp_processor_id()];
+    uint32_t mask = self->kick_mask;
+
+    self->kick_mask = 0;
+
+    /*
+     * The doorbell is only rung here, together with the SGI: finding it
+     * rung means an SGI is already on its way and the target has not
+     * started draining, so it will see our messages too.
+     */
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if ((mask & (1u << cpu)) &&
+            atomic32_cmpxchg(&ipi_cpus[cpu].doorbell, 0, 1) != 0) {
+            mask &= ~(1u << cpu);
+            self->stats.coalesced++;
+        }
+    }
+
+    if (mask) {
+        self->stats.kicks += __builtin_popcount(mask);
+        gic_send_sgi(IPI_CALL_SGI, mask);
+    }
+
+    local_irq_restore(flags);
+}
+
+int smp_call_on(uint32_t cpu, ipi_fn_t fn, void *arg)
+{
+    if (cpu == smp_processor_id()) {
+        fn(arg);
+        return 0;
+    }
+
+    if (ipi_queue_msg(cpu, fn, arg, 0) < 0)
+        return -1;
+
+    ipi_flush();
+    return 0;
+}
+
+/* Must not be called with IRQs masked if @cpu might call back into us */
+int smp_call_on_sync(uint32_t cpu, ipi_fn_t fn, void *arg)
+{
+    volatile uint32_t done = 0;
+
+    if (cpu == smp_processor_id()) {
+        fn(arg);
+        return 0;
+    }
+
+    if (ipi_queue_msg(cpu, fn, arg, &done) < 0)
+        return -1;
+
+    ipi_flush();
+
+    /* The handler issues SEV after setting done */
+    while (!smp_load_acquire(&done))
+        asm volatile("wfe");
+
+    return 0;
+}
+
+/* =====================================================
+   Receiving
+   ===================================================== */
+
+static void ipi_account_latency(ipi_stats_t *st, uint64_t lat_ns)
+{
+    uint64_t us = lat_ns / NSEC_PER_USEC;
+    uint32_t bucket = 0;
+
+    while (us && bucket < IPI_LAT_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    st->received++;
+    st->lat_total_ns += lat_ns;
+    if (lat_ns > st->lat_max_ns)
+        st->lat_max_ns = lat_ns;
+    st->lat_hist[bucket]++;
+}
+
+void ipi_handle_irq(void)
+{
+    uint32_t me = smp_processor_id();
+    struct ipi_cpu *self = &ipi_cpus[me];
+
+    self->stats.irqs++;
+
+    /* Reopen the doorbell before looking, so a racing send re-kicks */
+    __atomic_store_n(&self->doorbell, 0, __ATOMIC_RELAXED);
+    smp_mb();
+
+    for (uint32_t src = 0; src < MAX_CPUS; src++) {
+        struct ipi_ring *ring = &ipi_rings[me][src];
+        uint32_t head = ring->head;
+        uint32_t tail = smp_load_acquire(&ring->tail);
+
+        while (head != tail) {
+            struct ipi_msg msg = ring->slots[head & (IPI_RING_SIZE - 1)];
+
+            /* Free the slot before running: fn may send back to src */
+            smp_store_release(&ring->head, ++head);
+
+            ipi_account_latency(&self->stats, timer_get_ns() - msg.sent_ns);
+            msg.fn(msg.arg);
+
+            if (msg.done) {
+                smp_store_release(msg.done, 1);
+                asm volatile("sev");
+            }
+        }
+    }
+}
+
+/* =====================================================
+   Setup & Stats
+   ===================================================== */
+
+static irqreturn_t ipi_irq(uint32_t irq, void *ctx)
+{
+    (void)irq; (void)ctx;
+    ipi_handle_irq();
+    return IRQ_HANDLED;
+}
+
+void ipi_init(void)
+{
+    /* Above the timer; irq_cpu_init() enables it on each secondary */
+    request_irq(IPI_CALL_SGI, ipi_irq, 0, 0, "ipi_call", 0x80, IRQF_PERCPU);
+
+    uart_puts("[OK] IPI: SGI ");
+    uart_put_int(IPI_CALL_SGI);
+    uart_puts(", ");
+    uart_put_int(IPI_RING_SIZE);
+    uart_puts("-slot mailbox per core pair.\r\n");
+}
+
+void ipi_get_stats(uint32_t cpu, ipi_stats_t *out)
+{
+    if (cpu < MAX_CPUS)
+        *out = ipi_cpus[cpu].stats;
+}
@@ -0,0 +1,219 @@
+#include "kernel/irq.h"
+#include "kernel/gic.h"
+#include "kernel/atomic.h"
+#include "kernel/irqflags.h"
+#include "kernel/timer.h"
+#include "kernel/klog.h"
+#include "drivers/uart.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Descriptor Table
+   ===================================================== */
+
+static struct irq_desc irq_descs[NR_IRQ_DESCS];
+
+static unsigned long irq_spurious[MAX_CPUS];
+static unsigned long irq_stray;             /* Fired with no handler */
+
+/* Wired INTIDs map 1:1, LPIs follow them */
+static struct irq_desc *irq_to_desc(uint32_t irq)
+{
+    if (irq < NR_IRQS)
+        return &irq_descs[irq];
+    if (irq >= ITS_LPI_BASE && irq < ITS_LPI_BASE + ITS_NR_LPIS)
+        return &irq_descs[NR_IRQS + (irq - ITS_LPI_BASE)];
+    return 0;
+}
+
+static inline uint32_t irq_number(const struct irq_desc *d)
+{
+    uint32_t idx = (uint32_t)(d - irq_descs);
+    return idx < NR_IRQS ? idx : ITS_LPI_BASE + (idx - NR_IRQS);
+}
+
+static void irq_run_bh(struct sched_work *w)
+{
+    struct irq_desc *d = (struct irq_desc *)w->data;
+
+    stat_inc(&d->bh_runs);
+    d->bh(irq_number(d), d->ctx);
+}
+
+static void irq_setup_this_cpu(struct irq_desc *d, uint32_t irq)
+{
+    gic_configure_irq(irq, d->priority, (d->flags & IRQF_EDGE) || irq < 16);
+    gic_unmask_irq(irq);
+}
+
+int request_irq(uint32_t irq, irq_handler_t handler, irq_bh_t bh, void *ctx,
+                const char *name, uint8_t priority, uint8_t flags)
+{
+    struct irq_desc *d = irq_to_desc(irq);
+
+    if (!d || !handler)
+        return -1;
+
+    uint64_t irq_flags = local_irq_save();
+
+    if (d->handler) {
+        local_irq_restore(irq_flags);
+        klog_warn(KLOG_SUB_KERNEL, "IRQ %u already claimed by %s", irq, (uintptr_t)d->name);
+        return -1;
+    }
+
+    /* Banked interrupts are per-CPU whether or not the caller said so */
+    if (irq < 32)
+        flags |= IRQF_PERCPU;
+
+    d->name     = name;
+    d->bh       = bh;
+    d->ctx      = ctx;
+    d->priority = priority;
+    d->flags    = flags;
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+        sched_init_work(&d->bh_work[cpu], irq_run_bh, d, SCHED_PRIO_NET);
+
+    /* Publish last: the vector checks handler alone */
+    smp_store_release(&d->handler, handler);
+
+    irq_setup_this_cpu(d, irq);
+    local_irq_restore(irq_flags);
+
+    klog_debug(KLOG_SUB_KERNEL, "IRQ %u -> %s (prio 0x%x, %s)", irq, (uintptr_t)name,
+               priority, (uintptr_t)((flags & IRQF_EDGE) ? "edge" : "level"));
+    return 0;
+}
+
+void free_irq(uint32_t irq)
+{
+    struct irq_desc *d = irq_to_desc(irq);
+
+    if (!d)
+        return;
+
+    uint64_t flags = local_irq_save();
+    gic_mask_irq(irq);
+    d->handler = 0;
+    d->bh = 0;
+    local_irq_restore(flags);
+}
+
+void irq_cpu_init(void)
+{
+    for (uint32_t irq = 0; irq < 32; irq++) {
+        struct irq_desc *d = &irq_descs[irq];
+
+        if (smp_load_acquire(&d->handler) && (d->flags & IRQF_PERCPU))
+            irq_setup_this_cpu(d, irq);
+    }
+}
+
+/* =====================================================
+   Dispatch
+   ===================================================== */
+
+static void irq_account(struct irq_desc *d, uint64_t ns)
+{
+    uint64_t scaled = ns >> IRQ_LAT_SHIFT;
+    uint32_t bucket = 0;
+
+    while (scaled && bucket < IRQ_LAT_BUCKETS - 1) {
+        scaled >>= 1;
+        bucket++;
+    }
+
+    stat_add(&d->total_ns, ns);
+    stat_inc(&d->lat_hist[bucket]);
+
+    /* Racy across cores for per-CPU lines; a lost update only loses a max */
+    if (ns > d->max_ns)
+        d->max_ns = ns;
+}
+
+void irq_dispatch(uint32_t irq)
+{
+    uint32_t cpu = smp_processor_id();
+    struct irq_desc *d = irq_to_desc(irq);
+    irq_handler_t handler = d ? smp_load_acquire(&d->handler) : 0;
+
+    if (!handler) {
+        /* Mask it so a stuck level line cannot storm the core */
+        stat_inc(&irq_stray);
+        if (d)
+            gic_mask_irq(irq);
+        klog_warn(KLOG_SUB_KERNEL, "stray IRQ %u on CPU%u masked", irq, cpu);
+        return;
+    }
+
+    d->count[cpu]++;
+
+    uint64_t t0 = timer_read_counter();
+    irqreturn_t ret = handler(irq, d->ctx);
+    irq_account(d, timer_cycles_to_ns(timer_read_counter() - t0));
+
+    if (ret == IRQ_NONE)
+        stat_inc(&d->unhandled);
+    else if (ret == IRQ_WAKE_THREAD && d->bh)
+        sched_queue_work(&d->bh_work[cpu]);
+}
+
+void irq_note_spurious(void)
+{
+    irq_spurious[smp_processor_id()]++;
+}
+
+/* =====================================================
+   Stats
+   ===================================================== */
+
+uint32_t irq_format(char *out, uint32_t out_size)
+{
+    uint32_t pos = 0;
+    unsigned long spurious = 0;
+
+    pos += ksnprintf(out + pos, out_size - pos,
+                     "irq  name        count  unhandled  bh  avg_ns  max_ns  <256 <512 <1u <2u <4u <8u <16u >=16u\n");
+
+    for (uint32_t idx = 0; idx < NR_IRQ_DESCS && pos + 1 < out_size; idx++) {
+        struct irq_desc *d = &irq_descs[idx];
+        uint32_t irq = irq_number(d);
+        unsigned long count = 0;
+        char name[12];
+        int i = 0;
+
+        if (!d->handler)
+            continue;
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+            count += d->count[cpu];
+
+        for (; d->name && d->name[i] && i < 11; i++)
+            name[i] = d->name[i];
+        for (; i < 11; i++)
+            name[i] = ' ';
+        name[11] = '\0';
+
+        pos += ksnprintf(out + pos, out_size - pos, "%u  %s %u  %u  %u  %u  %u ",
+                         irq, name,
+                         (unsigned int)count,
+                         (unsigned int)d->unhandled,
+                         (unsigned int)d->bh_runs,
+                         (unsigned int)(count ? d->total_ns / count : 0),
+                         (unsigned int)d->max_ns);
+
+        for (int b = 0; b < IRQ_LAT_BUCKETS && pos + 1 < out_size; b++)
+            pos += ksnprintf(out + pos, out_size - pos, " %u", (unsigned int)d->lat_hist[b]);
+
+        pos += ksnprintf(out + pos, out_size - pos, "\n");
+    }
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+        spurious += irq_spurious[cpu];
+
+    pos += ksnprintf(out + pos, out_size - pos, "spurious %u  stray %u\n",
+                     (unsigned int)spurious, (unsigned int)irq_stray);
+
+    return pos;
+}
@@ -0,0 +1,396 @@
+#include "kernel/its.h"
+#include "kernel/gic.h"
+#include "kernel/smp.h"
+#include "kernel/spinlock.h"
+#include "kernel/klog.h"
+#include "drivers/uart.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Registers
+   ===================================================== */
+
+#ifdef GIC_ITS_BASE
+
+#define GITS_REG32(off)     (*(volatile uint32_t *)((uintptr_t)GIC_ITS_BASE + (off)))
+#define GITS_REG64(off)     (*(volatile uint64_t *)((uintptr_t)GIC_ITS_BASE + (off)))
+
+#define GITS_CTLR           GITS_REG32(0x0000)
+#define GITS_TYPER          GITS_REG64(0x0008)
+#define GITS_CBASER         GITS_REG64(0x0080)
+#define GITS_CWRITER        GITS_REG64(0x0088)
+#define GITS_CREADR         GITS_REG64(0x0090)
+#define GITS_BASER(n)       GITS_REG64(0x0100 + (n) * 8)
+#define GITS_PIDR2          GITS_REG32(0xFFE8)
+#define GITS_TRANSLATER     (GIC_ITS_BASE + 0x10040)
+
+#define GITS_BASER_VALID        (1ULL << 63)
+#define GITS_BASER_TYPE(v)      (((v) >> 56) & 0x7)
+#define GITS_BASER_ESIZE(v)     ((((v) >> 48) & 0x1F) + 1)
+#define GITS_BASER_TYPE_DEVICE  1
+#define GITS_BASER_TYPE_COLL    4
+
+/* Inner-shareable, write-back read/write-allocate (ignored while the D-cache is off) */
+#define GITS_CACHE_ATTRS        ((7ULL << 59) | (1ULL << 10))
+
+#define GICD_TYPER_LPIS         (1u << 17)
+
+/* Redistributor RD_base registers */
+#define GICR_CTLR               0x0000
+#define GICR_TYPER              0x0008
+#define GICR_PROPBASER          0x0070
+#define GICR_PENDBASER          0x0078
+
+#define GICR_CTLR_ENABLE_LPIS   (1u << 0)
+#define GICR_TYPER_PLPIS        (1ULL << 0)
+
+/* ITS commands */
+#define ITS_CMD_MOVI            0x01
+#define ITS_CMD_SYNC            0x05
+#define ITS_CMD_MAPD            0x08
+#define ITS_CMD_MAPC            0x09
+#define ITS_CMD_MAPTI           0x0A
+#define ITS_CMD_INV             0x0C
+
+#define ITS_CMD_QUEUE_SIZE      0x1000
+#define ITS_CMD_SPINS           1000000     /* Runs before timer_init(): no clock */
+
+/* LPI property byte: priority[7:2], group 1 (RES1 on GICv3), enable[0] */
+#define LPI_PROP_GROUP1         (1u << 1)
+#define LPI_PROP_ENABLED        (1u << 0)
+
+#define ITS_ITT_BYTES           ((1 << ITS_EVENT_BITS) * 16)
+
+/* =====================================================
+   Tables
+   ===================================================== */
+
+struct its_cmd {
+    uint64_t dw[4];
+};
+
+struct its_pend_table {
+    uint8_t bits[(1 << ITS_LPI_ID_BITS) / 8];
+} __attribute__((aligned(0x10000)));
+
+static struct its_cmd its_cmdq[ITS_CMD_QUEUE_SIZE / sizeof(struct its_cmd)] __attribute__((aligned(0x10000)));
+static uint8_t its_device_table[0x1000] __attribute__((aligned(0x1000)));
+static uint8_t its_coll_table[0x1000] __attribute__((aligned(0x1000)));
+static uint8_t its_lpi_prop[(1 << ITS_LPI_ID_BITS) - ITS_LPI_BASE] __attribute__((aligned(0x1000)));
+static struct its_pend_table its_pend[MAX_CPUS];
+static uint8_t its_itt[ITS_MAX_DEVICES][ITS_ITT_BYTES] __attribute__((aligned(256)));
+
+struct its_device {
+    uint32_t devid;
+    uint8_t  mapped;
+};
+
+/* Who owns each handed-out LPI, for INV and MOVI */
+struct its_event {
+    uint32_t devid;
+    uint32_t event;
+    uint32_t cpu;
+};
+
+static struct its_device its_devices[ITS_MAX_DEVICES];
+static struct its_event  its_events[ITS_NR_LPIS];
+static uint32_t its_nr_lpis;
+static uint32_t its_device_entries;     /* DeviceIDs the flat table covers */
+
+static uint8_t  its_ready;
+static uint8_t  its_pta;                /* Collections target addresses, not numbers */
+static uint64_t its_rdbase[MAX_CPUS];   /* SYNC/MAPC target per core */
+static uint8_t  its_coll_mapped[MAX_CPUS];
+static uint32_t its_cwriter;
+static spinlock_t its_cmd_lock;
+
+/* =====================================================
+   Command Queue
+   ===================================================== */
+
+/* Caller holds its_cmd_lock */
+static int its_submit(const struct its_cmd *cmd)
+{
+    uint32_t slots = ITS_CMD_QUEUE_SIZE / sizeof(struct its_cmd);
+    uint32_t next = (its_cwriter + 1) % slots;
+    int spins = ITS_CMD_SPINS;
+
+    /* Full: one slot stays empty so CREADR == CWRITER means idle */
+    while ((GITS_CREADR >> 5) % slots == next) {
+        if (--spins <= 0)
+            return -1;
+    }
+
+    its_cmdq[its_cwriter] = *cmd;
+    its_cwriter = next;
+
+    asm volatile("dsb ishst" ::: "memory");
+    GITS_CWRITER = (uint64_t)its_cwriter << 5;
+
+    spins = ITS_CMD_SPINS;
+    while ((GITS_CREADR >> 5) % slots != its_cwriter) {
+        if (--spins <= 0) {
+            klog_err(KLOG_SUB_KERNEL, "ITS command 0x%x timed out", (uint32_t)(cmd->dw[0] & 0xFF));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int its_sync(uint32_t cpu)
+{
+    struct its_cmd c = { { ITS_CMD_SYNC, 0, its_rdbase[cpu], 0 } };
+    return its_submit(&c);
+}
+
+static int its_send(uint64_t dw0, uint64_t dw1, uint64_t dw2, uint32_t sync_cpu)
+{
+    struct its_cmd c = { { dw0, dw1, dw2, 0 } };
+    uint64_t flags = spin_lock_irqsave(&its_cmd_lock);
+
+    int ret = its_submit(&c);
+    if (ret == 0)
+        ret = its_sync(sync_cpu);
+
+    spin_unlock_irqrestore(&its_cmd_lock, flags);
+    return ret;
+}
+
+/* =====================================================
+   Bring-up
+   ===================================================== */
+
+static uint64_t its_table_baser(uint64_t baser, void *table, uint32_t size)
+{
+    return GITS_BASER_VALID | GITS_CACHE_ATTRS |
+           (baser & (0x7ULL << 56)) |           /* Type (RO) */
+           ((uint64_t)(uintptr_t)table & 0xFFFFFFFFF000ULL) |
+           ((size / 0x1000) - 1);               /* 4 KB pages, flat */
+}
+
+int its_init(void)
+{
+    uint32_t gicd_typer = *(volatile uint32_t *)(GIC_DIST_BASE + 0x004);
+
+    if (!(gicd_typer & GICD_TYPER_LPIS)) {
+        uart_puts("[INFO] ITS: GIC has no LPI support, MSI disabled.\r\n");
+        return -1;
+    }
+
+    uint32_t arch = (GITS_PIDR2 >> 4) & 0xF;
+    if (arch != 3 && arch != 4) {
+        uart_puts("[INFO] ITS: Not present, MSI disabled.\r\n");
+        return -1;
+    }
+
+    spin_lock_init(&its_cmd_lock, "its_cmd");
+
+    /* Quiesce before reprogramming the tables */
+    GITS_CTLR = 0;
+
+    uint64_t typer = GITS_TYPER;
+    its_pta = (typer >> 19) & 1;
+
+    for (int n = 0; n < 8; n++) {
+        uint64_t baser = GITS_BASER(n);
+        uint32_t esize = GITS_BASER_ESIZE(baser);
+
+        switch (GITS_BASER_TYPE(baser)) {
+        case GITS_BASER_TYPE_DEVICE:
+            GITS_BASER(n) = its_table_baser(baser, its_device_table, sizeof(its_device_table));
+            its_device_entries = sizeof(its_device_table) / esize;
+            break;
+        case GITS_BASER_TYPE_COLL:
+            GITS_BASER(n) = its_table_baser(baser, its_coll_table, sizeof(its_coll_table));
+            break;
+        default:
+            break;
+        }
+    }
+
+    GITS_CBASER = GITS_BASER_VALID | GITS_CACHE_ATTRS |
+                  ((uint64_t)(uintptr_t)its_cmdq & 0xFFFFFFFFF000ULL) |
+                  ((ITS_CMD_QUEUE_SIZE / 0x1000) - 1);
+    GITS_CWRITER = 0;
+    its_cwriter = 0;
+
+    /* LPIs start disabled at the default priority */
+    for (uint32_t i = 0; i < sizeof(its_lpi_prop); i++)
+        its_lpi_prop[i] = 0xA0 | LPI_PROP_GROUP1;
+
+    asm volatile("dsb sy" ::: "memory");
+    GITS_CTLR = 1;
+    its_ready = 1;
+
+    uart_puts("[OK] ITS: Command queue and tables at ");
+    uart_put_hex((uint64_t)(uintptr_t)its_cmdq);
+    uart_puts(", ");
+    uart_put_int(ITS_NR_LPIS);
+    uart_puts(" LPIs.\r\n");
+    return 0;
+}
+
+void its_cpu_init(uint64_t rd_base)
+{
+    uint32_t cpu = smp_processor_id();
+    uint64_t rd_typer = *(volatile uint64_t *)(rd_base + GICR_TYPER);
+
+    if (!its_ready || !(rd_typer & GICR_TYPER_PLPIS))
+        return;
+
+    volatile uint32_t *ctlr = (volatile uint32_t *)(rd_base + GICR_CTLR);
+
+    /* PROPBASER/PENDBASER are only writable while LPIs are off */
+    if (!(*ctlr & GICR_CTLR_ENABLE_LPIS)) {
+        *(volatile uint64_t *)(rd_base + GICR_PROPBASER) =
+            ((uint64_t)(uintptr_t)its_lpi_prop & 0xFFFFFFFFF000ULL) |
+            (7ULL << 7) | (1ULL << 10) | (ITS_LPI_ID_BITS - 1);
+        *(volatile uint64_t *)(rd_base + GICR_PENDBASER) =
+            ((uint64_t)(uintptr_t)&its_pend[cpu] & 0xFFFFFFFF0000ULL) |
+            (7ULL << 7) | (1ULL << 10);
+
+        asm volatile("dsb sy" ::: "memory");
+        *ctlr |= GICR_CTLR_ENABLE_LPIS;
+        asm volatile("dsb sy" ::: "memory");
+    }
+
+    its_rdbase[cpu] = its_pta ? (rd_base & 0xFFFFFFFF0000ULL)
+                              : (((rd_typer >> 8) & 0xFFFF) << 16);
+
+    /* Collection ICID == logical core id */
+    if (its_send(ITS_CMD_MAPC, 0, (1ULL << 63) | its_rdbase[cpu] | cpu, cpu) == 0)
+        its_coll_mapped[cpu] = 1;
+}
+
+int its_present(void)
+{
+    return its_ready;
+}
+
+uint64_t its_doorbell(void)
+{
+    return GITS_TRANSLATER;
+}
+
+/* =====================================================
+   Event Mapping
+   ===================================================== */
+
+static struct its_device *its_get_device(uint32_t devid)
+{
+    struct its_device *free_slot = 0;
+
+    for (int i = 0; i < ITS_MAX_DEVICES; i++) {
+        if (its_devices[i].mapped && its_devices[i].devid == devid)
+            return &its_devices[i];
+        if (!its_devices[i].mapped && !free_slot)
+            free_slot = &its_devices[i];
+    }
+
+    if (!free_slot || devid >= its_device_entries)
+        return 0;
+
+    uint64_t itt = (uint64_t)(uintptr_t)its_itt[free_slot - its_devices];
+
+    if (its_send(ITS_CMD_MAPD | ((uint64_t)devid << 32),
+                 ITS_EVENT_BITS - 1,
+                 (1ULL << 63) | (itt & 0xFFFFFFFFFF00ULL), 0) < 0)
+        return 0;
+
+    free_slot->devid = devid;
+    free_slot->mapped = 1;
+    return free_slot;
+}
+
+int its_map_event(uint32_t devid, uint32_t event, uint32_t cpu)
+{
+    if (!its_ready || event >= (1u << ITS_EVENT_BITS) || its_nr_lpis >= ITS_NR_LPIS)
+        return -1;
+
+    /* Targets that have not enabled LPIs yet get the boot core */
+    if (cpu >= MAX_CPUS || !its_coll_mapped[cpu])
+        cpu = 0;
+
+    if (!its_coll_mapped[cpu] || !its_get_device(devid))
+        return -1;
+
+    uint32_t idx = its_nr_lpis;
+    uint32_t lpi = ITS_LPI_BASE + idx;
+
+    if (its_send(ITS_CMD_MAPTI | ((uint64_t)devid << 32),
+                 event | ((uint64_t)lpi << 32), cpu, cpu) < 0)
+        return -1;
+
+    its_events[idx].devid = devid;
+    its_events[idx].event = event;
+    its_events[idx].cpu   = cpu;
+    its_nr_lpis++;
+
+    klog_debug(KLOG_SUB_KERNEL, "ITS dev 0x%x event %u -> LPI %u on CPU%u", devid, event, lpi, cpu);
+    return lpi;
+}
+
+int its_route_event(uint32_t lpi, uint32_t cpu)
+{
+    uint32_t idx = lpi - ITS_LPI_BASE;
+
+    if (lpi < ITS_LPI_BASE || idx >= its_nr_lpis || cpu >= MAX_CPUS || !its_coll_mapped[cpu])
+        return -1;
+
+    struct its_event *ev = &its_events[idx];
+
+    if (its_send(ITS_CMD_MOVI | ((uint64_t)ev->devid << 32), ev->event, cpu, ev->cpu) < 0)
+        return -1;
+
+    ev->cpu = cpu;
+    return 0;
+}
+
+/* Redistributors cache the property table: INV makes them re-read one entry */
+static void its_lpi_update(uint32_t lpi, uint8_t prop)
+{
+    uint32_t idx = lpi - ITS_LPI_BASE;
+
+    if (!its_ready || lpi < ITS_LPI_BASE || lpi >= (1u << ITS_LPI_ID_BITS))
+        return;
+
+    its_lpi_prop[idx] = prop;
+    asm volatile("dsb ishst" ::: "memory");
+
+    if (idx < its_nr_lpis) {
+        struct its_event *ev = &its_events[idx];
+        its_send(ITS_CMD_INV | ((uint64_t)ev->devid << 32), ev->event, 0, ev->cpu);
+    }
+}
+
+void its_lpi_set_priority(uint32_t lpi, uint8_t priority)
+{
+    uint32_t idx = lpi - ITS_LPI_BASE;
+
+    if (lpi >= ITS_LPI_BASE && lpi < (1u << ITS_LPI_ID_BITS))
+        its_lpi_update(lpi, (priority & 0xFC) | LPI_PROP_GROUP1 |
+                            (its_lpi_prop[idx] & LPI_PROP_ENABLED));
+}
+
+void its_lpi_enable(uint32_t lpi, int enable)
+{
+    uint32_t idx = lpi - ITS_LPI_BASE;
+
+    if (lpi >= ITS_LPI_BASE && lpi < (1u << ITS_LPI_ID_BITS))
+        its_lpi_update(lpi, (its_lpi_prop[idx] & ~LPI_PROP_ENABLED) |
+                            (enable ? LPI_PROP_ENABLED : 0));
+}
+
+#else /* No ITS on this board */
+
+int  its_init(void) { return -1; }
+void its_cpu_init(uint64_t rd_base) { (void)rd_base; }
+int  its_present(void) { return 0; }
+uint64_t its_doorbell(void) { return 0; }
+int  its_map_event(uint32_t devid, uint32_t event, uint32_t cpu) { (void)devid; (void)event; (void)cpu; return -1; }
+int  its_route_event(uint32_t lpi, uint32_t cpu) { (void)lpi; (void)cpu; return -1; }
+void its_lpi_set_priority(uint32_t lpi, uint8_t priority) { (void)lpi; (void)priority; }
+void its_lpi_enable(uint32_t lpi, int enable) { (void)lpi; (void)enable; }
+
+#endif
@@ -3,13 +3,24 @@
 #include "kernel/gic.h"
 #include "kernel/timer.h"
 #include "kernel/mmu.h"
+#include "kernel/fpsimd.h"
+#include "kernel/klog.h"
+#include "kernel/tui.h"
+#include "kernel/idle.h"
+#include "kernel/smp.h"
+#include "kernel/sched.h"
+#include "kernel/thread.h"
+#include "kernel/fiber.h"
+#include "kernel/atomic.h"
 #include "kernel/memory.h"
+#include "kernel/dma.h"
 #include "drivers/pcie.h"
 #include "drivers/usb/xhci.h"
 #include "portal.h"
 #include "drivers/psci.h"
 #include "kernel/health.h"
 #include "drivers/ethernet/tcp/tcp.h"
+#include "drivers/ethernet/socket.h"
 
 #include "drivers/virtio/virtio_pci.h"
 #include "drivers/virtio/virtio_net.h"
@@ -45,191 +56,285 @@ extern struct virtio_pci_device *global_vnet_dev;
 void kernel_shutdown(void);
 
 /* =====================================================
-   Kernel Entry
+   Main Loop Tasks
    ===================================================== */
 
-void kernel_main(void)
+#define UI_REFRESH_NS   (100 * NSEC_PER_MSEC)
+#define CONSOLE_BENCH_FRAMES  100000
+
+static int net_rx_poll(void *arg, int budget)
 {
-    uart_init();
+    /* Flushes GRO and reposts the batch's RX buffers itself */
+    return virtio_net_poll(arg, budget);
+}
 
-    uint32_t aether_ip = ntohl(AETHER_IP_ADDR);
-    /* Splash */
-    char *banner     = _binary_assets_banner_txt_start;
-    char *banner_end = _binary_assets_banner_txt_end;
+static int net_tx_poll(void *arg, int budget)
+{
+    (void)arg;
+    return net_tx_reaper(budget);
+}
 
-    while (banner < banner_end) {
-        if (*banner == '\n')
-            uart_putc('\r');
-        uart_putc(*banner++);
-    }
+static int health_poll(void *arg, int budget)
+{
+    (void)arg;
+    (void)budget;
+    health_update_tcp_stats();
+    return 0;
+}
 
-    uart_puts("\r\n[OK] Aether Core Online.\r\n");
+static int klog_poll(void *arg, int budget)
+{
+    (void)arg;
+    return klog_drain(budget);
+}
 
-    /* Core */
-    exceptions_init();
-    mmu_init();
-    kmalloc_init();
-    pcie_init();
-    gic_init();
-    timer_init();
-    enable_interrupts();
+static int ui_refresh_poll(void *arg, int budget)
+{
+    static kernel_mode_t last_mode = -1;
 
-    tcp_init();
+    (void)arg;
+    (void)budget;
 
-    /* UI Setup */
-    uint64_t last_refresh = 0;
-    int esc_state = 0;
+    portal_refresh_state();
 
-    portal_start();
+    if (current_mode != last_mode) {
 
-    /* =====================================================
-       Main Loop
-       ===================================================== */
+        uart_puts("\033[2J\033[H");
+        tui_invalidate();
+        last_mode = current_mode;
 
-    while (1) {
+        switch (current_mode) {
 
-        uint64_t current_time = get_system_uptime_ms();
-        static kernel_mode_t last_mode = -1;
+            case MODE_CONFIRM_SHUTDOWN:
+                portal_render_confirm_prompt();
+                break;
 
-        /* -------------------------------------------------
-           UI REFRESH
-           ------------------------------------------------- */
+            case MODE_NET_STATS:
+                portal_render_net_dashboard();
+                break;
 
-        if (current_time - last_refresh >= 100) {
+            case MODE_DEBUG:
+                uart_puts("===========================================\r\n");
+                uart_puts("           AETHER DEBUG CONSOLE            \r\n");
+                uart_puts("===========================================\r\n\r\n");
+                break;
 
-            portal_refresh_state();
+            case MODE_PORTAL:
+            default:
+                portal_render_terminal();
+                break;
+        }
+    }
+    else {
+        /* IMPORTANT: Do NOT redraw debug screen */
+        switch (current_mode) {
 
-            if (current_mode != last_mode) {
+            case MODE_NET_STATS:
+                portal_render_net_dashboard();
+                break;
 
-                uart_puts("\033[2J\033[H");
-                last_mode = current_mode;
+            case MODE_DEBUG:
+            default:
+                break;
+        }
+    }
 
-                switch (current_mode) {
+    return 0;
+}
 
-                    case MODE_CONFIRM_SHUTDOWN:
-                        portal_render_confirm_prompt();
-                        break;
+/* F8: TX ring benchmark on this core's queue pair */
+static void console_run_bench(void)
+{
+    char report[128];
 
-                    case MODE_NET_STATS:
-                        portal_render_net_dashboard();
-                        break;
+    uart_puts("\r\n[INFO] Ring benchmark: ");
+    uart_put_int(CONSOLE_BENCH_FRAMES);
+    uart_puts(" frames...\r\n");
 
-                    case MODE_DEBUG:
-                        uart_puts("===========================================\r\n");
-                        uart_puts("           AETHER DEBUG CONSOLE            \r\n");
-                        uart_puts("===========================================\r\n\r\n");
-                        break;
+    virtio_net_bench(CONSOLE_BENCH_FRAMES, report, sizeof(report));
+    uart_puts(report);
+    uart_puts("\r");
+}
 
-                    case MODE_PORTAL:
-                    default:
-                        portal_render_terminal();
-                        break;
-                }
-            }
-            else {
-                /* IMPORTANT: Do NOT redraw debug screen */
-                switch (current_mode) {
-
-                    case MODE_NET_STATS:
-                        portal_render_net_dashboard();
-                        break;
-
-                    case MODE_DEBUG:
-                    default:
-                        break;
-                }
-            }
+/* UART escape-sequence parser: F1 debug, F7 shutdown, F8 ring bench, F10 net stats */
+static void console_handle_key(unsigned char c)
+{
+    static int esc_state = 0;
+
+    if (c == 0x1B) {
+        esc_state = 1;
+        return;
+    }
+
+    if (esc_state == 1) {
+        if (c == '[') {
+            esc_state = 2;
+            return;
+        }
+        else if (c == 'O') {
+            esc_state = 20;   /* F1–F4 */
+            return;
+        }
+        else {
+            esc_state = 0;
+        }
+    }
 
-            last_refresh = current_time;
+    /* F1–F4 (ESC O P/Q/R/S) */
+    if (esc_state == 20) {
+        if (c == 'P') {  /* F1 */
+            uart_puts("\033[2J\033[H");
+            current_mode = MODE_DEBUG;
         }
+        esc_state = 0;
+        return;
+    }
 
-        /* -------------------------------------------------
-           INPUT HANDLING
-           ------------------------------------------------- */
+    /* F5+ (ESC [ number ~) */
+    if (esc_state == 2) {
 
-        if (!(*UART0_FR & (1 << 4))) {
+        static int num = 0;
 
-            unsigned char c = uart_getc();
+        if (c >= '0' && c <= '9') {
+            num = num * 10 + (c - '0');
+            return;
+        }
 
-            if (c == 0x1B) {
-                esc_state = 1;
-                continue;
-            }
+        if (c == '~') {
 
-            if (esc_state == 1) {
-                if (c == '[') {
-                    esc_state = 2;
-                    continue;
-                }
-                else if (c == 'O') {
-                    esc_state = 20;   /* F1–F4 */
-                    continue;
-                }
-                else {
-                    esc_state = 0;
-                }
-            }
+            switch (num) {
 
-            /* F1–F4 (ESC O P/Q/R/S) */
-            if (esc_state == 20) {
-                if (c == 'P') {  /* F1 */
+                case 18:   /* F7 */
                     uart_puts("\033[2J\033[H");
-                    current_mode = MODE_DEBUG;
-                }
-                esc_state = 0;
-                continue;
+                    current_mode = MODE_CONFIRM_SHUTDOWN;
+                    break;
+
+                case 21:   /* F10 */
+                    uart_puts("\033[2J\033[H");
+                    current_mode = MODE_NET_STATS;
+                    break;
+
+                case 19:   /* F8 */
+                    console_run_bench();
+                    break;
             }
 
-            /* F5+ (ESC [ number ~) */
-            if (esc_state == 2) {
+            num = 0;
+            esc_state = 0;
+            return;
+        }
 
-                static int num = 0;
+        esc_state = 0;
+    }
 
-                if (c >= '0' && c <= '9') {
-                    num = num * 10 + (c - '0');
-                    continue;
-                }
+    esc_state = 0;
+}
 
-                if (c == '~') {
+static int console_input_poll(void *arg, int budget)
+{
+    int done = 0;
 
-                    switch (num) {
+    (void)arg;
 
-                        case 18:   /* F7 */
-                            uart_puts("\033[2J\033[H");
-                            current_mode = MODE_CONFIRM_SHUTDOWN;
-                            break;
+    while (done < budget && !uart_is_empty()) {
+        console_handle_key(uart_getc());
+        done++;
+    }
 
-                        case 21:   /* F10 */
-                            uart_puts("\033[2J\033[H");
-                            current_mode = MODE_NET_STATS;
-                            break;
+    return done;
+}
 
-                        case 19:   /* F8 */
-                            /* Add if needed */
-                            break;
-                    }
+/* =====================================================
+   Kernel Entry
+   ===================================================== */
 
-                    num = 0;
-                    esc_state = 0;
-                    continue;
-                }
+void kernel_main(void)
+{
+    uart_init();
 
-                esc_state = 0;
-            }
+    uint32_t aether_ip = ntohl(AETHER_IP_ADDR);
+    /* Splash */
+    char *banner     = _binary_assets_banner_txt_start;
+    char *banner_end = _binary_assets_banner_txt_end;
 
-            esc_state = 0;
-        }
+    while (banner < banner_end) {
+        if (*banner == '\n')
+            uart_putc('\r');
+        uart_putc(*banner++);
+    }
 
-        /* -------------------------------------------------
-           NETWORK POLLING
-           ------------------------------------------------- */
+    uart_puts("\r\n[OK] Aether Core Online.\r\n");
 
-        if (global_vnet_dev) {
-            virtio_net_poll(global_vnet_dev);
-            net_tx_reaper();
-        }
+    /* Core */
+    exceptions_init();
+    atomic_init();
+    fpsimd_init();
+    mmu_init();
+    kmalloc_init();
+    dma_init();             /* Before PCIe: drivers take their rings from it */
+    gic_init();             /* Before PCIe: MSI-X vectors need the ITS */
+    pcie_init();
+    uart_irq_init();
+    timer_init();
+    idle_init();
+    sched_init();
+    thread_init();
+    enable_interrupts();
+    smp_init();
+
+    tcp_init();
+    fiber_init();
+    socket_init();
+
+    /* Needs the secondaries online and every core's fiber pool ready */
+    if (global_vnet_dev)
+        virtio_net_enable_mq(global_vnet_dev);
+
+    portal_start();
+
+    /* =====================================================
+       Scheduler: subsystems as prioritised pollers
+       ===================================================== */
+
+    static struct sched_poller net_rx_poller, net_tx_poller, input_poller,
+                               ui_poller, health_poller, klog_poller;
+
+    /* Queues with an MSI-X vector are driven by NAPI instead */
+    if (global_vnet_dev) {
+        if (global_vnet_dev->rx_lpi < 0)
+            sched_register_poller(&net_rx_poller, "net_rx", net_rx_poll, global_vnet_dev,
+                                  SCHED_PRIO_NET, 64, 0);
+        else
+            idle_set_max_sleep(0);
+
+        if (global_vnet_dev->tx_lpi < 0)
+            sched_register_poller(&net_tx_poller, "net_tx", net_tx_poll, 0,
+                                  SCHED_PRIO_NET, 64, 0);
+    }
+
+    sched_register_poller(&input_poller,  "input",  console_input_poll, 0,
+                          SCHED_PRIO_INPUT, 16, 0);
+    sched_register_poller(&ui_poller,     "ui",     ui_refresh_poll, 0,
+                          SCHED_PRIO_UI, 1, UI_REFRESH_NS);
+    sched_register_poller(&health_poller, "health", health_poll, 0,
+                          SCHED_PRIO_BG, 1, UI_REFRESH_NS);
+    sched_register_poller(&klog_poller,   "klog",   klog_poll, 0,
+                          SCHED_PRIO_BG, 16, 0);
+
+    /* =====================================================
+       Main Loop
+       ===================================================== */
+
+    while (1) {
+        int did_work = sched_run_once();
+
+        /* Handler threads share our priority: let them in every pass */
+        if (thread_others_ready())
+            thread_yield();
 
-        health_update_tcp_stats();
+        /* Busy-poll window, then WFI until the next periodic task */
+        idle_note_activity(did_work);
+        idle_enter(sched_next_deadline());
     }
 }
 
@@ -245,6 +350,7 @@ void kernel_shutdown(void)
     uart_puts("===========================================\r\n");
 
     asm volatile("msr daifset, #2");
+    uart_console_sync();
 
     if (global_vnet_dev)
         virtio_pci_reset(global_vnet_dev);
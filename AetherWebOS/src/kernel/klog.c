@@ -0,0 +1,293 @@
+#include "kernel/klog.h"
+#include "kernel/timer.h"
+#include "kernel/mode.h"
+#include "drivers/uart.h"
+
+/* =====================================================
+   Ring State
+   ===================================================== */
+
+static struct klog_record klog_ring[KLOG_RING_SIZE];
+
+static volatile uint32_t klog_head = 0;   /* Next ticket to hand out */
+static uint32_t klog_tail = 0;            /* Next ticket the drain formats */
+
+static klog_stats_t klog_stats;
+
+static const char *const level_names[] = { "ERR ", "WARN", "INFO", "DBG ", "TRC " };
+
+static const char *const subsys_names[KLOG_SUB_COUNT] = {
+    "KERN", "MM  ", "UART", "PCIE", "VIRT", "NET ",
+    "ARP ", "IP  ", "TCP ", "HTTP", "USB "
+};
+
+/* =====================================================
+   Producer (any context, no locks)
+   ===================================================== */
+
+void klog_write(uint8_t level, uint8_t subsys, const char *fmt,
+                const uint64_t *args, uint32_t nargs)
+{
+    uint32_t ticket = __atomic_fetch_add(&klog_head, 1, __ATOMIC_RELAXED);
+    struct klog_record *r = &klog_ring[ticket & (KLOG_RING_SIZE - 1)];
+
+    /* Invalidate first so readers never see a half-written record */
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELEASE);
+
+    /* Release only orders what came before: keep the record stores behind it */
+    asm volatile("dmb ishst" ::: "memory");
+
+    r->level     = level;
+    r->subsys    = subsys;
+    r->nargs     = (uint8_t)nargs;
+    r->timestamp = timer_get_ns();
+    r->fmt       = fmt;
+
+    for (uint32_t i = 0; i < nargs; i++)
+        r->args[i] = args[i];
+
+    __atomic_store_n(&r->seq, ticket + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&klog_stats.written, 1, __ATOMIC_RELAXED);
+}
+
+/* =====================================================
+   Deferred Formatter
+   ===================================================== */
+
+typedef struct {
+    char    *out;
+    uint32_t pos;
+    uint32_t size;
+} klog_buf_t;
+
+static void kb_putc(klog_buf_t *b, char c)
+{
+    if (b->pos + 1 < b->size)
+        b->out[b->pos++] = c;
+}
+
+static void kb_puts(klog_buf_t *b, const char *s)
+{
+    while (s && *s)
+        kb_putc(b, *s++);
+}
+
+static void kb_put_dec(klog_buf_t *b, uint64_t v, int min_width)
+{
+    char tmp[21];
+    int i = 0;
+
+    do {
+        tmp[i++] = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+
+    while (i < min_width)
+        tmp[i++] = '0';
+
+    while (i--)
+        kb_putc(b, tmp[i]);
+}
+
+static void kb_put_hex(klog_buf_t *b, uint64_t v, int min_width)
+{
+    const char *hex = "0123456789abcdef";
+    char tmp[16];
+    int i = 0;
+
+    do {
+        tmp[i++] = hex[v & 0xF];
+        v >>= 4;
+    } while (v);
+
+    while (i < min_width)
+        tmp[i++] = '0';
+
+    while (i--)
+        kb_putc(b, tmp[i]);
+}
+
+static void kb_format(klog_buf_t *b, const struct klog_record *r)
+{
+    uint64_t us = r->timestamp / NSEC_PER_USEC;
+    uint8_t level  = r->level  <= KLOG_TRACE   ? r->level  : KLOG_TRACE;
+    uint8_t subsys = r->subsys < KLOG_SUB_COUNT ? r->subsys : KLOG_SUB_KERNEL;
+
+    kb_putc(b, '[');
+    kb_put_dec(b, us / 1000000, 5);
+    kb_putc(b, '.');
+    kb_put_dec(b, us % 1000000, 6);
+    kb_puts(b, "] ");
+    kb_puts(b, subsys_names[subsys]);
+    kb_putc(b, ' ');
+    kb_puts(b, level_names[level]);
+    kb_putc(b, ' ');
+
+    const char *f = r->fmt;
+    uint32_t arg = 0;
+
+    while (*f) {
+        if (*f != '%') {
+            kb_putc(b, *f++);
+            continue;
+        }
+
+        f++;
+        while (*f == 'l')
+            f++;
+
+        if (*f == '%') {
+            kb_putc(b, '%');
+            f++;
+            continue;
+        }
+
+        uint64_t v = (arg < r->nargs) ? r->args[arg++] : 0;
+
+        switch (*f) {
+            case 'u': kb_put_dec(b, v, 0); break;
+            case 'd':
+                if ((int64_t)v < 0) {
+                    kb_putc(b, '-');
+                    v = (uint64_t)(-(int64_t)v);
+                }
+                kb_put_dec(b, v, 0);
+                break;
+            case 'x': kb_put_hex(b, v, 0); break;
+            case 'c': kb_putc(b, (char)v); break;
+            case 's': kb_puts(b, (const char *)(uintptr_t)v); break;
+            case 'I':
+                for (int i = 3; i >= 0; i--) {
+                    kb_put_dec(b, (v >> (i * 8)) & 0xFF, 0);
+                    if (i) kb_putc(b, '.');
+                }
+                break;
+            case 'M':
+                for (int i = 5; i >= 0; i--) {
+                    kb_put_hex(b, (v >> (i * 8)) & 0xFF, 2);
+                    if (i) kb_putc(b, ':');
+                }
+                break;
+            default:
+                kb_putc(b, '?');
+                break;
+        }
+
+        if (*f)
+            f++;
+    }
+
+    kb_putc(b, '\n');
+    b->out[b->pos] = '\0';
+}
+
+/**
+ * klog_copy_record: Reads ticket @t into @dst.
+ * Returns 1 on success, 0 if the slot was overwritten by a newer
+ * record and -1 if ticket @t has not been committed yet.
+ */
+static int klog_copy_record(uint32_t t, struct klog_record *dst)
+{
+    const struct klog_record *src = &klog_ring[t & (KLOG_RING_SIZE - 1)];
+
+    uint32_t s1 = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+    if (s1 != t + 1)
+        return (s1 != 0 && (int32_t)(s1 - (t + 1)) > 0) ? 0 : -1;
+
+    *dst = *src;
+
+    asm volatile("dmb ish" ::: "memory");
+    return __atomic_load_n(&src->seq, __ATOMIC_RELAXED) == s1;
+}
+
+/* =====================================================
+   Consumers
+   ===================================================== */
+
+/**
+ * klog_drain: Low-priority consumer. Formats pending records and
+ * echoes them to the UART while the DEBUG console is on screen.
+ */
+uint32_t klog_drain(uint32_t budget)
+{
+    uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+    uint32_t done = 0;
+
+    if (head - klog_tail > KLOG_RING_SIZE) {
+        klog_stats.overwritten += head - klog_tail - KLOG_RING_SIZE;
+        klog_tail = head - KLOG_RING_SIZE;
+    }
+
+    while (klog_tail != head && done < budget) {
+        struct klog_record rec;
+
+        int rc = klog_copy_record(klog_tail, &rec);
+
+        if (rc < 0)
+            break;                  /* Still being written: retry next drain */
+
+        if (rc == 0) {
+            klog_stats.overwritten++;
+            klog_tail++;
+            continue;
+        }
+
+        if (current_mode == MODE_DEBUG) {
+            char line[160];
+            klog_buf_t b = { line, 0, sizeof(line) };
+            kb_format(&b, &rec);
+            uart_puts(line);
+        }
+
+        klog_tail++;
+        klog_stats.drained++;
+        done++;
+    }
+
+    return done;
+}
+
+uint32_t klog_format_recent(char *out, uint32_t out_size)
+{
+    if (!out || out_size == 0)
+        return 0;
+
+    uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_ACQUIRE);
+    uint32_t avail = head < KLOG_RING_SIZE ? head : KLOG_RING_SIZE;
+
+    /* Walk back to find how many of the newest records fit */
+    uint32_t start = head;
+    uint32_t used = 0;
+
+    while (head - start < avail) {
+        struct klog_record rec;
+        char line[160];
+        klog_buf_t b = { line, 0, sizeof(line) };
+
+        if (klog_copy_record(start - 1, &rec) <= 0)
+            break;
+
+        kb_format(&b, &rec);
+        if (used + b.pos + 1 > out_size)
+            break;
+
+        used += b.pos;
+        start--;
+    }
+
+    klog_buf_t ob = { out, 0, out_size };
+    out[0] = '\0';
+
+    for (uint32_t t = start; t != head; t++) {
+        struct klog_record rec;
+        if (klog_copy_record(t, &rec) > 0)
+            kb_format(&ob, &rec);
+    }
+
+    return ob.pos;
+}
+
+const klog_stats_t *klog_get_stats(void)
+{
+    return &klog_stats;
+}
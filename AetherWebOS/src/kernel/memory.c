@@ -2,6 +2,7 @@
 #include "mmu.h"
 #include "uart.h"
 #include "common/utils.h"
+#include "kernel/spinlock.h"
 
 /* * Aether OS v0.1.2 :: Memory Management Subsystem
  * Logic by Roheet & Adrija
@@ -17,7 +18,11 @@ static uint64_t vmalloc_ptr = 0x80000000;
 #define VMALLOC_START 0x80000000
 #define VMALLOC_MAX   (VMALLOC_START + (4 * 2 * 1024 * 1024))
 
+// Guards free_list and heap_ptr (kfree can run from IRQ context)
+static spinlock_t heap_lock;
+
 void kmalloc_init() {
+    spin_lock_init(&heap_lock, "heap");
     uart_puts("[OK] Memory Subsystem: Online (Expanded L3 Support Active).\r\n");
 }
 
@@ -27,11 +32,14 @@ void* kmalloc(size_t size) {
     // 1. 8-byte alignment
     size = (size + 7) & ~7;
 
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+
     // 2. Search the free list for a reusable block
     mem_header_t *current = free_list;
     while (current) {
         if (current->is_free && current->size >= size) {
             current->is_free = 0;
+            spin_unlock_irqrestore(&heap_lock, flags);
             // Return pointer just after the header
             return (void*)(current + 1);
         }
@@ -41,6 +49,7 @@ void* kmalloc(size_t size) {
     // 3. No free block found? Bump the heap_ptr (Your original logic)
     size_t total_size = sizeof(mem_header_t) + size;
     if (heap_ptr + total_size > HEAP_START + HEAP_SIZE) {
+        spin_unlock_irqrestore(&heap_lock, flags);
         uart_puts("[ERROR] kmalloc: Heap Exhausted!\r\n");
         return NULL;
     }
@@ -52,7 +61,8 @@ void* kmalloc(size_t size) {
     free_list = header;
 
     heap_ptr += total_size;
-    
+    spin_unlock_irqrestore(&heap_lock, flags);
+
     // Return the memory address after the header
     return (void*)(header + 1);
 }
@@ -64,7 +74,9 @@ void kfree(void* ptr) {
     mem_header_t *header = (mem_header_t*)ptr - 1;
     
     // Mark as free so kmalloc can reuse it
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
     header->is_free = 1;
+    spin_unlock_irqrestore(&heap_lock, flags);
 
     // Optional: Coalescing (merging adjacent free blocks) could be added 
     // here later to prevent fragmentation as the stack grows.
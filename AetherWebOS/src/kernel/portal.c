@@ -3,18 +3,25 @@
 #include "kernel/timer.h"
 #include "drivers/uart.h"
 #include "drivers/virtio/virtio_pci.h"
+#include "drivers/virtio/virtio_net.h"
 #include "kernel/memory.h"
 #include "config.h"
 #include "common/utils.h"
 #include "kernel/health.h"
+#include "kernel/tui.h"
+#include "kernel/idle.h"
+#include "kernel/smp.h"
+#include "kernel/ipi.h"
+#include "kernel/sched.h"
+#include "kernel/spinlock.h"
 #include "drivers/ethernet/tcp/tcp_internal.h"
 #include "drivers/ethernet/ipv4.h"
 
 extern struct virtio_pci_device *global_vnet_dev;
-extern void print_ipv6(uint8_t addr[16]);
 extern uint32_t aether_ip;
 
 static portal_state_t current_state;
+static seqlock_t state_seq;     /* Renderers may run on another core */
 static int portal_active = 0;
 
 /* ===================================================== */
@@ -23,24 +30,52 @@ static int portal_active = 0;
 
 void portal_refresh_state()
 {
-    current_state.uptime_ms     = get_system_uptime_ms();
-    current_state.heap_usage_kb = get_heap_usage() / 1024;
-    current_state.device_count  = get_total_pci_devices();
+    portal_state_t next;
 
-    current_state.packets_rx = global_net_stats.rx_packets;
-    current_state.packets_tx = global_net_stats.tx_packets;
+    next.uptime_ms     = get_system_uptime_ms();
+    next.heap_usage_kb = get_heap_usage() / 1024;
+    next.device_count  = get_total_pci_devices();
+    next.ip_addr       = aether_ip;
+
+    /* CPU load = share of the interval spent in tasks that made progress */
+    static sched_stats_t prev_sched;
+    sched_stats_t sched;
+    sched_get_stats(&sched);
+
+    uint64_t busy  = sched.busy_cycles - prev_sched.busy_cycles;
+    uint64_t total = sched.total_cycles - prev_sched.total_cycles;
+    next.cpu_load = total ? (uint8_t)((busy * 100) / total) : 0;
+    prev_sched = sched;
+
+    next.packets_rx = atomic_read(&global_net_stats.rx_packets);
+    next.packets_tx = atomic_read(&global_net_stats.tx_packets);
 
     if (global_vnet_dev && global_vnet_dev->device)
     {
-        current_state.link_status = 1;
+        next.link_status = 1;
 
         for (int i = 0; i < 6; i++)
-            current_state.mac[i] = global_vnet_dev->device->mac[i];
+            next.mac[i] = global_vnet_dev->device->mac[i];
     }
     else
     {
-        current_state.link_status = 0;
+        next.link_status = 0;
     }
+
+    write_seqlock(&state_seq);
+    current_state = next;
+    write_sequnlock(&state_seq);
+}
+
+/* Consistent copy of current_state, retried if a refresh raced us */
+static void portal_snapshot_state(portal_state_t *out)
+{
+    uint32_t seq;
+
+    do {
+        seq = read_seqbegin(&state_seq);
+        *out = current_state;
+    } while (read_seqretry(&state_seq, seq));
 }
 
 /* ===================================================== */
@@ -49,6 +84,7 @@ void portal_refresh_state()
 
 void portal_start()
 {
+    seqlock_init(&state_seq, "portal_state");
     portal_active = 1;
     uart_puts("\033[2J\033[H");
 }
@@ -57,80 +93,178 @@ void portal_start()
 /* NETWORK DASHBOARD                                    */
 /* ===================================================== */
 
+/* Per-connection lines shown at most, grid space permitting */
+#define DASH_MAX_CONN_LINES   4
+
+/* Rows drawn after the connection list: totals, [CPU], [CONSOLE], footer.
+   The footer's trailing newline does not need a row of its own. */
+#define DASH_TAIL_ROWS        13
+
 void portal_render_net_dashboard()
 {
     if (!portal_active)
         return;
 
-    uart_puts("\033[H");
+    portal_state_t state;
+    portal_snapshot_state(&state);
+
+    tui_begin();
 
-    uart_puts("#################################################\n");
-    uart_puts("#           AETHER NETWORK DASHBOARD            #\n");
-    uart_puts("#################################################\n\n");
+    tui_puts("#################################################\n");
+    tui_puts("#           AETHER NETWORK DASHBOARD            #\n");
+    tui_puts("#################################################\n\n");
 
-    uart_puts("[LINK LAYER]\n");
-    uart_puts(" - Interface: eth0 (VirtIO-Net-PCI)\n");
-    uart_puts(" - Status:    ");
-    uart_puts(current_state.link_status ? "UP\n" : "DOWN\n");
+    tui_puts("[LINK LAYER]\n");
+    tui_puts(" - Interface: eth0 (VirtIO-Net-PCI)\n");
+    tui_puts(" - Status:    ");
+    tui_puts(state.link_status ? "UP\n" : "DOWN\n");
 
-    uart_puts(" - MAC:       ");
+    tui_puts(" - MAC:       ");
     for (int i = 0; i < 6; i++)
     {
-        uart_put_hex_byte(current_state.mac[i]);
-        if (i < 5) uart_putc(':');
+        tui_put_hex_byte(state.mac[i]);
+        if (i < 5) tui_putc(':');
     }
-    uart_puts("\n\n");
-
-    uart_puts("[NETWORK LAYER]\n");
-    uart_puts(" - IPv4 Addr: ");
-    uart_print_ip(aether_ip);
-    uart_puts("\n");
-    uart_puts(" - IPv6 Addr: ");
-    print_ipv6(local_ipv6);
-    uart_puts("\n\n");
-
-    uart_puts("[TRAFFIC STATS]\n");
-    uart_puts(" - RX Frames:        ");
-    uart_put_int(global_net_stats.rx_packets);
-    uart_puts("\n");
-
-    uart_puts(" - TX Frames:        ");
-    uart_put_int(global_net_stats.tx_packets);
-    uart_puts("\n");
-
-    uart_puts(" - Collisions/Drops: ");
-    uart_put_int(global_net_stats.dropped_packets);
-    uart_puts("\n");
-
-    uart_puts(" - Mem Buffers:      ");
-    uart_put_int(global_net_stats.buffer_usage);
-    uart_puts("\n\n");
-
-    uart_puts("[TRANSPORT LAYER]\n");
-    uart_puts(" - TCP Listener: Port 80 (HTTP)\n");
+    tui_puts("\n\n");
+
+    tui_puts("[NETWORK LAYER]\n");
+    tui_puts(" - IPv4 Addr: ");
+    tui_put_ip(aether_ip);
+    tui_puts("\n");
+    tui_puts(" - IPv6 Addr: ");
+    tui_put_ipv6(local_ipv6);
+    tui_puts("\n\n");
+
+    tui_puts("[TRAFFIC STATS]\n");
+    tui_puts(" - RX Frames:        ");
+    tui_put_int(global_net_stats.rx_packets);
+    tui_puts("\n");
+
+    tui_puts(" - TX Frames:        ");
+    tui_put_int(global_net_stats.tx_packets);
+    tui_puts("\n");
+
+    tui_puts(" - Collisions/Drops: ");
+    tui_put_int(global_net_stats.dropped_packets);
+    tui_puts("\n");
+
+    tui_puts(" - Mem Buffers:      ");
+    tui_put_int(global_net_stats.buffer_usage);
+    tui_puts("\n");
+
+    unsigned long rx_irqs = 0, rx_polled = 0;
+    for (uint16_t p = 0; p < virtio_net_nr_pairs(); p++) {
+        vnet_napi_stats_t napi;
+        virtio_net_get_napi_stats(VNET_RXQ(p), &napi);
+        rx_irqs += napi.irqs;
+        rx_polled += napi.packets;
+    }
+    tui_puts(" - RX IRQs / Polled: ");
+    tui_put_int(rx_irqs);
+    tui_puts(" / ");
+    tui_put_int(rx_polled);
+    tui_puts("\n");
+
+    tui_puts(" - Csum NIC / SW:    ");
+    tui_put_int(global_net_stats.csum_tx_offload + global_net_stats.csum_rx_offload);
+    tui_puts(" / ");
+    tui_put_int(global_net_stats.csum_tx_sw + global_net_stats.csum_rx_sw);
+    tui_puts("\n");
+
+    tui_puts(" - TSO Sends/Frames: ");
+    tui_put_int(global_net_stats.tso_sends);
+    tui_puts(" / ");
+    tui_put_int(global_net_stats.tso_frames);
+    tui_puts("\n\n");
+
+    tui_puts("[TRANSPORT LAYER]\n");
+    tui_puts(" - TCP Listener: Port 80 (HTTP)\n");
+
+    /* Connection lines get whatever the sections below leave free */
+    uint32_t room = tui_rows_left();
+    uint32_t cap = room > DASH_TAIL_ROWS ? room - DASH_TAIL_ROWS : 0;
+    if (cap > DASH_MAX_CONN_LINES)
+        cap = DASH_MAX_CONN_LINES;
 
     /* Count active ESTABLISHED connections */
     uint32_t active = 0;
-    tcp_tcb_t *cur = tcp_tcb_list;
+    uint32_t listed = 0;
+    tcp_state_t states[DASH_MAX_CONN_LINES];
 
-    while (cur)
+    struct mcs_node node;
+    uint64_t flags = mcs_lock_irqsave(&tcp_tcb_lock, &node);
+    for (tcp_tcb_t *cur = tcp_tcb_list; cur; cur = cur->next)
     {
         if (cur->state == TCP_STATE_ESTABLISHED)
             active++;
 
-        cur = cur->next;
-
-        uart_puts(" - Debug State: ");
-        uart_put_int(cur->state);
-        uart_puts("\n");
+        if (listed < cap)
+            states[listed++] = cur->state;
     }
+    mcs_unlock_irqrestore(&tcp_tcb_lock, &node, flags);
 
-    uart_puts(" - Active Connections: ");
-    uart_put_int(active);
-    uart_puts("\n");
+    for (uint32_t i = 0; i < listed; i++)
+    {
+        tui_puts(" - Debug State: ");
+        tui_put_int(states[i]);
+        tui_puts("\n");
+    }
 
-    uart_puts("\n-------------------------------------------------\n");
-    uart_puts(" [ESC] Main Portal  |  [ENTER] Refresh\n");
+    tui_puts(" - Active Connections: ");
+    tui_put_int(active);
+    tui_puts("\n\n");
+
+    idle_stats_t idle;
+    idle_get_stats(&idle);
+    tui_puts("[CPU]\n");
+    tui_puts(" - Cores Online:     ");
+    tui_put_int(smp_num_online());
+    tui_puts("/");
+    tui_put_int(MAX_CPUS);
+
+    /* Mailbox traffic delivered to all cores */
+    unsigned long ipi_msgs = 0;
+    uint64_t ipi_lat_ns = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        ipi_stats_t ipi;
+        ipi_get_stats(cpu, &ipi);
+        ipi_msgs += ipi.received;
+        ipi_lat_ns += ipi.lat_total_ns;
+    }
+    tui_puts("  (IPIs ");
+    tui_put_int(ipi_msgs);
+    tui_puts(", avg ");
+    tui_put_int(ipi_msgs ? ipi_lat_ns / ipi_msgs / NSEC_PER_USEC : 0);
+    tui_puts(" us)\n");
+    tui_puts(" - Load (tasks):     ");
+    tui_put_int(state.cpu_load);
+    tui_puts("%\n");
+    tui_puts(" - WFI Entries:      ");
+    tui_put_int(idle.wfi_entries);
+    tui_puts("  (idle ");
+    tui_put_int(idle.idle_ns / NSEC_PER_MSEC);
+    tui_puts(" ms / busy ");
+    tui_put_int(idle.busy_ns / NSEC_PER_MSEC);
+    tui_puts(" ms)\n\n");
+
+    const uart_stats_t *con = uart_get_stats();
+    const tui_stats_t *scr = tui_get_stats();
+    tui_puts("[CONSOLE]\n");
+    tui_puts(" - TX Dropped:       ");
+    tui_put_int(con->tx_dropped);
+    tui_puts("\n");
+    tui_puts(" - RX Overflows:     ");
+    tui_put_int(con->rx_overflows + con->hw_overruns);
+    tui_puts("\n");
+    tui_puts(" - Redraw Bytes:     ");
+    tui_put_int(scr->frames ? scr->bytes / scr->frames : 0);
+    tui_puts(" avg/frame\n");
+
+    tui_puts("\n-------------------------------------------------\n");
+    tui_puts(" [ESC] Main Portal  |  [ENTER] Refresh\n");
+
+    tui_flush(TUI_REFRESH_BUDGET);
 }
 
 /* ===================================================== */
@@ -142,6 +276,9 @@ void portal_render_terminal()
     if (!portal_active)
         return;
 
+    portal_state_t state;
+    portal_snapshot_state(&state);
+
     uart_puts("\033[2J\033[H");
 
     uart_puts("===========================================\n");
@@ -150,7 +287,7 @@ void portal_render_terminal()
 
     uart_puts("[STATUS]  System Online\n");
 
-    //uint64_t ms = current_state.uptime_ms;
+    //uint64_t ms = state.uptime_ms;
     //uint32_t sec = (uint32_t)(ms / 1000);
 
     //uart_puts("[UPTIME]  ");
@@ -159,11 +296,11 @@ void portal_render_terminal()
     //uart_put_int(ms % 1000); uart_puts("ms\n");
 
     uart_puts("[MEMORY]  Used: ");
-    uart_put_int(current_state.heap_usage_kb);
+    uart_put_int(state.heap_usage_kb);
     uart_puts(" KB\n");
 
     uart_puts("[NETWORK] ");
-    uart_puts(current_state.link_status ? "UP\n" : "DOWN\n");
+    uart_puts(state.link_status ? "UP\n" : "DOWN\n");
 
     uart_puts("-------------------------------------------\n");
     uart_puts("Aether Ready.\n");
@@ -0,0 +1,273 @@
+#include "kernel/sched.h"
+#include "kernel/smp.h"
+#include "kernel/ipi.h"
+#include "kernel/timer.h"
+#include "kernel/irqflags.h"
+#include "drivers/uart.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Per-CPU Run Lists
+   ===================================================== */
+
+struct sched_cpu {
+    struct sched_poller *pollers;                   /* Sorted by prio */
+    struct sched_work   *work_head[SCHED_NR_PRIO];
+    struct sched_work   *work_tail[SCHED_NR_PRIO];
+    uint64_t             start_cycles;
+    sched_stats_t        stats;
+} __attribute__((aligned(64)));
+
+static struct sched_cpu sched_cpus[MAX_CPUS];
+
+static inline struct sched_cpu *this_rq(void)
+{
+    return &sched_cpus[smp_processor_id()];
+}
+
+void sched_init(void)
+{
+    uint64_t now = timer_read_counter();
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+        sched_cpus[cpu].start_cycles = now;
+
+    uart_puts("[OK] Scheduler: Cooperative pollers + deferred work.\r\n");
+}
+
+/* =====================================================
+   Registration
+   ===================================================== */
+
+void sched_register_poller(struct sched_poller *p, const char *name,
+                           sched_poll_fn fn, void *arg,
+                           uint8_t prio, uint16_t budget, uint64_t interval_ns)
+{
+    struct sched_cpu *rq = this_rq();
+
+    p->name        = name;
+    p->fn          = fn;
+    p->arg         = arg;
+    p->prio        = prio < SCHED_NR_PRIO ? prio : SCHED_PRIO_BG;
+    p->budget      = budget ? budget : 1;
+    p->interval_ns = interval_ns;
+    p->due_ns      = timer_get_ns();
+    p->runs        = 0;
+    p->work        = 0;
+    p->deferred    = 0;
+    p->cycles      = 0;
+    p->max_cycles  = 0;
+
+    /* Insert after the last poller of the same priority */
+    struct sched_poller **link = &rq->pollers;
+    while (*link && (*link)->prio <= p->prio)
+        link = &(*link)->next;
+
+    p->next = *link;
+    *link = p;
+}
+
+/* =====================================================
+   Deferred Work
+   ===================================================== */
+
+void sched_init_work(struct sched_work *w, sched_work_fn fn, void *data, uint8_t prio)
+{
+    w->fn      = fn;
+    w->data    = data;
+    w->prio    = prio < SCHED_NR_PRIO ? prio : SCHED_PRIO_BG;
+    w->pending = 0;
+    w->next    = 0;
+}
+
+int sched_queue_work(struct sched_work *w)
+{
+    uint64_t flags = local_irq_save();
+    struct sched_cpu *rq = this_rq();
+
+    if (w->pending) {
+        local_irq_restore(flags);
+        return 0;
+    }
+
+    w->pending = 1;
+    w->next = 0;
+
+    if (rq->work_tail[w->prio])
+        rq->work_tail[w->prio]->next = w;
+    else
+        rq->work_head[w->prio] = w;
+    rq->work_tail[w->prio] = w;
+
+    local_irq_restore(flags);
+    return 1;
+}
+
+static void sched_work_ipi(void *arg)
+{
+    sched_queue_work((struct sched_work *)arg);
+}
+
+int sched_queue_work_on(uint32_t cpu, struct sched_work *w)
+{
+    return smp_call_on(cpu, sched_work_ipi, w);
+}
+
+static int sched_run_work(struct sched_cpu *rq, uint8_t prio)
+{
+    int ran = 0;
+
+    while (ran < SCHED_WORK_BUDGET) {
+        uint64_t flags = local_irq_save();
+        struct sched_work *w = rq->work_head[prio];
+
+        if (!w) {
+            local_irq_restore(flags);
+            break;
+        }
+
+        rq->work_head[prio] = w->next;
+        if (!rq->work_head[prio])
+            rq->work_tail[prio] = 0;
+
+        /* Clear before running so the callback may requeue itself */
+        w->pending = 0;
+        local_irq_restore(flags);
+
+        uint64_t t0 = timer_read_counter();
+        w->fn(w);
+        rq->stats.busy_cycles += timer_read_counter() - t0;
+
+        rq->stats.work_items++;
+        ran++;
+    }
+
+    return ran;
+}
+
+int sched_has_pending_work(void)
+{
+    struct sched_cpu *rq = this_rq();
+
+    for (int prio = 0; prio < SCHED_NR_PRIO; prio++)
+        if (rq->work_head[prio])
+            return 1;
+
+    return 0;
+}
+
+/* =====================================================
+   Main Pass
+   ===================================================== */
+
+int sched_run_once(void)
+{
+    struct sched_cpu *rq = this_rq();
+    uint64_t now = timer_get_ns();
+    int progress = 0;
+    int saturated = 0;      /* A higher priority ran out of budget */
+
+    rq->stats.passes++;
+
+    for (uint8_t prio = 0; prio < SCHED_NR_PRIO; prio++) {
+        int prio_saturated = 0;
+
+        for (struct sched_poller *p = rq->pollers; p; p = p->next) {
+            if (p->prio != prio)
+                continue;
+
+            if (p->interval_ns && now < p->due_ns)
+                continue;
+
+            if (saturated && now - p->due_ns < SCHED_STARVE_NS) {
+                p->deferred++;
+                continue;
+            }
+
+            uint64_t t0 = timer_read_counter();
+            int done = p->fn(p->arg, p->budget);
+            uint64_t dt = timer_read_counter() - t0;
+
+            p->runs++;
+            p->cycles += dt;
+            if (dt > p->max_cycles)
+                p->max_cycles = dt;
+
+            if (done > 0) {
+                p->work += done;
+                rq->stats.busy_cycles += dt;
+                progress = 1;
+            }
+
+            if (done >= p->budget)
+                prio_saturated = 1;
+
+            p->due_ns = now + p->interval_ns;
+        }
+
+        if (sched_run_work(rq, prio))
+            progress = 1;
+
+        saturated |= prio_saturated;
+    }
+
+    return progress;
+}
+
+uint64_t sched_next_deadline(void)
+{
+    struct sched_cpu *rq = this_rq();
+    uint64_t next = UINT64_MAX;
+
+    if (sched_has_pending_work())
+        return 0;
+
+    for (struct sched_poller *p = rq->pollers; p; p = p->next)
+        if (p->interval_ns && p->due_ns < next)
+            next = p->due_ns;
+
+    return next;
+}
+
+/* =====================================================
+   Stats
+   ===================================================== */
+
+void sched_get_stats(sched_stats_t *out)
+{
+    struct sched_cpu *rq = this_rq();
+
+    *out = rq->stats;
+    out->total_cycles = timer_read_counter() - rq->start_cycles;
+}
+
+uint32_t sched_format(char *out, uint32_t out_size)
+{
+    struct sched_cpu *rq = this_rq();
+    uint32_t pos = 0;
+
+    pos += ksnprintf(out + pos, out_size - pos,
+                     "task         prio  runs  work  deferred  time_us  max_us\n");
+
+    for (struct sched_poller *p = rq->pollers; p && pos + 1 < out_size; p = p->next) {
+        char name[13];
+        int i = 0;
+
+        for (; p->name && p->name[i] && i < 12; i++)
+            name[i] = p->name[i];
+        for (; i < 12; i++)
+            name[i] = ' ';
+        name[12] = '\0';
+
+        pos += ksnprintf(out + pos, out_size - pos, "%s %u  %u  %u  %u  %u  %u\n",
+                         name,
+                         (unsigned int)p->prio,
+                         (unsigned int)p->runs,
+                         (unsigned int)p->work,
+                         (unsigned int)p->deferred,
+                         (unsigned int)(timer_cycles_to_ns(p->cycles) / NSEC_PER_USEC),
+                         (unsigned int)(timer_cycles_to_ns(p->max_cycles) / NSEC_PER_USEC));
+    }
+
+    return pos;
+}
@@ -0,0 +1,137 @@
+#include "kernel/smp.h"
+#include "kernel/gic.h"
+#include "kernel/mmu.h"
+#include "kernel/timer.h"
+#include "kernel/fpsimd.h"
+#include "kernel/klog.h"
+#include "kernel/ipi.h"
+#include "kernel/irq.h"
+#include "kernel/sched.h"
+#include "kernel/fiber.h"
+#include "drivers/psci.h"
+#include "drivers/uart.h"
+#include "common/utils.h"
+
+extern void exceptions_init(void);
+extern void secondary_entry(void);
+
+/* =====================================================
+   Per-CPU Data & Stacks
+   ===================================================== */
+
+/* TPIDR_EL1 of the boot core is pointed at cpu_data[0] in boot.S */
+struct cpu_data cpu_data[MAX_CPUS];
+
+/* Read by secondary_entry in boot.S: stack top = base + (id + 1) * size */
+uint8_t secondary_stacks[MAX_CPUS][SMP_STACK_SIZE] __attribute__((aligned(16)));
+
+/* Spin budget per core while waiting for it to report online */
+#define SMP_BOOT_TIMEOUT_NS   (100 * NSEC_PER_MSEC)
+
+/* =====================================================
+   Secondary Bring-up
+   ===================================================== */
+
+/* Secondaries have no pollers yet: run work handed over by IPI, else sleep */
+static void smp_secondary_loop(void)
+{
+    while (1) {
+        if (sched_run_once())
+            continue;
+
+        asm volatile("msr daifset, #2" ::: "memory");
+        if (!sched_has_pending_work() && !fiber_has_ready())
+            asm volatile("dsb sy; wfi" ::: "memory");
+        asm volatile("msr daifclr, #2" ::: "memory");
+    }
+}
+
+void secondary_start(uint64_t cpu)
+{
+    struct cpu_data *cd = &cpu_data[cpu];
+
+    asm volatile("msr tpidr_el1, %0" : : "r" (cd));
+
+    /* MMU first: with it off every data access is Device memory */
+    mmu_enable_this_cpu();
+    exceptions_init();
+    fpsimd_init();
+    gic_cpu_init();
+    timer_init_this_cpu();
+    irq_cpu_init();
+
+    klog_info(KLOG_SUB_KERNEL, "CPU%u online (MPIDR 0x%x)", cpu, cd->mpidr);
+
+    __atomic_store_n(&cd->online, 1, __ATOMIC_RELEASE);
+    asm volatile("sev");
+
+    enable_interrupts();
+    smp_secondary_loop();
+}
+
+uint32_t smp_init(void)
+{
+    uint64_t mpidr;
+    asm volatile("mrs %0, mpidr_el1" : "=r" (mpidr));
+
+    cpu_data[0].cpu_id = 0;
+    cpu_data[0].mpidr  = mpidr & 0xFF00FFFFFFULL;
+    cpu_data[0].online = 1;
+
+    ipi_init();
+
+    uint32_t online = 1;
+
+#ifdef BOARD_RPI4
+    /* Pi firmware parks secondaries on a spin table, not behind PSCI */
+    uart_puts("[INFO] SMP: Spin-table boot not implemented, 1 CPU online.\r\n");
+    return online;
+#endif
+
+    for (uint32_t cpu = 1; cpu < MAX_CPUS; cpu++) {
+        struct cpu_data *cd = &cpu_data[cpu];
+
+        /* Cores of one cluster differ in Aff0 only */
+        cd->cpu_id = cpu;
+        cd->mpidr  = (cpu_data[0].mpidr & ~0xFFULL) | cpu;
+        cd->online = 0;
+
+        /* Publish cpu_data before the core can read it */
+        asm volatile("dsb sy" ::: "memory");
+
+        int ret = psci_cpu_on(cd->mpidr, (uint64_t)(uintptr_t)secondary_entry, cpu);
+        if (ret != PSCI_RET_SUCCESS) {
+            klog_warn(KLOG_SUB_KERNEL, "CPU_ON CPU%u failed (%d)", cpu, (int64_t)ret);
+            continue;
+        }
+
+        uint64_t start = timer_get_ns();
+        while (!__atomic_load_n(&cd->online, __ATOMIC_ACQUIRE)) {
+            if (timer_get_ns() - start > SMP_BOOT_TIMEOUT_NS)
+                break;
+            asm volatile("yield");
+        }
+
+        if (cd->online)
+            online++;
+        else
+            klog_warn(KLOG_SUB_KERNEL, "CPU%u did not come online", cpu);
+    }
+
+    uart_puts("[OK] SMP: ");
+    uart_put_int(online);
+    uart_puts(" CPU(s) online.\r\n");
+
+    return online;
+}
+
+uint32_t smp_num_online(void)
+{
+    uint32_t n = 0;
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+        if (cpu_data[cpu].online)
+            n++;
+
+    return n;
+}
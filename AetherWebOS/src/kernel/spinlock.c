@@ -0,0 +1,88 @@
+#include "kernel/spinlock.h"
+#include "kernel/timer.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Lock Statistics (CONFIG_LOCK_STAT)
+   ===================================================== */
+
+#ifdef CONFIG_LOCK_STAT
+
+static struct lock_stat *lock_stat_list = 0;
+static spinlock_t lock_stat_list_lock;   /* Zeroed BSS is unlocked; not listed */
+
+void lock_stat_register(struct lock_stat *st, const char *name)
+{
+    st->name = name;
+    st->acquired = 0;
+    st->contended = 0;
+    st->wait_cycles = 0;
+    st->hold_cycles = 0;
+    st->hold_max_cycles = 0;
+    st->acquired_at = 0;
+
+    uint64_t flags = spin_lock_irqsave(&lock_stat_list_lock);
+    st->next = lock_stat_list;
+    lock_stat_list = st;
+    spin_unlock_irqrestore(&lock_stat_list_lock, flags);
+}
+
+/* Called with the lock held, so the counters need no atomics */
+void lock_stat_acquired(struct lock_stat *st, uint64_t wait_start, int contended)
+{
+    uint64_t now = timer_read_counter();
+
+    st->acquired++;
+    if (contended) {
+        st->contended++;
+        st->wait_cycles += now - wait_start;
+    }
+    st->acquired_at = now;
+}
+
+void lock_stat_released(struct lock_stat *st)
+{
+    uint64_t held = timer_read_counter() - st->acquired_at;
+
+    st->hold_cycles += held;
+    if (held > st->hold_max_cycles)
+        st->hold_max_cycles = held;
+}
+
+uint32_t lock_stat_format(char *out, uint32_t out_size)
+{
+    uint32_t pos = 0;
+
+    pos += ksnprintf(out + pos, out_size - pos,
+                     "lock                 acquired  contended  wait_us  hold_us  hold_max_ns\n");
+
+    for (struct lock_stat *st = lock_stat_list; st && pos + 1 < out_size; st = st->next) {
+        char name[21];
+        int i = 0;
+
+        for (; st->name && st->name[i] && i < 20; i++)
+            name[i] = st->name[i];
+        for (; i < 20; i++)
+            name[i] = ' ';
+        name[20] = '\0';
+
+        pos += ksnprintf(out + pos, out_size - pos, "%s %u  %u  %u  %u  %u\n",
+                         name,
+                         (unsigned int)st->acquired,
+                         (unsigned int)st->contended,
+                         (unsigned int)(timer_cycles_to_ns(st->wait_cycles) / NSEC_PER_USEC),
+                         (unsigned int)(timer_cycles_to_ns(st->hold_cycles) / NSEC_PER_USEC),
+                         (unsigned int)timer_cycles_to_ns(st->hold_max_cycles));
+    }
+
+    return pos;
+}
+
+#else
+
+uint32_t lock_stat_format(char *out, uint32_t out_size)
+{
+    return ksnprintf(out, out_size, "lock statistics disabled (build with LOCK_STAT=1)\n");
+}
+
+#endif
@@ -0,0 +1,483 @@
+#include "kernel/thread.h"
+#include "kernel/preempt.h"
+#include "kernel/smp.h"
+#include "kernel/ipi.h"
+#include "kernel/gic.h"
+#include "kernel/irq.h"
+#include "kernel/timer.h"
+#include "drivers/uart.h"
+#include "common/utils.h"
+
+/* =====================================================
+   Thread Table & Run Queues
+   ===================================================== */
+
+/* EL1h, IRQs enabled, D/A/F masked as in the boot context */
+#define THREAD_INITIAL_SPSR   0x345
+
+struct thread_rq {
+    struct thread *current;
+    struct thread *idle;
+    struct thread *zombie;                  /* Exited, stack still in use */
+    struct thread *ready_head[THREAD_NR_PRIO];
+    struct thread *ready_tail[THREAD_NR_PRIO];
+    uint32_t       nr_ready;                /* Excludes the idle thread */
+    struct hrtimer slice_timer;
+} __attribute__((aligned(64)));
+
+static struct thread_rq thread_rqs[MAX_CPUS];
+
+/* Slot 0 is the boot context ("kmain"), which keeps the boot stack */
+static struct thread threads[THREAD_MAX];
+static uint8_t thread_stacks[THREAD_MAX][THREAD_STACK_SIZE] __attribute__((aligned(16)));
+
+static spinlock_t thread_table_lock;
+static uint32_t next_tid = 0;
+
+static inline struct thread_rq *this_rq(void)
+{
+    return &thread_rqs[smp_processor_id()];
+}
+
+struct thread *thread_current(void)
+{
+    return this_rq()->current;
+}
+
+/* IRQs masked by the caller for all run queue helpers */
+static void rq_enqueue(struct thread_rq *rq, struct thread *t)
+{
+    t->state = THREAD_READY;
+
+    if (t == rq->idle)
+        return;
+
+    t->run_next = 0;
+    if (rq->ready_tail[t->prio])
+        rq->ready_tail[t->prio]->run_next = t;
+    else
+        rq->ready_head[t->prio] = t;
+    rq->ready_tail[t->prio] = t;
+    rq->nr_ready++;
+}
+
+static struct thread *rq_dequeue(struct thread_rq *rq, int prio)
+{
+    struct thread *t = rq->ready_head[prio];
+
+    rq->ready_head[prio] = t->run_next;
+    if (!rq->ready_head[prio])
+        rq->ready_tail[prio] = 0;
+    rq->nr_ready--;
+
+    return t;
+}
+
+static int rq_best_prio(struct thread_rq *rq)
+{
+    for (int prio = 0; prio < THREAD_NR_PRIO; prio++)
+        if (rq->ready_head[prio])
+            return prio;
+
+    return THREAD_NR_PRIO;
+}
+
+static struct thread *rq_pick_next(struct thread_rq *rq)
+{
+    struct thread *cur = rq->current;
+    int best = rq_best_prio(rq);
+
+    if (cur->state == THREAD_RUNNING) {
+        if (best == THREAD_NR_PRIO)
+            return cur;
+        if (cur != rq->idle && cur->prio < best)
+            return cur;
+
+        /* Equal priority rotates, a better one preempts */
+        rq_enqueue(rq, cur);
+    }
+
+    if (best == THREAD_NR_PRIO)
+        return rq->idle;
+
+    return rq_dequeue(rq, best);
+}
+
+/* Arm the slice only while a peer of the running thread is waiting */
+static void rq_update_slice(struct thread_rq *rq)
+{
+    struct thread *cur = rq->current;
+
+    if (cur != rq->idle && rq->ready_head[cur->prio]) {
+        if (!rq->slice_timer.queued)
+            hrtimer_start_rel(&rq->slice_timer, THREAD_SLICE_NS);
+    } else {
+        hrtimer_cancel(&rq->slice_timer);
+    }
+}
+
+static void thread_slice_expired(struct hrtimer *t)
+{
+    (void)t;
+    this_cpu()->need_resched = 1;
+}
+
+/* =====================================================
+   Switching
+   ===================================================== */
+
+uint64_t thread_irq_exit(uint64_t sp)
+{
+    struct cpu_data *cd = this_cpu();
+    struct thread_rq *rq = this_rq();
+
+    if (!rq->current)
+        return sp;
+
+    /* We are off the zombie's stack now */
+    if (rq->zombie && rq->zombie != rq->current) {
+        rq->zombie->state = THREAD_UNUSED;
+        rq->zombie = 0;
+    }
+
+    if (!cd->need_resched || cd->preempt_count)
+        return sp;
+
+    cd->need_resched = 0;
+
+    struct thread *cur = rq->current;
+    struct thread *next = rq_pick_next(rq);
+
+    if (next == cur) {
+        rq_update_slice(rq);
+        return sp;
+    }
+
+    uint64_t now = timer_get_ns();
+    cur->runtime_ns += now - cur->switched_in_ns;
+    cur->sp = sp;
+
+    if (cur->state == THREAD_DEAD)
+        rq->zombie = cur;
+
+    next->state = THREAD_RUNNING;
+    next->switched_in_ns = now;
+    next->switches++;
+    rq->current = next;
+
+    rq_update_slice(rq);
+    return next->sp;
+}
+
+void preempt_schedule(void)
+{
+    if (irqs_disabled() || !this_rq()->current)
+        return;
+
+    gic_send_sgi(RESCHED_SGI, 1u << smp_processor_id());
+}
+
+/*
+ * Voluntary switch: the self-SGI takes the normal IRQ path, which
+ * builds the frame and clears need_resched once it has switched.
+ */
+static void thread_reschedule(void)
+{
+    struct cpu_data *cd = this_cpu();
+
+    if (irqs_disabled() || cd->preempt_count)
+        return;
+
+    cd->need_resched = 1;
+    gic_send_sgi(RESCHED_SGI, 1u << smp_processor_id());
+
+    while (cd->need_resched)
+        asm volatile("yield");
+}
+
+/* =====================================================
+   Creation & Exit
+   ===================================================== */
+
+static void thread_start(struct thread *t)
+{
+    t->entry(t->arg);
+    thread_exit();
+}
+
+static void thread_sleep_timer_fn(struct hrtimer *timer)
+{
+    thread_wake((struct thread *)timer->data);
+}
+
+static struct thread *thread_alloc(const char *name, uint8_t prio)
+{
+    uint64_t flags = spin_lock_irqsave(&thread_table_lock);
+    struct thread *t = 0;
+
+    for (int i = 0; i < THREAD_MAX; i++) {
+        if (threads[i].state == THREAD_UNUSED) {
+            t = &threads[i];
+            t->state = THREAD_BLOCKED;      /* Reserved */
+            t->tid = next_tid++;
+            break;
+        }
+    }
+
+    spin_unlock_irqrestore(&thread_table_lock, flags);
+
+    if (!t)
+        return 0;
+
+    t->name = name;
+    t->prio = prio < THREAD_NR_PRIO ? prio : THREAD_PRIO_LOW;
+    t->cpu = smp_processor_id();
+    t->run_next = 0;
+    t->wait_next = 0;
+    t->runtime_ns = 0;
+    t->switches = 0;
+    hrtimer_init(&t->sleep_timer, thread_sleep_timer_fn, t);
+
+    return t;
+}
+
+struct thread *thread_create(const char *name, thread_fn_t fn, void *arg, uint8_t prio)
+{
+    struct thread *t = thread_alloc(name, prio);
+
+    if (!t) {
+        uart_puts("[ERROR] thread_create: Thread table full!\r\n");
+        return 0;
+    }
+
+    t->entry = fn;
+    t->arg = arg;
+
+    /* Fake IRQ frame: kernel_exit "returns" into thread_start(t) */
+    uint8_t *top = thread_stacks[t - threads] + THREAD_STACK_SIZE;
+    uint64_t *frame = (uint64_t *)(top - THREAD_FRAME_SIZE);
+
+    memset(frame, 0, THREAD_FRAME_SIZE);
+    frame[0]          = (uint64_t)(uintptr_t)t;
+    frame[FRAME_ELR]  = (uint64_t)(uintptr_t)thread_start;
+    frame[FRAME_SPSR] = THREAD_INITIAL_SPSR;
+    t->sp = (uint64_t)(uintptr_t)frame;
+
+    struct thread_rq *rq = this_rq();
+    uint64_t flags = local_irq_save();
+
+    if (t->prio == THREAD_PRIO_IDLE && !rq->idle) {
+        rq->idle = t;
+        t->state = THREAD_READY;
+    } else {
+        rq_enqueue(rq, t);
+        if (rq->current && t->prio < rq->current->prio)
+            this_cpu()->need_resched = 1;
+        if (rq->current)
+            rq_update_slice(rq);
+    }
+
+    local_irq_restore(flags);
+    preempt_check_resched();
+
+    return t;
+}
+
+void thread_exit(void)
+{
+    asm volatile("msr daifset, #2" ::: "memory");
+    this_rq()->current->state = THREAD_DEAD;
+    asm volatile("msr daifclr, #2" ::: "memory");
+
+    thread_reschedule();
+
+    while (1)
+        asm volatile("wfi");
+}
+
+static void thread_idle_fn(void *arg)
+{
+    (void)arg;
+
+    while (1)
+        asm volatile("dsb sy; wfi" ::: "memory");
+}
+
+/* need_resched is already set: thread_irq_exit() does the switch */
+static irqreturn_t thread_resched_irq(uint32_t irq, void *ctx)
+{
+    (void)irq; (void)ctx;
+    return IRQ_HANDLED;
+}
+
+void thread_init(void)
+{
+    struct thread_rq *rq = this_rq();
+
+    spin_lock_init(&thread_table_lock, "threads");
+    hrtimer_init(&rq->slice_timer, thread_slice_expired, 0);
+
+    struct thread *boot = thread_alloc("kmain", THREAD_PRIO_HIGH);
+
+    boot->state = THREAD_RUNNING;
+    boot->switched_in_ns = timer_get_ns();
+    rq->current = boot;
+
+    thread_create("idle", thread_idle_fn, 0, THREAD_PRIO_IDLE);
+
+    request_irq(RESCHED_SGI, thread_resched_irq, 0, 0, "resched", 0x80, IRQF_PERCPU);
+
+    uart_puts("[OK] Threads: Preemptive, ");
+    uart_put_int(THREAD_SLICE_NS / NSEC_PER_MSEC);
+    uart_puts(" ms slices.\r\n");
+}
+
+/* =====================================================
+   Blocking & Wakeup
+   ===================================================== */
+
+static void thread_wake_ipi(void *arg)
+{
+    thread_wake((struct thread *)arg);
+}
+
+void thread_wake(struct thread *t)
+{
+    if (t->cpu != smp_processor_id()) {
+        smp_call_on(t->cpu, thread_wake_ipi, t);
+        return;
+    }
+
+    struct thread_rq *rq = this_rq();
+    uint64_t flags = local_irq_save();
+
+    if (t->state == THREAD_BLOCKED) {
+        if (t == rq->current) {
+            /* Woken before it got switched out: just keep running */
+            t->state = THREAD_RUNNING;
+        } else {
+            rq_enqueue(rq, t);
+            if (rq->current == rq->idle || t->prio < rq->current->prio)
+                this_cpu()->need_resched = 1;
+            rq_update_slice(rq);
+        }
+    }
+
+    local_irq_restore(flags);
+    preempt_check_resched();
+}
+
+void thread_yield(void)
+{
+    struct thread_rq *rq = this_rq();
+
+    if (rq->current && rq_best_prio(rq) <= rq->current->prio)
+        thread_reschedule();
+}
+
+void thread_sleep_until(uint64_t deadline_ns)
+{
+    struct thread *cur = this_rq()->current;
+
+    if (!cur || deadline_ns <= timer_get_ns())
+        return;
+
+    asm volatile("msr daifset, #2" ::: "memory");
+    cur->state = THREAD_BLOCKED;
+    hrtimer_start(&cur->sleep_timer, deadline_ns);
+    asm volatile("msr daifclr, #2" ::: "memory");
+
+    thread_reschedule();
+}
+
+int thread_others_ready(void)
+{
+    return this_rq()->nr_ready != 0;
+}
+
+/* =====================================================
+   Wait Queues
+   ===================================================== */
+
+void wait_queue_init(struct wait_queue *wq, const char *name)
+{
+    spin_lock_init(&wq->lock, name);
+    wq->head = 0;
+}
+
+void thread_wait_locked(struct wait_queue *wq)
+{
+    struct thread *cur = this_rq()->current;
+
+    cur->state = THREAD_BLOCKED;
+
+    /* FIFO so wake_up_one() is fair */
+    spin_lock(&wq->lock);
+    struct thread **link = &wq->head;
+    while (*link)
+        link = &(*link)->wait_next;
+    cur->wait_next = 0;
+    *link = cur;
+    spin_unlock_no_resched(&wq->lock);
+
+    asm volatile("msr daifclr, #2" ::: "memory");
+    thread_reschedule();
+    asm volatile("msr daifset, #2" ::: "memory");
+}
+
+void wake_up_one(struct wait_queue *wq)
+{
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    struct thread *t = wq->head;
+
+    if (t)
+        wq->head = t->wait_next;
+
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    if (t)
+        thread_wake(t);
+}
+
+/* =====================================================
+   Stats
+   ===================================================== */
+
+uint32_t thread_format(char *out, uint32_t out_size)
+{
+    static const char *state_names[] = {
+        "unused ", "ready  ", "running", "blocked", "dead   "
+    };
+    struct thread_rq *rq = this_rq();
+    uint32_t pos = 0;
+
+    pos += ksnprintf(out + pos, out_size - pos,
+                     "tid  name        prio  state    switches  runtime_ms\n");
+
+    for (int i = 0; i < THREAD_MAX && pos + 1 < out_size; i++) {
+        struct thread *t = &threads[i];
+
+        if (t->state == THREAD_UNUSED || t->cpu != smp_processor_id())
+            continue;
+
+        uint64_t runtime = t->runtime_ns;
+        if (t == rq->current)
+            runtime += timer_get_ns() - t->switched_in_ns;
+
+        char name[12];
+        int n = 0;
+        for (; t->name && t->name[n] && n < 11; n++)
+            name[n] = t->name[n];
+        for (; n < 11; n++)
+            name[n] = ' ';
+        name[11] = '\0';
+
+        pos += ksnprintf(out + pos, out_size - pos, "%u  %s %u  %s  %u  %u\n",
+                         t->tid, name, (unsigned int)t->prio,
+                         state_names[t->state],
+                         (unsigned int)t->switches,
+                         (unsigned int)(runtime / NSEC_PER_MSEC));
+    }
+
+    return pos;
+}
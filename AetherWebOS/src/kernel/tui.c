@@ -0,0 +1,219 @@
+#include "kernel/tui.h"
+#include "drivers/uart.h"
+#include "drivers/ethernet/ipv6.h"
+
+/* =====================================================
+   Screen Buffers
+   ===================================================== */
+
+static char back_grid[TUI_ROWS][TUI_COLS];     /* Frame being drawn */
+static char front_grid[TUI_ROWS][TUI_COLS];    /* What the terminal shows */
+
+static int draw_row = 0;
+static int draw_col = 0;
+
+static int clear_pending = 1;   /* Terminal contents unknown */
+static int resume_row = 0;      /* First row to scan on the next flush */
+
+static tui_stats_t tui_stats;
+
+/*
+ * Unchanged cells between two dirty runs are resent rather than paying
+ * for another cursor escape, as long as the gap is shorter than one.
+ */
+#define TUI_MERGE_GAP   8
+
+/* =====================================================
+   Drawing Into The Back Grid
+   ===================================================== */
+
+void tui_begin(void)
+{
+    for (int r = 0; r < TUI_ROWS; r++)
+        for (int c = 0; c < TUI_COLS; c++)
+            back_grid[r][c] = ' ';
+
+    draw_row = 0;
+    draw_col = 0;
+}
+
+void tui_putc(char c)
+{
+    if (c == '\n') {
+        draw_row++;
+        draw_col = 0;
+        return;
+    }
+
+    if (c == '\r') {
+        draw_col = 0;
+        return;
+    }
+
+    if (draw_row >= TUI_ROWS || draw_col >= TUI_COLS)
+        return;
+
+    back_grid[draw_row][draw_col++] = c;
+}
+
+uint32_t tui_rows_left(void)
+{
+    return draw_row < TUI_ROWS ? (uint32_t)(TUI_ROWS - draw_row) : 0;
+}
+
+void tui_puts(const char *s)
+{
+    while (*s)
+        tui_putc(*s++);
+}
+
+void tui_put_int(uint64_t n)
+{
+    char buf[21];
+    int i = 0;
+
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n);
+
+    while (i--)
+        tui_putc(buf[i]);
+}
+
+void tui_put_hex_byte(uint8_t byte)
+{
+    const char *hex = "0123456789ABCDEF";
+    tui_putc(hex[(byte >> 4) & 0xF]);
+    tui_putc(hex[byte & 0xF]);
+}
+
+void tui_put_ip(uint32_t ip)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        tui_put_int((ip >> shift) & 0xFF);
+        if (shift)
+            tui_putc('.');
+    }
+}
+
+void tui_put_ipv6(const uint8_t addr[16])
+{
+    char buf[IPV6_STR_LEN];
+
+    ipv6_format(addr, buf);
+    tui_puts(buf);
+}
+
+/* =====================================================
+   Diff Output
+   ===================================================== */
+
+static uint32_t tui_emit_cursor(int row, int col)
+{
+    char seq[12];
+    int n = 0;
+
+    seq[n++] = '\033';
+    seq[n++] = '[';
+    if (row + 1 >= 10) seq[n++] = '0' + (row + 1) / 10;
+    seq[n++] = '0' + (row + 1) % 10;
+    seq[n++] = ';';
+    if (col + 1 >= 10) seq[n++] = '0' + (col + 1) / 10;
+    seq[n++] = '0' + (col + 1) % 10;
+    seq[n++] = 'H';
+    seq[n] = '\0';
+
+    uart_puts(seq);
+    return n;
+}
+
+/**
+ * tui_flush_row: Sends the dirty runs of one row.
+ * Returns 0 if the budget ran out before the row was complete.
+ */
+static int tui_flush_row(int row, uint32_t budget, uint32_t *sent)
+{
+    const char *back = back_grid[row];
+    char *front = front_grid[row];
+    int col = 0;
+
+    while (col < TUI_COLS) {
+        if (back[col] == front[col]) {
+            col++;
+            continue;
+        }
+
+        /* Extend the run, swallowing short clean gaps */
+        int end = col + 1;
+        int last_dirty = col;
+        while (end < TUI_COLS && end - last_dirty <= TUI_MERGE_GAP) {
+            if (back[end] != front[end])
+                last_dirty = end;
+            end++;
+        }
+
+        uint32_t run = last_dirty - col + 1;
+
+        /* Cursor escape is at most 8 bytes for an 80x40 grid */
+        if (*sent + 8 + run > budget)
+            return 0;
+
+        *sent += tui_emit_cursor(row, col);
+
+        for (int c = col; c <= last_dirty; c++) {
+            uart_putc(back[c]);
+            front[c] = back[c];
+        }
+
+        *sent += run;
+        tui_stats.cells += run;
+        col = last_dirty + 1;
+    }
+
+    return 1;
+}
+
+uint32_t tui_flush(uint32_t budget)
+{
+    uint32_t sent = 0;
+
+    tui_stats.frames++;
+
+    if (clear_pending) {
+        uart_puts("\033[2J");
+        sent += 4;
+
+        for (int r = 0; r < TUI_ROWS; r++)
+            for (int c = 0; c < TUI_COLS; c++)
+                front_grid[r][c] = ' ';
+
+        clear_pending = 0;
+        resume_row = 0;
+    }
+
+    int row = resume_row;
+
+    for (int i = 0; i < TUI_ROWS; i++) {
+        if (!tui_flush_row(row, budget, &sent)) {
+            resume_row = row;
+            tui_stats.deferred++;
+            break;
+        }
+
+        row = (row + 1) % TUI_ROWS;
+    }
+
+    tui_stats.bytes += sent;
+    return sent;
+}
+
+void tui_invalidate(void)
+{
+    clear_pending = 1;
+}
+
+const tui_stats_t *tui_get_stats(void)
+{
+    return &tui_stats;
+}